@@ -0,0 +1,285 @@
+#include "ArrayEliminatingSolverAdapter.h"
+#include "SymExprEvaluator.h"
+#include <algorithm>
+#include <iostream>
+
+using namespace smt;
+
+ArrayEliminatingSolverAdapter::ArrayEliminatingSolverAdapter(SolverAdapter *b,
+                                                             unsigned max)
+  : SolverAdapterLayer(b), maxSymbolicReads(max), mgr(b->getContext()),
+    nextVarID(~0U), numEliminated(0), numAckermann(0) {}
+
+const SymExpr *ArrayEliminatingSolverAdapter::rewrite(const SymExpr *e) {
+  std::map<const SymExpr *, const SymExpr *>::iterator it =
+    rewritten.find(e);
+  if (it != rewritten.end())
+    return it->second;
+  const SymExpr *r = rewriteNode(e);
+  rewritten.insert(std::pair<const SymExpr *, const SymExpr *>(e, r));
+  return r;
+}
+
+const SymExpr *ArrayEliminatingSolverAdapter::rewriteNode(const SymExpr *e) {
+  switch (e->getKind()) {
+  default:
+    assert(0 && "Unprocessed SymExpr kind.");
+  case SymExpr::S_ScalarSymbol:
+    return mgr.import(e);
+  case SymExpr::S_ConstExpr: {
+    // Unsigned, so that equal indices are the same node.
+    const ConstExpr *ce = static_cast<const ConstExpr *>(e);
+    return mgr.getConst(ce->getValue(), ce->getBitWidth(ctx), false);
+  }
+  case SymExpr::S_RegionSymbol:
+    // The whole array is used, e.g. in an array equality.
+    link(static_cast<const RegionSymbol *>(e));
+    return mgr.import(e);
+  case SymExpr::S_ElemSymExpr: {
+    // Collect the indices, innermost dimension first.
+    std::vector<const SymExpr *> indices;
+    const SymExpr *base = e;
+    while (ElemSymExpr::classof(base)) {
+      const ElemSymExpr *elem = static_cast<const ElemSymExpr *>(base);
+      indices.push_back(rewrite(elem->getIndexExpr()));
+      base = elem->getBaseExpr();
+    }
+    assert(RegionSymbol::classof(base) && "Unknown array base.");
+    const RegionSymbol *region = static_cast<const RegionSymbol *>(base);
+    std::reverse(indices.begin(), indices.end());
+    if (indices.size() == region->getNumberDimension(ctx))
+      return rewriteRead(region, indices);
+    link(region);
+    return getSelect(region, indices, indices.size());
+  }
+  case SymExpr::S_ArithSymExpr: {
+    const ArithSymExpr *bin = static_cast<const ArithSymExpr *>(e);
+    return mgr.getArith(rewrite(bin->getLHS()), rewrite(bin->getRHS()),
+                        bin->getOpcode());
+  }
+  case SymExpr::S_LogicalSymExpr: {
+    const LogicalSymExpr *bin = static_cast<const LogicalSymExpr *>(e);
+    return mgr.getLogical(rewrite(bin->getLHS()), rewrite(bin->getRHS()),
+                          bin->getOpcode());
+  }
+  case SymExpr::S_UnarySymExpr: {
+    const UnarySymExpr *un = static_cast<const UnarySymExpr *>(e);
+    return mgr.getUnary(rewrite(un->getOperand()), un->getUnaryOpcode());
+  }
+  case SymExpr::S_TruncSymExpr: {
+    const TruncSymExpr *ce = static_cast<const TruncSymExpr *>(e);
+    return mgr.getTrunc(rewrite(ce->getOperand()),
+                        ce->getBitWidth(ctx));
+  }
+  case SymExpr::S_ExtendSymExpr: {
+    const ExtendSymExpr *ce = static_cast<const ExtendSymExpr *>(e);
+    return mgr.getExtend(rewrite(ce->getOperand()),
+                         ce->getBitWidth(ctx), ce->isSignedExt());
+  }
+  }
+}
+
+const SymExpr *ArrayEliminatingSolverAdapter::getSelect(
+  const RegionSymbol *region, const std::vector<const SymExpr *> &indices,
+  unsigned n) {
+  const SymExpr *e = mgr.import(region);
+  for (unsigned i = 0; i < n; ++i)
+    e = mgr.getElem(e, indices[i]);
+  return e;
+}
+
+const SymExpr *ArrayEliminatingSolverAdapter::rewriteRead(
+  const RegionSymbol *region, const std::vector<const SymExpr *> &indices) {
+  unsigned id = region->getSymbolID();
+  ReadKey key(id, indices);
+  std::map<ReadKey, unsigned>::iterator it = readIndex.find(key);
+  if (it != readIndex.end())
+    return reads[it->second].var;
+
+  Read read;
+  read.region = region;
+  read.indices = indices;
+  read.symbolic = false;
+  for (unsigned i = 0; i < indices.size(); ++i)
+    if (!ConstExpr::classof(indices[i]))
+      read.symbolic = true;
+
+  if (read.symbolic && !isLinked(id)) {
+    unsigned numSymbolic = 0;
+    for (unsigned i = 0; i < reads.size(); ++i)
+      if (reads[i].region->getSymbolID() == id && reads[i].symbolic)
+        ++numSymbolic;
+    if (numSymbolic >= maxSymbolicReads)
+      link(region);
+  }
+  if (isLinked(id))
+    return getSelect(region, indices, indices.size());
+
+  read.var = mgr.getScalarSymbol(nextVarID--,
+                                 region->getElementTypeSizeInBits(ctx));
+  // Ackermann constraints against the other reads of the region. Distinct
+  // constant indices are distinct nodes, and need none.
+  for (unsigned i = 0; i < reads.size(); ++i) {
+    const Read &other = reads[i];
+    if (other.region->getSymbolID() != id ||
+        (!read.symbolic && !other.symbolic))
+      continue;
+    const SymExpr *same = 0;
+    bool differ = false;
+    for (unsigned d = 0; d < indices.size() && !differ; ++d) {
+      if (indices[d] == other.indices[d])
+        continue;
+      if (ConstExpr::classof(indices[d]) &&
+          ConstExpr::classof(other.indices[d])) {
+        differ = true;
+        continue;
+      }
+      const SymExpr *eq = mgr.getLogical(indices[d], other.indices[d], BO_EQ);
+      same = same ? mgr.getLogical(same, eq, BO_LAnd) : eq;
+    }
+    if (differ)
+      continue;
+    assert(same && "Equal keys of different reads.");
+    definitions.push_back(mgr.getLogical(
+      mgr.getUnary(same, UO_LNot),
+      mgr.getLogical(read.var, other.var, BO_EQ), BO_LOr));
+    ++numAckermann;
+  }
+
+  readIndex.insert(std::make_pair(key, reads.size()));
+  reads.push_back(read);
+  ++numEliminated;
+  return read.var;
+}
+
+void ArrayEliminatingSolverAdapter::link(const RegionSymbol *region) {
+  unsigned id = region->getSymbolID();
+  if (isLinked(id))
+    return;
+  linkedScopes.insert(std::make_pair(id, (unsigned)scopeMarks.size()));
+  for (unsigned i = 0; i < reads.size(); ++i)
+    if (reads[i].region->getSymbolID() == id)
+      definitions.push_back(mgr.getLogical(
+        reads[i].var, getSelect(region, reads[i].indices,
+                                reads[i].indices.size()), BO_EQ));
+}
+
+void ArrayEliminatingSolverAdapter::flushDefinitions() {
+  // They hold in every model of the fresh symbols, assumed or not.
+  for (unsigned i = 0; i < definitions.size(); ++i)
+    backend->assertSymConstraint(SymConstraint(definitions[i], true));
+  definitions.clear();
+}
+
+void ArrayEliminatingSolverAdapter::assertSymConstraint(
+  const SymConstraint &sc) {
+  constraints.push_back(sc);
+  SymConstraint r(rewrite(sc.cond), sc.assumption);
+  flushDefinitions();
+  backend->assertSymConstraint(r);
+}
+
+SolverResult ArrayEliminatingSolverAdapter::checkSatAssuming(
+  const std::vector<SymConstraint> &assumptions) {
+  epoch.begin();
+  lastAssumptions = assumptions;
+  lastRewritten.clear();
+  for (unsigned i = 0; i < assumptions.size(); ++i)
+    lastRewritten.push_back(SymConstraint(rewrite(assumptions[i].cond),
+                                          assumptions[i].assumption));
+  flushDefinitions();
+  return checkBackend(&lastRewritten);
+}
+
+void ArrayEliminatingSolverAdapter::getFailedAssumptions(
+  std::vector<SymConstraint> &failed) {
+  std::vector<SymConstraint> backendFailed;
+  backend->getFailedAssumptions(backendFailed);
+  failed.clear();
+  for (unsigned i = 0; i < backendFailed.size(); ++i)
+    for (unsigned j = 0; j < lastRewritten.size(); ++j)
+      if (backendFailed[i] == lastRewritten[j]) {
+        failed.push_back(lastAssumptions[j]);
+        break;
+      }
+}
+
+void ArrayEliminatingSolverAdapter::printModel() {
+  SymModel m;
+  getModel(m);
+  m.print(std::cout);
+}
+
+void ArrayEliminatingSolverAdapter::getModel(SymModel &m) {
+  SymModel bm;
+  backend->getModel(bm);
+  m.clear();
+  const SymModel::ScalarMap &scalars = bm.getScalars();
+  for (SymModel::ScalarMap::const_iterator it = scalars.begin(),
+         ie = scalars.end(); it != ie; ++it)
+    if (it->first <= nextVarID)
+      m.setScalar(it->first, it->second);
+  const SymModel::ArrayMap &arrays = bm.getArrays();
+  for (SymModel::ArrayMap::const_iterator it = arrays.begin(),
+         ie = arrays.end(); it != ie; ++it)
+    m.getOrCreateArray(it->first) = it->second;
+
+  // Put the values of the fresh symbols back at their indices. The
+  // Ackermann constraints make reads at equal indices agree.
+  SymExprEvaluator ev(ctx, bm);
+  for (unsigned i = 0; i < reads.size(); ++i) {
+    const Read &read = reads[i];
+    ArrayValue::Index index;
+    for (unsigned d = 0; d < read.indices.size(); ++d) {
+      uint64_t v = 0;
+      if (!ev.evaluate(read.indices[d], v))
+        break;
+      index.push_back(v);
+    }
+    uint64_t v = 0;
+    if (index.size() != read.indices.size() ||
+        !bm.getScalar(read.var->getSymbolID(), v))
+      continue;
+    m.getOrCreateArray(read.region->getSymbolID()).setValue(index, v);
+  }
+}
+
+void ArrayEliminatingSolverAdapter::reset() {
+  SolverAdapterLayer::reset();
+  rewritten.clear();
+  reads.clear();
+  readIndex.clear();
+  readMarks.clear();
+  linkedScopes.clear();
+  definitions.clear();
+  lastAssumptions.clear();
+  lastRewritten.clear();
+  mgr.clear();
+}
+
+void ArrayEliminatingSolverAdapter::push() {
+  SolverAdapterLayer::push();
+  readMarks.push_back(reads.size());
+}
+
+void ArrayEliminatingSolverAdapter::pop(unsigned n) {
+  SolverAdapterLayer::pop(n);
+  if (n == 0)
+    return;
+  unsigned mark = readMarks[readMarks.size() - n];
+  readMarks.resize(readMarks.size() - n);
+  for (unsigned i = mark; i < reads.size(); ++i)
+    readIndex.erase(ReadKey(reads[i].region->getSymbolID(),
+                            reads[i].indices));
+  reads.resize(mark);
+  for (std::map<unsigned, unsigned>::iterator it = linkedScopes.begin();
+       it != linkedScopes.end();) {
+    if (it->second > scopeMarks.size())
+      linkedScopes.erase(it++);
+    else
+      ++it;
+  }
+  rewritten.clear();
+  lastAssumptions.clear();
+  lastRewritten.clear();
+}
@@ -0,0 +1,98 @@
+#ifndef SMTADAPTER_ARRAY_ELIMINATING_SOLVER_ADAPTER_H	// -*- C++ -*-
+#define SMTADAPTER_ARRAY_ELIMINATING_SOLVER_ADAPTER_H
+#include "SolverAdapterLayer.h"
+#include "smtadapter/SymExprManager.h"
+#include <map>
+#include <utility>
+
+namespace smt {
+
+// Replace every complete read of a RegionSymbol by a fresh scalar symbol,
+// so that the backend sees pure bitvector queries without the array theory.
+// Reads at different constant indices are independent. When one of two
+// reads of a region has a symbolic index, the constraint
+// (i1 == j1 && ... ) -> (v == w) keeps their values consistent
+// (Ackermann's reduction).
+//
+// That takes a quadratic number of constraints, so once a region has more
+// than maxSymbolicReads symbolic reads, or it is used other than by
+// complete reads, it is linked instead: the fresh symbols of its reads are
+// defined as v == select(a, i), and its later reads stay selects.
+//
+// The fresh symbols count down from ~0U, the client's Symbol IDs must stay
+// below them. getModel() turns their values back into array contents.
+class ArrayEliminatingSolverAdapter : public SolverAdapterLayer {
+public:
+  ArrayEliminatingSolverAdapter(SolverAdapter *b,
+                                unsigned maxSymbolicReads = 8);
+
+  virtual SolverResult
+  checkSatAssuming(const std::vector<SymConstraint> &assumptions);
+  virtual void getFailedAssumptions(std::vector<SymConstraint> &failed);
+  virtual void assertSymConstraint(const SymConstraint &sc);
+  virtual void printModel();
+  virtual void getModel(SymModel &m);
+  virtual void reset();
+  virtual void push();
+  virtual void pop(unsigned n = 1);
+
+  unsigned getNumReads() const { return reads.size(); }
+  // The number of region reads that were replaced by fresh symbols.
+  unsigned getNumEliminated() const { return numEliminated; }
+  // The number of consistency constraints asserted for symbolic reads.
+  unsigned getNumAckermann() const { return numAckermann; }
+
+private:
+  // Region ID and the rewritten indices, outermost first.
+  typedef std::pair<unsigned, std::vector<const SymExpr *> > ReadKey;
+
+  struct Read {
+    const RegionSymbol *region;
+    std::vector<const SymExpr *> indices;
+    const ScalarSymbol *var;
+    bool symbolic;
+  };
+
+  const SymExpr *rewrite(const SymExpr *e);
+  const SymExpr *rewriteNode(const SymExpr *e);
+  const SymExpr *rewriteRead(const RegionSymbol *region,
+                             const std::vector<const SymExpr *> &indices);
+  // Rebuild a select of the region in the manager.
+  const SymExpr *getSelect(const RegionSymbol *region,
+                           const std::vector<const SymExpr *> &indices,
+                           unsigned n);
+  void link(const RegionSymbol *region);
+  bool isLinked(unsigned id) const {
+    return linkedScopes.find(id) != linkedScopes.end();
+  }
+  // Assert the definitions made by the last rewrites.
+  void flushDefinitions();
+
+private:
+  unsigned maxSymbolicReads;
+  SymExprManager mgr;
+  // Rewritten nodes by the address of the client node. Cleared on pop(),
+  // since they may use the fresh symbols of popped reads.
+  std::map<const SymExpr *, const SymExpr *> rewritten;
+
+  std::vector<Read> reads;
+  std::map<ReadKey, unsigned> readIndex;
+  // reads.size() at each push().
+  std::vector<unsigned> readMarks;
+  // The linked regions, with the scope depth they were linked at.
+  std::map<unsigned, unsigned> linkedScopes;
+  // Consistency constraints and links not asserted yet.
+  std::vector<const SymExpr *> definitions;
+  unsigned nextVarID;
+
+  // The rewritten assumptions of the last check, for the failed ones.
+  std::vector<SymConstraint> lastAssumptions;
+  std::vector<SymConstraint> lastRewritten;
+
+  unsigned numEliminated;
+  unsigned numAckermann;
+};
+
+}
+
+#endif
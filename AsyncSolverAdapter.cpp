@@ -0,0 +1,210 @@
+#include "AsyncSolverAdapter.h"
+#include <assert.h>
+#include <iostream>
+
+using namespace smt;
+
+AsyncSolverAdapter::AsyncSolverAdapter(SolverAdapter *b, unsigned max)
+  : SolverAdapterLayer(b), maxOutstanding(max ? max : 1), numOutstanding(0),
+    currentEpoch(0), stopping(false), workerStats(b->getStats()) {
+  worker = std::thread(&AsyncSolverAdapter::run, this);
+}
+
+AsyncSolverAdapter::~AsyncSolverAdapter() {
+  // The worker finishes the cancelled checks and exits.
+  interrupt();
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    stopping = true;
+    changed.notify_all();
+  }
+  worker.join();
+}
+
+void AsyncSolverAdapter::run() {
+  std::unique_lock<std::mutex> guard(lock);
+  for (;;) {
+    while (queue.empty() && !stopping)
+      changed.wait(guard);
+    if (queue.empty())
+      return;
+    Job job = queue.front();
+    queue.pop_front();
+    current = job.state;
+    currentEpoch = job.epoch;
+    guard.unlock();
+    runCheck(backend, *job.state, job.constraints, job.assumptions);
+    guard.lock();
+    workerStats = backend->getStats();
+    current.reset();
+    --numOutstanding;
+    changed.notify_all();
+  }
+}
+
+void AsyncSolverAdapter::runCheck(
+  SolverAdapter *backend, SolverFutureState &s,
+  const std::vector<SymConstraint> &constraints,
+  const std::vector<SymConstraint> &assumptions) {
+  {
+    std::lock_guard<std::mutex> guard(s.lock);
+    if (s.cancelled) {
+      s.finished = true;
+      s.changed.notify_all();
+      return;
+    }
+  }
+
+  SolverResult r = SAT_Undetermined;
+  backend->push();
+  try {
+    for (unsigned i = 0; i < constraints.size(); ++i)
+      backend->assertSymConstraint(constraints[i]);
+    // Only the backend check of the job is interrupted by cancel(), so an
+    // interrupt that arrives after it finished is dropped.
+    bool run;
+    {
+      std::lock_guard<std::mutex> guard(s.lock);
+      run = !s.cancelled;
+      if (run) {
+        s.runner = backend;
+        s.epoch = backend->getCheckEpoch() + 1;
+      }
+    }
+    if (run) {
+      r = assumptions.empty() ? backend->checkSat()
+        : backend->checkSatAssuming(assumptions);
+      std::lock_guard<std::mutex> guard(s.lock);
+      s.runner = 0;
+    }
+    if (r == SAT_Satisfiable)
+      backend->getModel(s.model);
+    else if (r == SAT_Unsatisfiable && !assumptions.empty())
+      backend->getFailedAssumptions(s.failed);
+  } catch (...) {
+    // E.g. a z3::exception, which must not escape the thread.
+    r = SAT_Undetermined;
+  }
+  backend->pop();
+  s.finish(r);
+}
+
+SolverFuture
+AsyncSolverAdapter::checkSatAsync(const std::vector<SymConstraint> &assumptions) {
+  std::shared_ptr<SolverFutureState> state(new SolverFutureState());
+  std::unique_lock<std::mutex> guard(lock);
+  while (numOutstanding >= maxOutstanding)
+    changed.wait(guard);
+  Job job;
+  job.state = state;
+  job.constraints = constraints;
+  job.assumptions = assumptions;
+  job.epoch = epoch.begin();
+  if (epoch.isInterrupted())
+    state->cancelled = true;
+  queue.push_back(job);
+  ++numOutstanding;
+  changed.notify_all();
+  return SolverFuture(state);
+}
+
+const SolverStats &AsyncSolverAdapter::getStats() const {
+  std::lock_guard<std::mutex> guard(lock);
+  clientStats = workerStats;
+  return clientStats;
+}
+
+void AsyncSolverAdapter::setTraceHook(QueryTraceHook hook, void *data) {
+  drain();
+  backend->setTraceHook(hook, data);
+}
+
+void AsyncSolverAdapter::setCollectBackendStats(bool b) {
+  drain();
+  backend->setCollectBackendStats(b);
+}
+
+unsigned AsyncSolverAdapter::getNumOutstanding() {
+  std::lock_guard<std::mutex> guard(lock);
+  return numOutstanding;
+}
+
+void AsyncSolverAdapter::drain() {
+  std::unique_lock<std::mutex> guard(lock);
+  while (numOutstanding > 0)
+    changed.wait(guard);
+}
+
+SolverResult AsyncSolverAdapter::finishSync(const SolverFuture &f) {
+  SolverResult r = f.wait();
+  lastModel = f.getModel();
+  lastFailed = f.getFailedAssumptions();
+  return r;
+}
+
+SolverResult AsyncSolverAdapter::checkSat() {
+  return finishSync(checkSatAsync(std::vector<SymConstraint>()));
+}
+
+SolverResult
+AsyncSolverAdapter::checkSatAssuming(const std::vector<SymConstraint> &assumptions) {
+  return finishSync(checkSatAsync(assumptions));
+}
+
+void AsyncSolverAdapter::getFailedAssumptions(std::vector<SymConstraint> &failed) {
+  failed = lastFailed;
+}
+
+void AsyncSolverAdapter::assertSymConstraint(const SymConstraint &sc) {
+  constraints.push_back(sc);
+}
+
+void AsyncSolverAdapter::printModel() {
+  lastModel.print(std::cout);
+}
+
+void AsyncSolverAdapter::getModel(SymModel &m) {
+  m = lastModel;
+}
+
+void AsyncSolverAdapter::reset() {
+  drain();
+  constraints.clear();
+  scopeMarks.clear();
+  lastModel.clear();
+  lastFailed.clear();
+  backend->reset();
+}
+
+void AsyncSolverAdapter::interrupt() {
+  std::lock_guard<std::mutex> guard(lock);
+  for (unsigned i = 0; i < queue.size(); ++i)
+    SolverFuture(queue[i].state).cancel();
+  if (current)
+    SolverFuture(current).cancel();
+}
+
+void AsyncSolverAdapter::interruptCheck(unsigned e) {
+  std::lock_guard<std::mutex> guard(lock);
+  // Kept for a check that is not queued yet.
+  epoch.interrupt(e);
+  for (unsigned i = 0; i < queue.size(); ++i) {
+    if (queue[i].epoch == e)
+      SolverFuture(queue[i].state).cancel();
+  }
+  if (current && currentEpoch == e)
+    SolverFuture(current).cancel();
+}
+
+void AsyncSolverAdapter::push() {
+  scopeMarks.push_back(constraints.size());
+}
+
+void AsyncSolverAdapter::pop(unsigned n) {
+  assert(n <= scopeMarks.size() && "Cannot pop more scopes than pushed.");
+  if (n == 0)
+    return;
+  constraints.erase(constraints.begin() + scopeMarks[scopeMarks.size() - n],
+                    constraints.end());
+  scopeMarks.resize(scopeMarks.size() - n);
+}
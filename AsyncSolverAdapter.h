@@ -0,0 +1,99 @@
+#ifndef SMTADAPTER_ASYNC_SOLVER_ADAPTER_H	// -*- C++ -*-
+#define SMTADAPTER_ASYNC_SOLVER_ADAPTER_H
+#include "SolverAdapterLayer.h"
+#include "smtadapter/SolverFuture.h"
+#include "smtadapter/SolverStats.h"
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace smt {
+
+// Run checks on a worker thread. The asserted constraints and scopes stay
+// in the layer; checkSatAsync() takes a snapshot of them, and the worker
+// asserts the snapshot in a scope of the backend, checks, and pops it
+// again, so the caller may go on asserting while the check runs. At most
+// maxOutstanding checks are queued or running, checkSatAsync() waits for
+// a slot otherwise.
+//
+// Only the worker touches the backend after construction, except reset()
+// and the statistics setters, which first wait for the queue to drain.
+class AsyncSolverAdapter : public SolverAdapterLayer {
+public:
+  AsyncSolverAdapter(SolverAdapter *b, unsigned maxOutstanding = 4);
+  virtual ~AsyncSolverAdapter();
+
+  // The statistics of the backend as of the last finished check; the
+  // worker updates the backend's own while it checks.
+  virtual const SolverStats &getStats() const;
+  // The hook runs on the worker thread.
+  virtual void setTraceHook(QueryTraceHook hook, void *data);
+  virtual void setCollectBackendStats(bool b);
+
+  virtual SolverResult checkSat();
+  virtual SolverResult
+  checkSatAssuming(const std::vector<SymConstraint> &assumptions);
+  virtual void getFailedAssumptions(std::vector<SymConstraint> &failed);
+  virtual SolverFuture
+  checkSatAsync(const std::vector<SymConstraint> &assumptions);
+  virtual void assertSymConstraint(const SymConstraint &sc);
+  virtual void printModel();
+  virtual void getModel(SymModel &m);
+  virtual void reset();
+  // Cancel every queued and running check.
+  virtual void interrupt();
+  // The checks are numbered as they are queued.
+  virtual void interruptCheck(unsigned e);
+  virtual void push();
+  virtual void pop(unsigned n = 1);
+
+  unsigned getMaxOutstanding() const { return maxOutstanding; }
+  unsigned getNumOutstanding();
+
+  // Check constraints and assumptions in a scope of backend, and finish s.
+  // A check cancelled before it reaches the backend is skipped, and
+  // cancel() interrupts the backend check of the job and no other.
+  static void runCheck(SolverAdapter *backend, SolverFutureState &s,
+                       const std::vector<SymConstraint> &constraints,
+                       const std::vector<SymConstraint> &assumptions);
+
+private:
+  struct Job {
+    std::shared_ptr<SolverFutureState> state;
+    std::vector<SymConstraint> constraints;
+    std::vector<SymConstraint> assumptions;
+    unsigned epoch;
+  };
+
+  void run();
+  // Wait until the worker has finished every queued check.
+  void drain();
+  SolverResult finishSync(const SolverFuture &f);
+
+private:
+  unsigned maxOutstanding;
+  mutable std::mutex lock;
+  std::condition_variable changed;
+  std::deque<Job> queue;
+  // Queued and running checks.
+  unsigned numOutstanding;
+  // The check the worker is running.
+  std::shared_ptr<SolverFutureState> current;
+  unsigned currentEpoch;
+  bool stopping;
+  std::thread worker;
+  // Copied from the backend by the worker after each check, under lock,
+  // and handed out by getStats().
+  SolverStats workerStats;
+  mutable SolverStats clientStats;
+
+  // Of the last synchronous check.
+  SymModel lastModel;
+  std::vector<SymConstraint> lastFailed;
+};
+
+}
+
+#endif
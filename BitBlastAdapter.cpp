@@ -0,0 +1,650 @@
+#include "smtadapter/SolverContext.h"
+#include "BitBlastAdapter.h"
+#include "BitVector.h"
+#include "smtadapter/SolverStats.h"
+#include "smtadapter/SymExprVisitor.h"
+#include <algorithm>
+#include <iostream>
+
+using namespace smt;
+
+namespace {
+
+// The results of lglsat().
+enum { LglUnknown = 0, LglSatisfiable = 10, LglUnsatisfiable = 20 };
+
+}
+
+BitBlastAdapter::BitBlastAdapter(SolverContext &sc, unsigned t)
+  : SolverAdapter(sc), lgl(0), timeout(t), timedOut(false), unsupportedDepth(NoUnsupported), numTranslated(0),
+    translateTime(0) {
+  init();
+}
+
+BitBlastAdapter::~BitBlastAdapter() {
+  lglrelease(lgl);
+}
+
+void BitBlastAdapter::init() {
+  lgl = lglinit();
+  lglseterm(lgl, terminate, this);
+  gates.assign(1024, Gate());
+  numGates = 0;
+  numGateHits = 0;
+  numVars = 0;
+  numClauses = 0;
+  exprsByScope.assign(1, std::vector<const SymExpr *>());
+  // Variable 1 is the constant true.
+  newVar();
+  addClause(TrueLit);
+}
+
+int BitBlastAdapter::terminate(void *data) {
+  BitBlastAdapter *adapter = static_cast<BitBlastAdapter *>(data);
+  if (adapter->epoch.isInterrupted())
+    return 1;
+  if (adapter->timeout &&
+      adapter->checkTimer.getMicroseconds() > adapter->timeout * 1000.0) {
+    adapter->timedOut = true;
+    return 1;
+  }
+  return 0;
+}
+
+int BitBlastAdapter::newVar() {
+  int v = ++numVars;
+  // Every variable may show up in the clauses and assumptions of a later
+  // check, so none may be eliminated.
+  lglfreeze(lgl, v);
+  return v;
+}
+
+void BitBlastAdapter::addClause(int a, int b, int c) {
+  lgladd(lgl, a);
+  if (b)
+    lgladd(lgl, b);
+  if (c)
+    lgladd(lgl, c);
+  lgladd(lgl, 0);
+  ++numClauses;
+}
+
+unsigned BitBlastAdapter::getGateSlot(GateKind kind, int a, int b) const {
+  unsigned mask = gates.size() - 1;
+  unsigned h = ((unsigned)a * 2654435761u) ^ ((unsigned)b * 40503u) ^ kind;
+  unsigned i = h & mask;
+  while (gates[i].out &&
+         (gates[i].kind != kind || gates[i].a != a || gates[i].b != b))
+    i = (i + 1) & mask;
+  return i;
+}
+
+// Find the output of the gate, or create its variable and set created.
+// The operands are normalized by the caller.
+int BitBlastAdapter::lookupGate(GateKind kind, int a, int b, bool &created) {
+  Gate &slot = gates[getGateSlot(kind, a, b)];
+  created = !slot.out;
+  if (!created) {
+    ++numGateHits;
+    return slot.out;
+  }
+  if (2 * (numGates + 1) > gates.size()) {
+    std::vector<Gate> old;
+    old.swap(gates);
+    gates.assign(old.size() * 2, Gate());
+    for (unsigned i = 0; i < old.size(); ++i)
+      if (old[i].out)
+        gates[getGateSlot(old[i].kind, old[i].a, old[i].b)] = old[i];
+  }
+  Gate &g = gates[getGateSlot(kind, a, b)];
+  g.kind = kind;
+  g.a = a;
+  g.b = b;
+  g.out = newVar();
+  ++numGates;
+  return g.out;
+}
+
+int BitBlastAdapter::mkAnd(int a, int b) {
+  if (a == FalseLit || b == FalseLit || a == -b)
+    return FalseLit;
+  if (a == TrueLit || a == b)
+    return b;
+  if (b == TrueLit)
+    return a;
+  if (a > b)
+    std::swap(a, b);
+  bool created;
+  int out = lookupGate(G_And, a, b, created);
+  if (created) {
+    addClause(-out, a);
+    addClause(-out, b);
+    addClause(out, -a, -b);
+  }
+  return out;
+}
+
+int BitBlastAdapter::mkXor(int a, int b) {
+  if (a == FalseLit)
+    return b;
+  if (b == FalseLit)
+    return a;
+  if (a == TrueLit)
+    return -b;
+  if (b == TrueLit)
+    return -a;
+  if (a == b)
+    return FalseLit;
+  if (a == -b)
+    return TrueLit;
+  // Gates only take positive operands, the negations go to the output.
+  bool negated = false;
+  if (a < 0)
+    a = -a, negated = !negated;
+  if (b < 0)
+    b = -b, negated = !negated;
+  if (a > b)
+    std::swap(a, b);
+  bool created;
+  int out = lookupGate(G_Xor, a, b, created);
+  if (created) {
+    addClause(-out, a, b);
+    addClause(-out, -a, -b);
+    addClause(out, -a, b);
+    addClause(out, a, -b);
+  }
+  return negated ? -out : out;
+}
+
+int BitBlastAdapter::mkIte(int c, int t, int e) {
+  if (t == e)
+    return t;
+  return mkOr(mkAnd(c, t), mkAnd(-c, e));
+}
+
+BitBlastAdapter::Bits BitBlastAdapter::mkConst(const ConstExpr *ce) {
+  unsigned w = ce->getBitWidth(ctx);
+  uint64_t v = (uint64_t)ce->getValue();
+  // Bits above 64 repeat the sign of a signed value, like genZ3Const.
+  int fill = (ce->isSigned() && (long long)v < 0) ? TrueLit : FalseLit;
+  Bits r(w, fill);
+  for (unsigned i = 0; i < w && i < 64; ++i)
+    r[i] = ((v >> i) & 1) ? TrueLit : FalseLit;
+  return r;
+}
+
+BitBlastAdapter::Bits BitBlastAdapter::mkNot(const Bits &a) {
+  Bits r(a.size());
+  for (unsigned i = 0; i < a.size(); ++i)
+    r[i] = -a[i];
+  return r;
+}
+
+// Ripple carry adder.
+BitBlastAdapter::Bits BitBlastAdapter::mkAdd(const Bits &a, const Bits &b,
+                                             int carry) {
+  Bits r(a.size());
+  for (unsigned i = 0; i < a.size(); ++i) {
+    int x = mkXor(a[i], b[i]);
+    r[i] = mkXor(x, carry);
+    carry = mkOr(mkAnd(a[i], b[i]), mkAnd(carry, x));
+  }
+  return r;
+}
+
+BitBlastAdapter::Bits BitBlastAdapter::mkNeg(const Bits &a) {
+  return mkAdd(Bits(a.size(), FalseLit), mkNot(a), TrueLit);
+}
+
+// Shift and add; the partial products below bit i are constant 0 and fold
+// away.
+BitBlastAdapter::Bits BitBlastAdapter::mkMul(const Bits &a, const Bits &b) {
+  unsigned w = a.size();
+  Bits r(w, FalseLit);
+  for (unsigned i = 0; i < w; ++i) {
+    if (b[i] == FalseLit)
+      continue;
+    Bits partial(w, FalseLit);
+    for (unsigned j = i; j < w; ++j)
+      partial[j] = mkAnd(a[j - i], b[i]);
+    r = mkAdd(r, partial, FalseLit);
+  }
+  return r;
+}
+
+// Restoring division. A 0 divisor gives all ones and a remainder of a, as
+// in SMT-LIB.
+void BitBlastAdapter::mkUDivRem(const Bits &a, const Bits &b, Bits &q,
+                                Bits &r) {
+  unsigned w = a.size();
+  q.assign(w, FalseLit);
+  r.assign(w, FalseLit);
+  // The divisor with one more bit, for the shifted remainder.
+  Bits d(b);
+  d.push_back(FalseLit);
+  for (int i = w - 1; i >= 0; --i) {
+    Bits s(w + 1);
+    s[0] = a[i];
+    for (unsigned k = 0; k < w; ++k)
+      s[k + 1] = r[k];
+    int ge = -mkULT(s, d);
+    Bits diff = mkAdd(s, mkNot(d), TrueLit);
+    for (unsigned k = 0; k < w; ++k)
+      r[k] = mkIte(ge, diff[k], s[k]);
+    q[i] = ge;
+  }
+}
+
+// Signed division on the magnitudes: the quotient is negative if the signs
+// differ, the remainder has the sign of a.
+BitBlastAdapter::Bits BitBlastAdapter::mkSDiv(const Bits &a, const Bits &b,
+                                              bool rem) {
+  int sa = a.back(), sb = b.back();
+  Bits q, r;
+  mkUDivRem(mkIte(sa, mkNeg(a), a), mkIte(sb, mkNeg(b), b), q, r);
+  if (rem)
+    return mkIte(sa, mkNeg(r), r);
+  return mkIte(mkXor(sa, sb), mkNeg(q), q);
+}
+
+// Barrel shifter. Amounts of at least the width give 0, as Z3's
+// bvshl/bvlshr do.
+BitBlastAdapter::Bits BitBlastAdapter::mkShift(const Bits &a, const Bits &b,
+                                               bool left) {
+  unsigned w = a.size();
+  Bits r(a);
+  unsigned k = 0;
+  for (; k < b.size() && ((uint64_t)1 << k) < w; ++k) {
+    unsigned step = 1u << k;
+    Bits shifted(w, FalseLit);
+    for (unsigned i = 0; i < w; ++i) {
+      if (left && i >= step)
+        shifted[i] = r[i - step];
+      else if (!left && i + step < w)
+        shifted[i] = r[i + step];
+    }
+    r = mkIte(b[k], shifted, r);
+  }
+  int tooFar = FalseLit;
+  for (; k < b.size(); ++k)
+    tooFar = mkOr(tooFar, b[k]);
+  return mkIte(tooFar, Bits(w, FalseLit), r);
+}
+
+BitBlastAdapter::Bits BitBlastAdapter::mkIte(int c, const Bits &t,
+                                             const Bits &e) {
+  Bits r(t.size());
+  for (unsigned i = 0; i < t.size(); ++i)
+    r[i] = mkIte(c, t[i], e[i]);
+  return r;
+}
+
+int BitBlastAdapter::mkEq(const Bits &a, const Bits &b) {
+  int r = TrueLit;
+  for (unsigned i = 0; i < a.size(); ++i)
+    r = mkAnd(r, -mkXor(a[i], b[i]));
+  return r;
+}
+
+// From the least significant bit up, the highest differing bit decides.
+int BitBlastAdapter::mkULT(const Bits &a, const Bits &b) {
+  int lt = FalseLit;
+  for (unsigned i = 0; i < a.size(); ++i)
+    lt = mkIte(mkXor(a[i], b[i]), b[i], lt);
+  return lt;
+}
+
+int BitBlastAdapter::mkSLT(const Bits &a, const Bits &b) {
+  // Flipping the sign bits turns it into an unsigned comparison.
+  Bits x(a), y(b);
+  x.back() = -x.back();
+  y.back() = -y.back();
+  return mkULT(x, y);
+}
+
+// Build the bits of one node from the bits of its operands.
+class BitBlastAdapter::Translator
+  : public SymExprVisitor<BitBlastAdapter::Translator, BitBlastAdapter::Bits> {
+public:
+  Translator(BitBlastAdapter &a, const Bits *o)
+    : adapter(a), ops(o), unsupported(false) {}
+
+  // Whether the node was an array, see visitSymExpr().
+  bool isUnsupported() const { return unsupported; }
+
+  Bits visitScalarSymbol(const ScalarSymbol *sym) {
+    unsigned id = sym->getSymbolID();
+    if (Bits *decl = adapter.decls.lookup(id))
+      return *decl;
+    Bits r(sym->getBitWidth(adapter.ctx));
+    for (unsigned i = 0; i < r.size(); ++i)
+      r[i] = adapter.newVar();
+    return adapter.decls.insert(id, r);
+  }
+
+  Bits visitConstExpr(const ConstExpr *ce) { return adapter.mkConst(ce); }
+
+  Bits visitArithSymExpr(const ArithSymExpr *bin) {
+    const Bits &a = ops[0], &b = ops[1];
+    switch (bin->getOpcode()) {
+    default:
+      assert(0 && "Unprocessed arith opcode.");
+    case BO_Mul:
+      return adapter.mkMul(a, b);
+    case BO_SDiv:
+      return adapter.mkSDiv(a, b, false);
+    case BO_UDiv: {
+      Bits q, r;
+      adapter.mkUDivRem(a, b, q, r);
+      return q;
+    }
+    case BO_SRem:
+      return adapter.mkSDiv(a, b, true);
+    case BO_URem: {
+      Bits q, r;
+      adapter.mkUDivRem(a, b, q, r);
+      return r;
+    }
+    case BO_Add:
+      return adapter.mkAdd(a, b, FalseLit);
+    case BO_Sub:
+      return adapter.mkAdd(a, adapter.mkNot(b), TrueLit);
+    case BO_Shl:
+      return adapter.mkShift(a, b, true);
+    case BO_Shr:
+      return adapter.mkShift(a, b, false);
+    case BO_And:
+    case BO_Xor:
+    case BO_Or: {
+      Bits r(a.size());
+      for (unsigned i = 0; i < a.size(); ++i) {
+        if (bin->getOpcode() == BO_And)
+          r[i] = adapter.mkAnd(a[i], b[i]);
+        else if (bin->getOpcode() == BO_Xor)
+          r[i] = adapter.mkXor(a[i], b[i]);
+        else
+          r[i] = adapter.mkOr(a[i], b[i]);
+      }
+      return r;
+    }
+    }
+  }
+
+  Bits visitLogicalSymExpr(const LogicalSymExpr *bin) {
+    const Bits &a = ops[0], &b = ops[1];
+    int r = FalseLit;
+    switch (bin->getOpcode()) {
+    default:
+      assert(0 && "Unprocessed logical opcode");
+    case BO_SLT: r = adapter.mkSLT(a, b); break;
+    case BO_ULT: r = adapter.mkULT(a, b); break;
+    case BO_SGT: r = adapter.mkSLT(b, a); break;
+    case BO_UGT: r = adapter.mkULT(b, a); break;
+    case BO_SLE: r = -adapter.mkSLT(b, a); break;
+    case BO_ULE: r = -adapter.mkULT(b, a); break;
+    case BO_SGE: r = -adapter.mkSLT(a, b); break;
+    case BO_UGE: r = -adapter.mkULT(a, b); break;
+    case BO_EQ: r = adapter.mkEq(a, b); break;
+    case BO_NE: r = -adapter.mkEq(a, b); break;
+    case BO_LAnd: r = adapter.mkAnd(a[0], b[0]); break;
+    case BO_LOr: r = adapter.mkOr(a[0], b[0]); break;
+    }
+    return Bits(1, r);
+  }
+
+  Bits visitUnarySymExpr(const UnarySymExpr *un) {
+    switch (un->getUnaryOpcode()) {
+    default:
+      assert(0 && "Unprocessed unary opcode.");
+    case UO_Minus:
+      return adapter.mkNeg(ops[0]);
+    case UO_Not:
+      return adapter.mkNot(ops[0]);
+    case UO_LNot:
+      return Bits(1, -ops[0][0]);
+    }
+  }
+
+  Bits visitTruncSymExpr(const TruncSymExpr *ce) {
+    return Bits(ops[0].begin(), ops[0].begin() + ce->getBitWidth(adapter.ctx));
+  }
+
+  Bits visitExtendSymExpr(const ExtendSymExpr *ce) {
+    Bits r(ops[0]);
+    // A Boolean extends to 0 or 1.
+    int fill = ce->isSignedExt() && !isBoolSymExpr(ce->getOperand())
+      ? r.back() : FalseLit;
+    r.resize(ce->getBitWidth(adapter.ctx), fill);
+    return r;
+  }
+
+  // Arrays are not supported. A read of an element becomes fresh
+  // variables, which keeps the parents well formed; the check gives up on
+  // the query anyway.
+  Bits visitSymExpr(const SymExpr *e) {
+    unsupported = true;
+    unsigned nIndices = 0;
+    const SymExpr *base = e;
+    while (ElemSymExpr::classof(base)) {
+      ++nIndices;
+      base = static_cast<const ElemSymExpr *>(base)->getBaseExpr();
+    }
+    Bits r;
+    if (!nIndices || !RegionSymbol::classof(base))
+      return r;
+    const RegionSymbol *region = static_cast<const RegionSymbol *>(base);
+    if (nIndices == region->getNumberDimension(adapter.ctx))
+      r.resize(region->getElementTypeSizeInBits(adapter.ctx));
+    for (unsigned i = 0; i < r.size(); ++i)
+      r[i] = adapter.newVar();
+    return r;
+  }
+
+private:
+  BitBlastAdapter &adapter;
+  const Bits *ops;
+  bool unsupported;
+};
+
+BitBlastAdapter::Bits BitBlastAdapter::genBits(const SymExpr *cond,
+                                               bool &supported) {
+  supported = true;
+  std::map<const SymExpr *, Bits>::iterator found = exprCache.find(cond);
+  if (found != exprCache.end())
+    return found->second;
+  // Post-order walk with explicit stacks, as in Z3Adapter::genZ3Expr().
+  // Unsupported nodes and their parents are not cached, so that every
+  // query using them notices.
+  work.clear();
+  results.clear();
+  resultsUnsupported.clear();
+  work.push_back(std::make_pair(cond, false));
+  while (!work.empty()) {
+    const SymExpr *e = work.back().first;
+    const SymExpr *ops[2];
+    if (!work.back().second) {
+      std::map<const SymExpr *, Bits>::iterator it = exprCache.find(e);
+      if (it != exprCache.end()) {
+        results.push_back(it->second);
+        resultsUnsupported.push_back(false);
+        work.pop_back();
+        continue;
+      }
+      work.back().second = true;
+      for (unsigned n = getSymExprOperands(e, ops); n > 0; --n)
+        work.push_back(std::make_pair(ops[n - 1], false));
+      continue;
+    }
+    work.pop_back();
+    unsigned n = getSymExprOperands(e, ops);
+    Translator t(*this, n ? &results[results.size() - n] : 0);
+    Bits r = t.visit(e);
+    bool unsupported = t.isUnsupported();
+    for (unsigned i = resultsUnsupported.size() - n;
+         i < resultsUnsupported.size(); ++i)
+      unsupported = unsupported || resultsUnsupported[i];
+    results.resize(results.size() - n);
+    resultsUnsupported.resize(resultsUnsupported.size() - n);
+    results.push_back(r);
+    resultsUnsupported.push_back(unsupported);
+    if (!unsupported) {
+      exprCache.insert(std::make_pair(e, r));
+      exprsByScope.back().push_back(e);
+    }
+    ++numTranslated;
+  }
+  supported = !resultsUnsupported.back();
+  Bits r;
+  r.swap(results.back());
+  results.clear();
+  return r;
+}
+
+int BitBlastAdapter::getConstraintLit(const SymConstraint &sc,
+                                      bool &supported) {
+  int lit = genBits(sc.cond, supported)[0];
+  return sc.assumption ? lit : -lit;
+}
+
+void BitBlastAdapter::assertSymConstraint(const SymConstraint &sc) {
+  Timer timer;
+  bool supported;
+  int lit = getConstraintLit(sc, supported);
+  translateTime += timer.getMicroseconds();
+  if (!supported && unsupportedDepth > scopeLits.size())
+    unsupportedDepth = scopeLits.size();
+  // The constraint of a scope only holds while its literal is assumed.
+  if (scopeLits.empty())
+    addClause(lit);
+  else
+    addClause(-scopeLits.back(), lit);
+}
+
+void BitBlastAdapter::push() {
+  scopeLits.push_back(newVar());
+  exprsByScope.push_back(std::vector<const SymExpr *>());
+}
+
+void BitBlastAdapter::pop(unsigned n) {
+  assert(n <= scopeLits.size() && "Cannot pop more scopes than pushed.");
+  // Disable the constraints of the scopes for good; the learned clauses
+  // stay valid.
+  for (unsigned i = 0; i < n; ++i) {
+    addClause(-scopeLits.back());
+    scopeLits.pop_back();
+    // The bits of the nodes translated in the scope stay valid, but the
+    // client may reuse their storage.
+    std::vector<const SymExpr *> &exprs = exprsByScope.back();
+    for (unsigned j = 0; j < exprs.size(); ++j)
+      exprCache.erase(exprs[j]);
+    exprsByScope.pop_back();
+  }
+  if (unsupportedDepth > scopeLits.size())
+    unsupportedDepth = NoUnsupported;
+  lastAssumptions.clear();
+  lastAssumptionLits.clear();
+}
+
+SolverResult BitBlastAdapter::checkSat() {
+  return check(0);
+}
+
+SolverResult BitBlastAdapter::checkSatAssuming(
+  const std::vector<SymConstraint> &assumptions) {
+  return check(&assumptions);
+}
+
+SolverResult
+BitBlastAdapter::check(const std::vector<SymConstraint> *assumptions) {
+  epoch.begin();
+  lastAssumptions.clear();
+  lastAssumptionLits.clear();
+  Timer timer;
+  bool supported = unsupportedDepth == NoUnsupported;
+  if (assumptions) {
+    lastAssumptions = *assumptions;
+    for (unsigned i = 0; i < assumptions->size(); ++i) {
+      bool s;
+      lastAssumptionLits.push_back(getConstraintLit((*assumptions)[i], s));
+      supported = supported && s;
+    }
+  }
+  translateTime += timer.getMicroseconds();
+
+  // A query with arrays is given up on, and so is an interrupted one.
+  timedOut = false;
+  checkTimer.restart();
+  int result = LglUnknown;
+  if (supported && !epoch.isInterrupted()) {
+    // Assumptions only hold for the next lglsat().
+    for (unsigned i = 0; i < scopeLits.size(); ++i)
+      lglassume(lgl, scopeLits[i]);
+    for (unsigned i = 0; i < lastAssumptionLits.size(); ++i)
+      lglassume(lgl, lastAssumptionLits[i]);
+    result = lglsat(lgl);
+  }
+  QueryStats qs;
+  qs.solveTime = checkTimer.getMicroseconds();
+  if (result == LglSatisfiable)
+    qs.result = SAT_Satisfiable;
+  else if (result == LglUnsatisfiable)
+    qs.result = SAT_Unsatisfiable;
+  else
+    qs.result = timedOut ? SAT_Timeout : SAT_Undetermined;
+  qs.numNodes = numTranslated;
+  qs.translateTime = translateTime;
+  qs.numDecls = decls.size();
+  if (collectBackendStats) {
+    qs.backendStats.push_back(std::make_pair("vars", (double)numVars));
+    qs.backendStats.push_back(std::make_pair("clauses", (double)numClauses));
+    qs.backendStats.push_back(std::make_pair("gates", (double)numGates));
+    qs.backendStats.push_back(
+      std::make_pair("gate hits", (double)numGateHits));
+  }
+  numTranslated = 0;
+  translateTime = 0;
+  recordQuery(qs);
+  return qs.result;
+}
+
+void BitBlastAdapter::getFailedAssumptions(
+  std::vector<SymConstraint> &failed) {
+  failed.clear();
+  for (unsigned i = 0; i < lastAssumptionLits.size(); ++i) {
+    if (lglfailed(lgl, lastAssumptionLits[i]))
+      failed.push_back(lastAssumptions[i]);
+  }
+}
+
+void BitBlastAdapter::printModel() {
+  SymModel m;
+  getModel(m);
+  m.print(std::cout);
+}
+
+void BitBlastAdapter::getModel(SymModel &m) {
+  m.clear();
+  for (DeclTable<Bits>::const_iterator it = decls.begin(),
+         ie = decls.end(); it != ie; ++it) {
+    const Bits &bits = it->second;
+    uint64_t v = 0;
+    for (unsigned i = 0; i < bits.size() && i < 64; ++i)
+      if (lglderef(lgl, bits[i]) > 0)
+        v |= (uint64_t)1 << i;
+    m.setScalar(it->first, v);
+  }
+}
+
+void BitBlastAdapter::reset() {
+  // Clauses cannot be retracted, start over with a new instance.
+  lglrelease(lgl);
+  decls.clear();
+  exprCache.clear();
+  scopeLits.clear();
+  unsupportedDepth = NoUnsupported;
+  lastAssumptions.clear();
+  lastAssumptionLits.clear();
+  numTranslated = 0;
+  translateTime = 0;
+  init();
+}
@@ -0,0 +1,149 @@
+#ifndef SMTADAPTER_BIT_BLAST_ADAPTER_H	// -*- C++ -*-
+#define SMTADAPTER_BIT_BLAST_ADAPTER_H
+#include "CheckEpoch.h"
+#include "DeclTable.h"
+#include "smtadapter/SolverAdapter.h"
+#include "smtadapter/Symbol.h"
+#include "smtadapter/SymModel.h"
+#include "Timer.h"
+#include "lglib.h"
+#include <map>
+#include <vector>
+
+namespace smt {
+
+// A SolverAdapter that bit-blasts SymExprs straight into CNF for the
+// Lingeling SAT solver bundled with Boolector, without an SMT layer in
+// between. Gates are structurally hashed, so a subterm shared by several
+// queries is encoded once, and a single solver instance is used
+// incrementally: scopes and assumptions are assumption literals, so the
+// clauses learned by one check help the next ones.
+//
+// Only bitvector expressions are supported. Array reads must be removed
+// beforehand, e.g. by an ArrayEliminatingSolverAdapter that never links;
+// otherwise checks return SAT_Undetermined while a constraint with arrays
+// is asserted, or assumed.
+class BitBlastAdapter : public SolverAdapter {
+public:
+  // Timeout in milliseconds, 0 for none.
+  BitBlastAdapter(SolverContext &sc, unsigned timeout = 0);
+  ~BitBlastAdapter();
+
+  //override
+  virtual SolverResult checkSat();
+  virtual SolverResult
+  checkSatAssuming(const std::vector<SymConstraint> &assumptions);
+  virtual void getFailedAssumptions(std::vector<SymConstraint> &failed);
+  virtual void assertSymConstraint(const SymConstraint &sc);
+  virtual void push();
+  virtual void pop(unsigned n = 1);
+  virtual unsigned getNumScopes() const { return scopeLits.size(); }
+  virtual unsigned getCheckEpoch() const { return epoch.get(); }
+  // Lingeling polls for the interrupt, so none is lost.
+  virtual void interruptCheck(unsigned e) { epoch.interrupt(e); }
+  void printModel();
+  void getModel(SymModel &m);
+  void reset();
+
+  unsigned getNumVars() const { return numVars; }
+  unsigned getNumClauses() const { return numClauses; }
+  // The gates created, and the ones found in the structural hash table.
+  unsigned getNumGates() const { return numGates; }
+  unsigned getNumGateHits() const { return numGateHits; }
+
+private:
+  // Lingeling literals: a variable, or its negation. The bits of a vector
+  // are stored least significant first.
+  typedef std::vector<int> Bits;
+  enum { TrueLit = 1, FalseLit = -1 };
+  enum { NoUnsupported = ~0u };
+
+  enum GateKind { G_And, G_Xor };
+  struct Gate {
+    GateKind kind;
+    int a, b;
+    // The output variable, 0 for an empty slot.
+    int out;
+  };
+
+  class Translator;
+
+  void init();
+  int newVar();
+  void addClause(int a, int b = 0, int c = 0);
+  unsigned getGateSlot(GateKind kind, int a, int b) const;
+  int lookupGate(GateKind kind, int a, int b, bool &created);
+
+  // Gates on literals, with constants and trivial cases folded.
+  int mkAnd(int a, int b);
+  int mkOr(int a, int b) { return -mkAnd(-a, -b); }
+  int mkXor(int a, int b);
+  int mkIte(int c, int t, int e);
+
+  // Circuits on bit vectors of equal widths.
+  Bits mkConst(const ConstExpr *ce);
+  Bits mkNot(const Bits &a);
+  Bits mkAdd(const Bits &a, const Bits &b, int carry);
+  Bits mkNeg(const Bits &a);
+  Bits mkMul(const Bits &a, const Bits &b);
+  void mkUDivRem(const Bits &a, const Bits &b, Bits &q, Bits &r);
+  Bits mkSDiv(const Bits &a, const Bits &b, bool rem);
+  Bits mkShift(const Bits &a, const Bits &b, bool left);
+  Bits mkIte(int c, const Bits &t, const Bits &e);
+  int mkEq(const Bits &a, const Bits &b);
+  int mkULT(const Bits &a, const Bits &b);
+  int mkSLT(const Bits &a, const Bits &b);
+
+  // supported is false if cond reads an array.
+  Bits genBits(const SymExpr *cond, bool &supported);
+  int getConstraintLit(const SymConstraint &sc, bool &supported);
+  SolverResult check(const std::vector<SymConstraint> *assumptions);
+  // Lingeling's termination callback.
+  static int terminate(void *data);
+
+private:
+  LGL *lgl;
+  unsigned timeout;
+  CheckEpoch epoch;
+  bool timedOut;
+  Timer checkTimer;
+
+  // Open addressing table of the gates, the size is a power of two and at
+  // most half of the slots are used.
+  std::vector<Gate> gates;
+  unsigned numGates;
+  unsigned numGateHits;
+  unsigned numVars;
+  unsigned numClauses;
+
+  DeclTable<Bits> decls;
+  // Translated nodes, keyed by address, and the nodes first translated in
+  // each scope, which pop() forgets, as in Z3Adapter. The client must keep
+  // the SymExprs alive until their scope is popped, or until the next
+  // reset() for the outermost one.
+  std::map<const SymExpr *, Bits> exprCache;
+  std::vector<std::vector<const SymExpr *> > exprsByScope;
+  // The stacks of genBits(), see Z3Adapter::genZ3Expr(), and whether each
+  // result reads an array.
+  std::vector<std::pair<const SymExpr *, bool> > work;
+  std::vector<Bits> results;
+  std::vector<bool> resultsUnsupported;
+
+  // The literal that enables the constraints of each scope.
+  std::vector<int> scopeLits;
+  // The outermost scope with a constraint that reads an array, or
+  // NoUnsupported.
+  unsigned unsupportedDepth;
+
+  std::vector<SymConstraint> lastAssumptions;
+  std::vector<int> lastAssumptionLits;
+
+  // Nodes translated since the last check, and the time it took in
+  // microseconds.
+  unsigned numTranslated;
+  double translateTime;
+};
+
+} // end namespace smt
+
+#endif
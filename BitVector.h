@@ -0,0 +1,143 @@
+#ifndef SMTADAPTER_BIT_VECTOR_H	// -*- C++ -*-
+#define SMTADAPTER_BIT_VECTOR_H
+#include "smtadapter/Symbol.h"
+#include <assert.h>
+#include <stdint.h>
+
+namespace smt {
+
+// Concrete bitvector operations on values of at most 64 bits, kept in the
+// low bits of a uint64_t. They follow the SMT-LIB semantics that Z3 uses,
+// including division by zero and shifts by at least the width, so that
+// folding and evaluation agree with the solver.
+namespace bv {
+
+inline uint64_t mask(unsigned w) {
+  return w >= 64 ? ~(uint64_t)0 : ((uint64_t)1 << w) - 1;
+}
+
+inline uint64_t trunc(uint64_t v, unsigned w) { return v & mask(w); }
+
+inline bool isNegative(uint64_t v, unsigned w) {
+  return (v >> (w - 1)) & 1;
+}
+
+inline int64_t toSigned(uint64_t v, unsigned w) {
+  if (w < 64 && isNegative(v, w))
+    return (int64_t)(v | ~mask(w));
+  return (int64_t)v;
+}
+
+inline uint64_t sext(uint64_t v, unsigned from, unsigned to) {
+  return trunc((uint64_t)toSigned(v, from), to);
+}
+
+inline uint64_t zext(uint64_t v, unsigned from, unsigned) {
+  return trunc(v, from);
+}
+
+inline uint64_t evalArith(ArithOpcode op, uint64_t a, uint64_t b,
+                          unsigned w) {
+  switch (op) {
+  default:
+    assert(0 && "Unprocessed arith opcode.");
+  case BO_Mul:
+    return trunc(a * b, w);
+  case BO_UDiv:
+    return b == 0 ? mask(w) : a / b;
+  case BO_URem:
+    return b == 0 ? a : a % b;
+  case BO_SDiv: {
+    int64_t sa = toSigned(a, w), sb = toSigned(b, w);
+    if (sb == 0)
+      return sa < 0 ? 1 : mask(w);
+    // The overflowing INT_MIN / -1 wraps around to INT_MIN.
+    if (sb == -1)
+      return trunc(0 - a, w);
+    return trunc((uint64_t)(sa / sb), w);
+  }
+  case BO_SRem: {
+    int64_t sa = toSigned(a, w), sb = toSigned(b, w);
+    if (sb == 0)
+      return a;
+    if (sb == -1)
+      return 0;
+    return trunc((uint64_t)(sa % sb), w);
+  }
+  case BO_Add:
+    return trunc(a + b, w);
+  case BO_Sub:
+    return trunc(a - b, w);
+  case BO_Shl:
+    return b >= w ? 0 : trunc(a << b, w);
+  case BO_Shr:
+    return b >= w ? 0 : a >> b;
+  case BO_And:
+    return a & b;
+  case BO_Xor:
+    return a ^ b;
+  case BO_Or:
+    return a | b;
+  }
+}
+
+// Evaluate a comparison of two w bit values, or a logical operator on two
+// Booleans held as 0 and 1.
+inline bool evalLogical(LogicalOpcode op, uint64_t a, uint64_t b,
+                        unsigned w) {
+  switch (op) {
+  default:
+    assert(0 && "Unprocessed logical opcode");
+  case BO_SLT:
+    return toSigned(a, w) < toSigned(b, w);
+  case BO_ULT:
+    return a < b;
+  case BO_SGT:
+    return toSigned(a, w) > toSigned(b, w);
+  case BO_UGT:
+    return a > b;
+  case BO_SLE:
+    return toSigned(a, w) <= toSigned(b, w);
+  case BO_ULE:
+    return a <= b;
+  case BO_SGE:
+    return toSigned(a, w) >= toSigned(b, w);
+  case BO_UGE:
+    return a >= b;
+  case BO_EQ:
+    return a == b;
+  case BO_NE:
+    return a != b;
+  case BO_LAnd:
+    return a && b;
+  case BO_LOr:
+    return a || b;
+  }
+}
+
+inline uint64_t evalUnary(UnaryOpcode op, uint64_t a, unsigned w) {
+  switch (op) {
+  default:
+    assert(0 && "Unprocessed unary opcode.");
+  case UO_Minus:
+    return trunc(0 - a, w);
+  case UO_Not:
+    return trunc(~a, w);
+  case UO_LNot:
+    return !a;
+  }
+}
+
+} // end namespace bv
+
+// Check if e is a Boolean, rather than a bitvector, in the solver.
+inline bool isBoolSymExpr(const SymExpr *e) {
+  if (LogicalSymExpr::classof(e))
+    return true;
+  return UnarySymExpr::classof(e) &&
+    static_cast<const UnarySymExpr *>(e)->getUnaryOpcode() == UO_LNot;
+}
+
+}
+
+#endif
@@ -0,0 +1,404 @@
+#include "smtadapter/SolverContext.h"
+#include "BoolectorAdapter.h"
+#include "Timer.h"
+#include "smtadapter/SolverStats.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+using namespace smt;
+
+namespace {
+
+// Read bits [begin, begin + len) of an assignment string, MSB first. Don't
+// care bits ('x') are taken as 0 and only the low 64 bits are kept.
+uint64_t parseBits(const char *bits, unsigned begin, unsigned len) {
+  uint64_t v = 0;
+  for (unsigned i = begin; i < begin + len; ++i)
+    v = (v << 1) | (bits[i] == '1');
+  return v;
+}
+
+unsigned log2Ceil(unsigned w) {
+  unsigned k = 0;
+  while ((1u << k) < w)
+    ++k;
+  return k;
+}
+
+}
+
+BoolectorAdapter::BoolectorAdapter(SolverContext &sc)
+  : SolverAdapter(sc), btor(0), numTranslated(0), translateTime(0) {
+  init();
+}
+
+BoolectorAdapter::~BoolectorAdapter() {
+  releaseAll();
+  boolector_delete(btor);
+}
+
+void BoolectorAdapter::init() {
+  btor = boolector_new();
+  boolector_enable_model_gen(btor);
+  // Needed for boolector_assume().
+  boolector_enable_inc_usage(btor);
+}
+
+void BoolectorAdapter::releaseAll() {
+  for (unsigned i = 0; i < ownedNodes.size(); ++i)
+    boolector_release(btor, ownedNodes[i]);
+  ownedNodes.clear();
+  decls.clear();
+  regionDims.clear();
+  exprCache.clear();
+  scopedConstraints.clear();
+  lastAssumptionNodes.clear();
+}
+
+BoolectorNode *BoolectorAdapter::own(BoolectorNode *node) {
+  ownedNodes.push_back(node);
+  return node;
+}
+
+SolverResult BoolectorAdapter::checkSat() {
+  return check(0);
+}
+
+SolverResult BoolectorAdapter::checkSatAssuming(
+  const std::vector<SymConstraint> &assumptions) {
+  return check(&assumptions);
+}
+
+SolverResult
+BoolectorAdapter::check(const std::vector<SymConstraint> *assumptions) {
+  lastAssumptions.clear();
+  lastAssumptionNodes.clear();
+  Timer timer;
+  // Assumptions only hold for the next boolector_sat().
+  for (unsigned i = 0; i < scopedConstraints.size(); ++i)
+    boolector_assume(btor, scopedConstraints[i]);
+  if (assumptions) {
+    lastAssumptions = *assumptions;
+    for (unsigned i = 0; i < assumptions->size(); ++i) {
+      BoolectorNode *node = getConstraintNode((*assumptions)[i]);
+      lastAssumptionNodes.push_back(node);
+      boolector_assume(btor, node);
+    }
+  }
+  translateTime += timer.getMicroseconds();
+
+  timer.restart();
+  int result = boolector_sat(btor);
+  QueryStats qs;
+  qs.solveTime = timer.getMicroseconds();
+  qs.result = SAT_Undetermined;
+  if (result == BOOLECTOR_UNSAT)
+    qs.result = SAT_Unsatisfiable;
+  else if (result == BOOLECTOR_SAT)
+    qs.result = SAT_Satisfiable;
+  qs.numNodes = numTranslated;
+  qs.translateTime = translateTime;
+  qs.numDecls = decls.size();
+  numTranslated = 0;
+  translateTime = 0;
+  recordQuery(qs);
+  return qs.result;
+}
+
+void BoolectorAdapter::getFailedAssumptions(
+  std::vector<SymConstraint> &failed) {
+  failed.clear();
+  for (unsigned i = 0; i < lastAssumptionNodes.size(); ++i) {
+    if (boolector_failed(btor, lastAssumptionNodes[i]))
+      failed.push_back(lastAssumptions[i]);
+  }
+}
+
+BoolectorNode *BoolectorAdapter::getConstraintNode(const SymConstraint &sc) {
+  BoolectorNode *cond = genBtorExpr(sc.cond);
+  if (sc.assumption)
+    return cond;
+  return own(boolector_not(btor, cond));
+}
+
+void BoolectorAdapter::assertSymConstraint(const SymConstraint &sc) {
+  Timer timer;
+  BoolectorNode *node = getConstraintNode(sc);
+  translateTime += timer.getMicroseconds();
+  if (scopeMarks.empty())
+    boolector_assert(btor, node);
+  else
+    scopedConstraints.push_back(node);
+}
+
+void BoolectorAdapter::push() {
+  scopeMarks.push_back(scopedConstraints.size());
+}
+
+void BoolectorAdapter::pop(unsigned n) {
+  assert(n <= scopeMarks.size() && "Cannot pop more scopes than pushed.");
+  if (n == 0)
+    return;
+  scopedConstraints.resize(scopeMarks[scopeMarks.size() - n]);
+  scopeMarks.resize(scopeMarks.size() - n);
+  lastAssumptions.clear();
+  lastAssumptionNodes.clear();
+}
+
+void BoolectorAdapter::reset() {
+  // Boolector cannot retract assertions, start over with a new instance.
+  releaseAll();
+  boolector_delete(btor);
+  scopeMarks.clear();
+  lastAssumptions.clear();
+  init();
+}
+
+void BoolectorAdapter::printModel() {
+  SymModel m;
+  getModel(m);
+  m.print(std::cout);
+}
+
+void BoolectorAdapter::getModel(SymModel &sm) {
+  sm.clear();
+  for (DeclTable<BoolectorNode *>::const_iterator it = decls.begin(),
+         ie = decls.end(); it != ie; ++it) {
+    unsigned *dim = regionDims.lookup(it->first);
+    if (!dim) {
+      char *bits = boolector_bv_assignment(btor, it->second);
+      sm.setScalar(it->first, parseBits(bits, 0, strlen(bits)));
+      boolector_free_bv_assignment(btor, bits);
+      continue;
+    }
+
+    char **indices, **values;
+    int size;
+    boolector_array_assignment(btor, it->second, &indices, &values, &size);
+    ArrayValue &av = sm.getOrCreateArray(it->first);
+    unsigned indexSize = ctx.getArrayIndexTypeSizeInBits();
+    for (int i = 0; i < size; ++i) {
+      // Split the flattened index, outermost dimension first.
+      ArrayValue::Index index;
+      for (unsigned d = 0; d < *dim; ++d)
+        index.push_back(parseBits(indices[i], d * indexSize, indexSize));
+      av.setValue(index, parseBits(values[i], 0, strlen(values[i])));
+    }
+    if (size > 0)
+      boolector_free_array_assignment(btor, indices, values, size);
+  }
+}
+
+BoolectorNode *BoolectorAdapter::genBtorExpr(const SymExpr *cond) {
+  std::map<const SymExpr *, BoolectorNode *>::iterator it =
+    exprCache.find(cond);
+  if (it != exprCache.end())
+    return it->second;
+  BoolectorNode *e = translateSymExpr(cond);
+  exprCache.insert(std::pair<const SymExpr *, BoolectorNode *>(cond, e));
+  ++numTranslated;
+  return e;
+}
+
+BoolectorNode *BoolectorAdapter::translateSymExpr(const SymExpr *cond) {
+  switch (cond->getKind()) {
+  default: {
+    assert(0 && "Unprocessed boolector expr.");
+    exit(1);
+  }
+  case SymExpr::S_ScalarSymbol: {
+    const Symbol *sym = static_cast<const Symbol *>(cond);
+    unsigned id = sym->getSymbolID();
+    if (BoolectorNode **decl = decls.lookup(id))
+      return *decl;
+    return decls.insert(id, own(boolector_var(btor,
+                                              sym->getBitWidth(ctx),
+                                              names.get(sym))));
+  }
+  case SymExpr::S_RegionSymbol: {
+    const RegionSymbol *asym = static_cast<const RegionSymbol *>(cond);
+    unsigned id = asym->getSymbolID();
+    if (BoolectorNode **decl = decls.lookup(id))
+      return *decl;
+    unsigned indexSize = ctx.getArrayIndexTypeSizeInBits();
+    unsigned elemSize = asym->getElementTypeSizeInBits(ctx);
+    unsigned nDim = asym->getNumberDimension(ctx);
+    regionDims.insert(id, nDim);
+    return decls.insert(id, own(boolector_array(btor, elemSize,
+                                                indexSize * nDim,
+                                                names.get(asym))));
+  }
+  case SymExpr::S_ElemSymExpr:
+    return genBtorElem(static_cast<const ElemSymExpr *>(cond));
+  case SymExpr::S_ArithSymExpr: {
+    const ArithSymExpr *bin = static_cast<const ArithSymExpr *>(cond);
+    BoolectorNode *e1 = genBtorExpr(bin->getLHS());
+    BoolectorNode *e2 = genBtorExpr(bin->getRHS());
+    switch(bin->getOpcode()) {
+    default:
+      assert(0 && "Unprocessed arith opcode.");
+    case BO_Mul:
+      return own(boolector_mul(btor, e1, e2));
+    case BO_SDiv:
+      return own(boolector_sdiv(btor, e1, e2));
+    case BO_UDiv:
+      return own(boolector_udiv(btor, e1, e2));
+    case BO_SRem:
+      return own(boolector_srem(btor, e1, e2));
+    case BO_URem:
+      return own(boolector_urem(btor, e1, e2));
+    case BO_Add:
+      return own(boolector_add(btor, e1, e2));
+    case BO_Sub:
+      return own(boolector_sub(btor, e1, e2));
+    case BO_Shl:
+      return genBtorShift(e1, e2, true);
+    case BO_Shr:
+      return genBtorShift(e1, e2, false);
+    case BO_And:
+      return own(boolector_and(btor, e1, e2));
+    case BO_Xor:
+      return own(boolector_xor(btor, e1, e2));
+    case BO_Or:
+      return own(boolector_or(btor, e1, e2));
+    }
+  }
+  case SymExpr::S_LogicalSymExpr: {
+    const LogicalSymExpr *bin = static_cast<const LogicalSymExpr *>(cond);
+    BoolectorNode *e1 = genBtorExpr(bin->getLHS());
+    BoolectorNode *e2 = genBtorExpr(bin->getRHS());
+    switch(bin->getOpcode()) {
+    default:
+      assert(0 && "Unprocessed logical opcode");
+    case BO_SLT:
+      return own(boolector_slt(btor, e1, e2));
+    case BO_ULT:
+      return own(boolector_ult(btor, e1, e2));
+    case BO_SGT:
+      return own(boolector_sgt(btor, e1, e2));
+    case BO_UGT:
+      return own(boolector_ugt(btor, e1, e2));
+    case BO_SLE:
+      return own(boolector_slte(btor, e1, e2));
+    case BO_ULE:
+      return own(boolector_ulte(btor, e1, e2));
+    case BO_SGE:
+      return own(boolector_sgte(btor, e1, e2));
+    case BO_UGE:
+      return own(boolector_ugte(btor, e1, e2));
+    case BO_EQ:
+      return own(boolector_eq(btor, e1, e2));
+    case BO_NE:
+      return own(boolector_ne(btor, e1, e2));
+    // Booleans are bitvectors of width 1.
+    case BO_LAnd:
+      return own(boolector_and(btor, e1, e2));
+    case BO_LOr:
+      return own(boolector_or(btor, e1, e2));
+    }
+  }
+  case SymExpr::S_UnarySymExpr: {
+    const UnarySymExpr *un = static_cast<const UnarySymExpr *>(cond);
+    BoolectorNode *e = genBtorExpr(un->getOperand());
+    switch(un->getUnaryOpcode()) {
+      case UO_Minus:
+        return own(boolector_neg(btor, e));
+      case UO_Not:
+      case UO_LNot:
+        return own(boolector_not(btor, e));
+    }
+  }
+  case SymExpr::S_TruncSymExpr: {
+    const TruncSymExpr *ce = static_cast<const TruncSymExpr *>(cond);
+    BoolectorNode *e = genBtorExpr(ce->getOperand());
+    return own(boolector_slice(btor, e, ce->getBitWidth(ctx) - 1, 0));
+  }
+  case SymExpr::S_ExtendSymExpr: {
+    const ExtendSymExpr *ce = static_cast<const ExtendSymExpr *>(cond);
+    const SymExpr *operand = ce->getOperand();
+    BoolectorNode *e = genBtorExpr(operand);
+    int newBitSize = ce->getBitWidth(ctx);
+    int oldBitSize = boolector_get_width(btor, e);
+    int sizeDiff = newBitSize - oldBitSize;
+    assert(sizeDiff > 0 && "The targe type size should be greater than old type size.");
+
+    // A LogicalSymExpr extends to 0 or 1, as the ite in Z3Adapter.
+    if(ce->isSignedExt() && !LogicalSymExpr::classof(operand))
+      return own(boolector_sext(btor, e, sizeDiff));
+    return own(boolector_uext(btor, e, sizeDiff));
+  }
+  case SymExpr::S_ConstExpr:
+    return genBtorConst(static_cast<const ConstExpr *>(cond));
+  }
+}
+
+BoolectorNode *BoolectorAdapter::genBtorConst(const ConstExpr *ce) {
+  unsigned sz = ce->getBitWidth(ctx);
+  uint64_t v = (uint64_t)ce->getValue();
+  // Bits above 64 repeat the sign of a signed value, like genZ3Const.
+  char fill = (ce->isSigned() && (long long)v < 0) ? '1' : '0';
+  std::string bits(sz, fill);
+  for (unsigned i = 0; i < sz && i < 64; ++i)
+    bits[sz - 1 - i] = ((v >> i) & 1) ? '1' : '0';
+  return own(boolector_const(btor, bits.c_str()));
+}
+
+// Boolector shifts a power of two width by a log2 width amount. Widen the
+// operand to the next power of two, and give 0 for amounts of at least the
+// width, as Z3's bvshl/bvlshr do.
+BoolectorNode *BoolectorAdapter::genBtorShift(BoolectorNode *e1,
+                                              BoolectorNode *e2,
+                                              bool left) {
+  unsigned width = boolector_get_width(btor, e1);
+  unsigned k = log2Ceil(width);
+  if (k == 0)
+    k = 1;
+  unsigned pow2 = 1u << k;
+
+  BoolectorNode *op = e1;
+  if (pow2 > width)
+    op = own(boolector_uext(btor, e1, pow2 - width));
+  BoolectorNode *amount;
+  if (width > k)
+    amount = own(boolector_slice(btor, e2, k - 1, 0));
+  else if (width < k)
+    amount = own(boolector_uext(btor, e2, k - width));
+  else
+    amount = e2;
+
+  BoolectorNode *shifted = own(left ? boolector_sll(btor, op, amount)
+                                    : boolector_srl(btor, op, amount));
+  if (pow2 > width)
+    shifted = own(boolector_slice(btor, shifted, width - 1, 0));
+
+  std::string widthBits(width, '0');
+  for (unsigned i = 0; i < width && i < 32; ++i)
+    widthBits[width - 1 - i] = ((width >> i) & 1) ? '1' : '0';
+  BoolectorNode *limit = own(boolector_const(btor, widthBits.c_str()));
+  BoolectorNode *tooFar = own(boolector_ugte(btor, e2, limit));
+  BoolectorNode *zero = own(boolector_zero(btor, width));
+  return own(boolector_cond(btor, tooFar, zero, shifted));
+}
+
+BoolectorNode *BoolectorAdapter::genBtorElem(const ElemSymExpr *elem) {
+  // Collect the indices of a[i1][i2]...[in], outermost first.
+  std::vector<const SymExpr *> indices;
+  const SymExpr *base = elem;
+  while (ElemSymExpr::classof(base)) {
+    const ElemSymExpr *e = static_cast<const ElemSymExpr *>(base);
+    indices.push_back(e->getIndexExpr());
+    base = e->getBaseExpr();
+  }
+  assert(RegionSymbol::classof(base) && "Unknown array base.");
+  const RegionSymbol *region = static_cast<const RegionSymbol *>(base);
+  assert(indices.size() == region->getNumberDimension(ctx) &&
+         "Partial array reads are not supported by Boolector.");
+
+  BoolectorNode *array = genBtorExpr(region);
+  BoolectorNode *index = genBtorExpr(indices.back());
+  for (int i = indices.size() - 2; i >= 0; --i)
+    index = own(boolector_concat(btor, index, genBtorExpr(indices[i])));
+  return own(boolector_read(btor, array, index));
+}
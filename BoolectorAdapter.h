@@ -0,0 +1,80 @@
+#ifndef SMTADAPTER_BOOLECTOR_ADAPTER_H	// -*- C++ -*-
+#define SMTADAPTER_BOOLECTOR_ADAPTER_H
+#include "DeclTable.h"
+#include "smtadapter/SolverAdapter.h"
+#include "smtadapter/Symbol.h"
+#include "smtadapter/SymModel.h"
+#include "boolector.h"
+#include <map>
+#include <string>
+#include <vector>
+
+namespace smt {
+
+// A SolverAdapter on top of Boolector. Boolector has no assertion scopes,
+// so only the constraints of the outermost scope are asserted; the ones of
+// inner scopes are passed as assumptions to every check.
+//
+// Boolector arrays are one dimensional: an n dimensional RegionSymbol is
+// flattened into one array indexed by the concatenation of its n indices,
+// and only complete element reads are supported.
+class BoolectorAdapter : public SolverAdapter {
+public:
+  BoolectorAdapter(SolverContext &sc);
+  ~BoolectorAdapter();
+
+  //override
+  virtual SolverResult checkSat();
+  virtual SolverResult
+  checkSatAssuming(const std::vector<SymConstraint> &assumptions);
+  virtual void getFailedAssumptions(std::vector<SymConstraint> &failed);
+  virtual void assertSymConstraint(const SymConstraint &sc);
+  virtual void push();
+  virtual void pop(unsigned n = 1);
+  virtual unsigned getNumScopes() const { return scopeMarks.size(); }
+
+  // Translate a SymExpr DAG into Boolector. The nodes are owned by the
+  // adapter and released by reset().
+  BoolectorNode *genBtorExpr(const SymExpr *cond);
+  void printModel();
+  void getModel(SymModel &m);
+  void reset();
+
+private:
+  void init();
+  void releaseAll();
+  SolverResult check(const std::vector<SymConstraint> *assumptions);
+  BoolectorNode *own(BoolectorNode *node);
+  BoolectorNode *translateSymExpr(const SymExpr *cond);
+  BoolectorNode *genBtorConst(const ConstExpr *ce);
+  BoolectorNode *genBtorShift(BoolectorNode *e1, BoolectorNode *e2,
+                              bool left);
+  BoolectorNode *genBtorElem(const ElemSymExpr *elem);
+  BoolectorNode *getConstraintNode(const SymConstraint &sc);
+
+private:
+  Btor *btor;
+  DeclTable<BoolectorNode *> decls;
+  // Number of dimensions of each declared RegionSymbol.
+  DeclTable<unsigned> regionDims;
+  SymbolNames names;
+  std::map<const SymExpr *, BoolectorNode *> exprCache;
+  // Every node the adapter holds a reference to.
+  std::vector<BoolectorNode *> ownedNodes;
+
+  // The constraints of the inner scopes, and their start at each push().
+  std::vector<BoolectorNode *> scopedConstraints;
+  std::vector<unsigned> scopeMarks;
+
+  std::vector<SymConstraint> lastAssumptions;
+  std::vector<BoolectorNode *> lastAssumptionNodes;
+
+  // Nodes translated since the last check, and the time it took in
+  // microseconds.
+  unsigned numTranslated;
+  double translateTime;
+};
+
+} // end namespace smt
+
+#endif
@@ -0,0 +1,240 @@
+#include "CachingSolverAdapter.h"
+#include <algorithm>
+#include <iostream>
+
+using namespace smt;
+
+namespace {
+
+// The entries scanned for a subset or superset on an exact miss, newest
+// first.
+const unsigned MaxScannedEntries = 256;
+// The uniqued nodes kept per entry on average before the cache starts
+// over.
+const unsigned MaxNodesPerEntry = 256;
+
+uint64_t hashSymConstraint(const SymConstraint &sc) {
+  // splitmix64 finalizer
+  uint64_t h = (uint64_t)sc.cond->getHashValue() * 2 + sc.assumption;
+  h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+  return h ^ (h >> 31);
+}
+
+}
+
+CachingSolverAdapter::CachingSolverAdapter(SolverAdapter *b,
+                                           unsigned cap)
+  : SolverAdapterLayer(b), mgr(b->getContext()), capacity(cap), nextEntry(0),
+    lastFromCache(false), numExactHits(0), numUnsatSubsetHits(0),
+    numSatSupersetHits(0), numMisses(0) {
+  assert(capacity > 0 && "The cache needs at least one entry.");
+}
+
+SymConstraint CachingSolverAdapter::import(const SymConstraint &sc) {
+  return SymConstraint(mgr.import(sc.cond), sc.assumption);
+}
+
+void CachingSolverAdapter::canonicalize(ConstraintSet &set, uint64_t &hash,
+                                        uint64_t &signature) {
+  std::sort(set.begin(), set.end(), SymConstraintLess());
+  set.erase(std::unique(set.begin(), set.end()), set.end());
+  hash = set.size();
+  signature = 0;
+  for (unsigned i = 0; i < set.size(); ++i) {
+    uint64_t h = hashSymConstraint(set[i]);
+    hash = (hash ^ h) * 0x100000001b3ULL + (hash >> 29);
+    signature |= (uint64_t)1 << (h & 63);
+  }
+}
+
+const CachingSolverAdapter::CacheEntry *
+CachingSolverAdapter::lookup(const ConstraintSet &key, uint64_t hash,
+                             uint64_t signature) {
+  typedef std::multimap<uint64_t, unsigned>::iterator HashIt;
+  std::pair<HashIt, HashIt> range = hashIndex.equal_range(hash);
+  for (HashIt it = range.first; it != range.second; ++it) {
+    const CacheEntry &entry = entries[it->second];
+    if (entry.key == key) {
+      ++numExactHits;
+      return &entry;
+    }
+  }
+
+  unsigned size = entries.size();
+  for (unsigned i = 0; i < size && i < MaxScannedEntries; ++i) {
+    const CacheEntry &entry = entries[(nextEntry + size - 1 - i) % size];
+    if (entry.result == SAT_Unsatisfiable) {
+      // A superset of an UNSAT set is UNSAT.
+      if ((entry.signature & ~signature) == 0 &&
+          entry.key.size() <= key.size() &&
+          std::includes(key.begin(), key.end(),
+                        entry.key.begin(), entry.key.end(),
+                        SymConstraintLess())) {
+        ++numUnsatSubsetHits;
+        return &entry;
+      }
+    } else if ((signature & ~entry.signature) == 0 &&
+               key.size() <= entry.key.size() &&
+               std::includes(entry.key.begin(), entry.key.end(),
+                             key.begin(), key.end(), SymConstraintLess())) {
+      // A model of a SAT superset satisfies the subset.
+      ++numSatSupersetHits;
+      return &entry;
+    }
+  }
+  ++numMisses;
+  return 0;
+}
+
+void CachingSolverAdapter::insert(const ConstraintSet &key,
+                                  SolverResult result) {
+  // Timeouts may go either way on the next try.
+  if (result != SAT_Satisfiable && result != SAT_Unsatisfiable)
+    return;
+
+  ConstraintSet set = key;
+  uint64_t hash, signature;
+  canonicalize(set, hash, signature);
+
+  unsigned slot = nextEntry;
+  nextEntry = (nextEntry + 1) % capacity;
+  if (slot == entries.size()) {
+    entries.push_back(CacheEntry());
+  } else {
+    typedef std::multimap<uint64_t, unsigned>::iterator HashIt;
+    std::pair<HashIt, HashIt> range =
+      hashIndex.equal_range(entries[slot].hash);
+    for (HashIt it = range.first; it != range.second; ++it) {
+      if (it->second == slot) {
+        hashIndex.erase(it);
+        break;
+      }
+    }
+  }
+
+  CacheEntry &entry = entries[slot];
+  entry.key.swap(set);
+  entry.hash = hash;
+  entry.signature = signature;
+  entry.result = result;
+  if (result == SAT_Satisfiable)
+    entry.model = lastModel;
+  else
+    entry.model.clear();
+  hashIndex.insert(std::pair<uint64_t, unsigned>(hash, slot));
+}
+
+SolverResult CachingSolverAdapter::getCachedResult(const CacheEntry *entry) {
+  lastFromCache = true;
+  if (entry->result == SAT_Satisfiable)
+    lastModel = entry->model;
+  return entry->result;
+}
+
+SolverResult CachingSolverAdapter::checkSat() {
+  epoch.begin();
+  if (mgr.getNumNodes() > capacity * MaxNodesPerEntry)
+    clearCache();
+  ConstraintSet key = importedConstraints;
+  uint64_t hash, signature;
+  canonicalize(key, hash, signature);
+  if (const CacheEntry *entry = lookup(key, hash, signature))
+    return getCachedResult(entry);
+
+  lastFromCache = false;
+  SolverResult result = checkBackend(0);
+  if (result == SAT_Satisfiable)
+    backend->getModel(lastModel);
+  insert(key, result);
+  return result;
+}
+
+SolverResult CachingSolverAdapter::checkSatAssuming(
+  const std::vector<SymConstraint> &assumptions) {
+  epoch.begin();
+  if (mgr.getNumNodes() > capacity * MaxNodesPerEntry)
+    clearCache();
+  lastFailed.clear();
+  ConstraintSet importedAssumptions;
+  for (unsigned i = 0; i < assumptions.size(); ++i)
+    importedAssumptions.push_back(import(assumptions[i]));
+  ConstraintSet key = importedConstraints;
+  key.insert(key.end(), importedAssumptions.begin(),
+             importedAssumptions.end());
+  uint64_t hash, signature;
+  canonicalize(key, hash, signature);
+  if (const CacheEntry *entry = lookup(key, hash, signature)) {
+    if (entry->result == SAT_Unsatisfiable) {
+      // The assumptions in the cached set are enough to be UNSAT.
+      for (unsigned i = 0; i < assumptions.size(); ++i) {
+        if (std::binary_search(entry->key.begin(), entry->key.end(),
+                               importedAssumptions[i], SymConstraintLess()))
+          lastFailed.push_back(assumptions[i]);
+      }
+    }
+    return getCachedResult(entry);
+  }
+
+  lastFromCache = false;
+  SolverResult result = checkBackend(&assumptions);
+  if (result == SAT_Satisfiable) {
+    backend->getModel(lastModel);
+    insert(key, result);
+  } else if (result == SAT_Unsatisfiable) {
+    // Cache the smaller set so that it matches more queries.
+    backend->getFailedAssumptions(lastFailed);
+    ConstraintSet core = importedConstraints;
+    for (unsigned i = 0; i < lastFailed.size(); ++i)
+      core.push_back(import(lastFailed[i]));
+    insert(core, result);
+  }
+  return result;
+}
+
+void CachingSolverAdapter::getFailedAssumptions(
+  std::vector<SymConstraint> &failed) {
+  failed = lastFailed;
+}
+
+void CachingSolverAdapter::assertSymConstraint(const SymConstraint &sc) {
+  SolverAdapterLayer::assertSymConstraint(sc);
+  importedConstraints.push_back(import(sc));
+}
+
+void CachingSolverAdapter::printModel() {
+  if (lastFromCache)
+    lastModel.print(std::cout);
+  else
+    backend->printModel();
+}
+
+void CachingSolverAdapter::getModel(SymModel &m) {
+  m = lastModel;
+}
+
+void CachingSolverAdapter::reset() {
+  SolverAdapterLayer::reset();
+  clearCache();
+}
+
+void CachingSolverAdapter::pop(unsigned n) {
+  SolverAdapterLayer::pop(n);
+  importedConstraints.erase(importedConstraints.begin() + constraints.size(),
+                            importedConstraints.end());
+}
+
+void CachingSolverAdapter::clearCache() {
+  entries.clear();
+  hashIndex.clear();
+  nextEntry = 0;
+  // The copies of the asserted constraints are made again in the new
+  // manager.
+  mgr.clear();
+  importedConstraints.clear();
+  for (unsigned i = 0; i < constraints.size(); ++i)
+    importedConstraints.push_back(import(constraints[i]));
+  lastModel.clear();
+  lastFromCache = false;
+  lastFailed.clear();
+}
@@ -0,0 +1,88 @@
+#ifndef SMTADAPTER_CACHING_SOLVER_ADAPTER_H	// -*- C++ -*-
+#define SMTADAPTER_CACHING_SOLVER_ADAPTER_H
+#include "SolverAdapterLayer.h"
+#include "smtadapter/SymExprManager.h"
+#include <map>
+#include <vector>
+#include <stdint.h>
+
+namespace smt {
+
+// Cache the results of the queries sent to the backend, keyed by the set of
+// constraints of the query. Besides exact matches, a query is answered when
+// a cached UNSAT set is a subset of it, or when it is a subset of a cached
+// SAT set, whose model then satisfies the query too; only the most recent
+// entries are scanned for those.
+//
+// Keys hold the copies of the constraints uniqued by a SymExprManager of
+// the cache, so that structurally equal constraints built apart match, and
+// the client may free its SymExprs once their query is done. The copies
+// are made on every check, and the cache starts over when they grow too
+// many.
+class CachingSolverAdapter : public SolverAdapterLayer {
+public:
+  // Sorted and without duplicates.
+  typedef std::vector<SymConstraint> ConstraintSet;
+
+  CachingSolverAdapter(SolverAdapter *b, unsigned capacity = 4096);
+
+  virtual SolverResult checkSat();
+  virtual SolverResult
+  checkSatAssuming(const std::vector<SymConstraint> &assumptions);
+  virtual void getFailedAssumptions(std::vector<SymConstraint> &failed);
+  virtual void assertSymConstraint(const SymConstraint &sc);
+  virtual void printModel();
+  virtual void getModel(SymModel &m);
+  virtual void reset();
+  virtual void pop(unsigned n = 1);
+
+  void clearCache();
+
+  unsigned getNumExactHits() const { return numExactHits; }
+  unsigned getNumUnsatSubsetHits() const { return numUnsatSubsetHits; }
+  unsigned getNumSatSupersetHits() const { return numSatSupersetHits; }
+  unsigned getNumMisses() const { return numMisses; }
+
+private:
+  struct CacheEntry {
+    ConstraintSet key;
+    uint64_t hash;
+    // One bit per constraint hash, for a quick subset test.
+    uint64_t signature;
+    SolverResult result;
+    SymModel model;
+  };
+
+  SymConstraint import(const SymConstraint &sc);
+  void canonicalize(ConstraintSet &set, uint64_t &hash, uint64_t &signature);
+  const CacheEntry *lookup(const ConstraintSet &key, uint64_t hash,
+                           uint64_t signature);
+  void insert(const ConstraintSet &key, SolverResult result);
+  SolverResult getCachedResult(const CacheEntry *entry);
+
+private:
+  SymExprManager mgr;
+  // The copies of the asserted constraints.
+  ConstraintSet importedConstraints;
+
+  // A ring buffer, the oldest entry is evicted first.
+  std::vector<CacheEntry> entries;
+  unsigned capacity;
+  unsigned nextEntry;
+  std::multimap<uint64_t, unsigned> hashIndex;
+
+  // The model of the last satisfiable query, and whether it came from the
+  // cache rather than the backend.
+  SymModel lastModel;
+  bool lastFromCache;
+  std::vector<SymConstraint> lastFailed;
+
+  unsigned numExactHits;
+  unsigned numUnsatSubsetHits;
+  unsigned numSatSupersetHits;
+  unsigned numMisses;
+};
+
+}
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef SMTADAPTER_CHECK_EPOCH_H	// -*- C++ -*-
+#define SMTADAPTER_CHECK_EPOCH_H
+#include <atomic>
+
+namespace smt {
+
+// The numbers of the checks of an adapter and the check interrupted last,
+// see SolverAdapter::interruptCheck(). An interrupt names its check, so one
+// that arrives after its check finished never reaches a later check. Of the
+// interrupts of checks that have not started, only the last one is kept.
+class CheckEpoch {
+  // The running check, or the last one; 0 before the first.
+  std::atomic<unsigned> current;
+  std::atomic<unsigned> interrupted;
+
+public:
+  CheckEpoch() : current(0), interrupted(0) {}
+
+  unsigned get() const { return current; }
+  // Start the next check and return its number.
+  unsigned begin() { return ++current; }
+  // Interrupt the check numbered epoch, and return whether it is the
+  // current one, which the caller may have to stop.
+  bool interrupt(unsigned epoch) {
+    if (epoch < current)
+      return false;
+    interrupted = epoch;
+    return epoch == current;
+  }
+  // Whether the current check was interrupted.
+  bool isInterrupted() const { return current && interrupted == current; }
+};
+
+}
+
+#endif
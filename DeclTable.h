@@ -0,0 +1,112 @@
+#ifndef SMTADAPTER_DECL_TABLE_H	// -*- C++ -*-
+#define SMTADAPTER_DECL_TABLE_H
+#include "smtadapter/Symbol.h"
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace smt {
+
+// The declarations of an adapter, keyed by Symbol ID. Symbol IDs are
+// mostly dense, so an ID below twice the number of entries (plus some
+// slack) is looked up in a vector indexed by ID; the others go to an open
+// addressing hash table. Entries are stored contiguously in insertion
+// order, so T needs no default constructor and iteration is cheap.
+template <typename T>
+class DeclTable {
+public:
+  typedef std::pair<unsigned, T> Entry;
+  typedef typename std::vector<Entry>::const_iterator const_iterator;
+
+private:
+  enum { DenseSlack = 256 };
+
+  std::vector<Entry> entries;
+  // The index of the entry plus one, 0 for none.
+  std::vector<unsigned> dense;
+  // (ID, index of the entry plus one) with linear probing; the size is 0 or
+  // a power of two, and at most half of the slots are used.
+  std::vector<std::pair<unsigned, unsigned> > sparse;
+  unsigned numSparse;
+
+  unsigned getSlot(unsigned id) const {
+    unsigned mask = sparse.size() - 1;
+    unsigned i = (id * 2654435761u) & mask;
+    while (sparse[i].second && sparse[i].first != id)
+      i = (i + 1) & mask;
+    return i;
+  }
+
+  void growSparse() {
+    std::vector<std::pair<unsigned, unsigned> > old;
+    old.swap(sparse);
+    sparse.assign(old.empty() ? 16 : old.size() * 2,
+                  std::pair<unsigned, unsigned>(0, 0));
+    for (unsigned i = 0; i < old.size(); ++i)
+      if (old[i].second)
+        sparse[getSlot(old[i].first)] = old[i];
+  }
+
+public:
+  DeclTable() : numSparse(0) {}
+
+  T *lookup(unsigned id) {
+    if (id < dense.size() && dense[id])
+      return &entries[dense[id] - 1].second;
+    if (!numSparse)
+      return 0;
+    std::pair<unsigned, unsigned> &slot = sparse[getSlot(id)];
+    return slot.second ? &entries[slot.second - 1].second : 0;
+  }
+
+  // Add the entry of an absent ID. The reference, like those returned by
+  // lookup(), is valid until the next insert().
+  T &insert(unsigned id, const T &v) {
+    assert(!lookup(id) && "The ID is declared already.");
+    entries.push_back(Entry(id, v));
+    unsigned index = entries.size();
+    if (id < 2 * entries.size() + DenseSlack) {
+      if (id >= dense.size())
+        dense.resize(id + 1 > 2 * dense.size() ? id + 1 : 2 * dense.size());
+      dense[id] = index;
+    } else {
+      if (2 * (numSparse + 1) > sparse.size())
+        growSparse();
+      sparse[getSlot(id)] = std::pair<unsigned, unsigned>(id, index);
+      ++numSparse;
+    }
+    return entries.back().second;
+  }
+
+  // Forget the entries but keep the storage.
+  void clear() {
+    entries.clear();
+    dense.assign(dense.size(), 0);
+    if (numSparse)
+      sparse.assign(sparse.size(), std::pair<unsigned, unsigned>(0, 0));
+    numSparse = 0;
+  }
+
+  unsigned size() const { return entries.size(); }
+  const_iterator begin() const { return entries.begin(); }
+  const_iterator end() const { return entries.end(); }
+};
+
+// The names of the symbols an adapter declares, formatted once per ID. They
+// outlive reset(), since the same symbols are usually declared again.
+class SymbolNames {
+  DeclTable<std::string> names;
+
+public:
+  // The pointer is valid until the next call.
+  const char *get(const Symbol *sym) {
+    unsigned id = sym->getSymbolID();
+    if (std::string *name = names.lookup(id))
+      return name->c_str();
+    return names.insert(id, sym->getSymName()).c_str();
+  }
+};
+
+} // end namespace smt
+
+#endif
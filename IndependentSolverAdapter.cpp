@@ -0,0 +1,257 @@
+#include "IndependentSolverAdapter.h"
+#include "smtadapter/Symbol.h"
+#include "smtadapter/SymExprVisitor.h"
+#include <algorithm>
+#include <iostream>
+#include <set>
+
+using namespace smt;
+
+IndependentSolverAdapter::IndependentSolverAdapter(SolverAdapter *b)
+  : SolverAdapterLayer(b), deferredResult(SAT_Satisfiable), numQueries(0),
+    numSlices(0), numConstraints(0), numSentConstraints(0) {}
+
+const IndependentSolverAdapter::SymbolSet &
+IndependentSolverAdapter::getSymbols(const SymExpr *root) {
+  std::map<const SymExpr *, SymbolSet>::iterator it = symbolCache.find(root);
+  if (it != symbolCache.end())
+    return it->second;
+
+  // Walk the DAG with an explicit stack, so that deep chains cannot
+  // overflow the native stack. Only the roots are cached; a set for every
+  // inner node would take memory quadratic in the depth of a chain.
+  SymbolSet syms;
+  std::set<const SymExpr *> visited;
+  std::vector<const SymExpr *> work(1, root);
+  while (!work.empty()) {
+    const SymExpr *e = work.back();
+    work.pop_back();
+    if (!visited.insert(e).second)
+      continue;
+    if (Symbol::classof(e)) {
+      syms.push_back(static_cast<const Symbol *>(e)->getSymbolID());
+      continue;
+    }
+    const SymExpr *ops[2];
+    for (unsigned n = getSymExprOperands(e, ops); n > 0; --n)
+      work.push_back(ops[n - 1]);
+  }
+  std::sort(syms.begin(), syms.end());
+  syms.erase(std::unique(syms.begin(), syms.end()), syms.end());
+  return symbolCache.insert(
+    std::pair<const SymExpr *, SymbolSet>(root, syms)).first->second;
+}
+
+unsigned IndependentSolverAdapter::findRoot(
+  std::map<unsigned, unsigned> &parent, unsigned id) {
+  std::map<unsigned, unsigned>::iterator it = parent.find(id);
+  if (it == parent.end()) {
+    parent.insert(std::pair<unsigned, unsigned>(id, id));
+    return id;
+  }
+  unsigned root = it->second;
+  for (unsigned next; (next = parent.find(root)->second) != root;)
+    root = next;
+  // Point the whole path at the root.
+  while (id != root) {
+    it = parent.find(id);
+    id = it->second;
+    it->second = root;
+  }
+  return root;
+}
+
+void IndependentSolverAdapter::partition(
+  const std::vector<SymConstraint> &assumptions,
+  std::vector<std::vector<SymConstraint> > &slices,
+  std::vector<bool> &relevant) {
+  std::map<unsigned, unsigned> parent;
+  for (unsigned i = 0; i < constraints.size(); ++i) {
+    const SymbolSet &syms = getSymbols(constraints[i].cond);
+    for (unsigned j = 1; j < syms.size(); ++j) {
+      unsigned r1 = findRoot(parent, syms[0]);
+      unsigned r2 = findRoot(parent, syms[j]);
+      if (r1 != r2)
+        parent[r2] = r1;
+    }
+  }
+
+  // Map each root to a slice.
+  std::map<unsigned, unsigned> sliceOf;
+  std::vector<SymConstraint> ground;
+  for (unsigned i = 0; i < constraints.size(); ++i) {
+    const SymbolSet &syms = getSymbols(constraints[i].cond);
+    if (syms.empty()) {
+      ground.push_back(constraints[i]);
+      continue;
+    }
+    unsigned root = findRoot(parent, syms[0]);
+    std::map<unsigned, unsigned>::iterator it = sliceOf.find(root);
+    if (it == sliceOf.end()) {
+      it = sliceOf.insert(
+        std::pair<unsigned, unsigned>(root, slices.size())).first;
+      slices.push_back(std::vector<SymConstraint>());
+    }
+    slices[it->second].push_back(constraints[i]);
+  }
+  if (slices.empty() && !ground.empty())
+    slices.push_back(std::vector<SymConstraint>());
+  for (unsigned i = 0; i < slices.size(); ++i)
+    slices[i].insert(slices[i].end(), ground.begin(), ground.end());
+
+  relevant.assign(slices.size(), false);
+  for (unsigned i = 0; i < assumptions.size(); ++i) {
+    const SymbolSet &syms = getSymbols(assumptions[i].cond);
+    for (unsigned j = 0; j < syms.size(); ++j) {
+      std::map<unsigned, unsigned>::iterator it =
+        sliceOf.find(findRoot(parent, syms[j]));
+      if (it != sliceOf.end())
+        relevant[it->second] = true;
+    }
+  }
+}
+
+void IndependentSolverAdapter::copySymbols(const SymModel &m,
+                                           const SymbolSet &syms) {
+  for (unsigned i = 0; i < syms.size(); ++i) {
+    uint64_t v;
+    if (m.getScalar(syms[i], v))
+      lastModel.setScalar(syms[i], v);
+    else if (const ArrayValue *av = m.getArray(syms[i]))
+      lastModel.getOrCreateArray(syms[i]) = *av;
+  }
+}
+
+SolverResult IndependentSolverAdapter::checkSlice(
+  const std::vector<SymConstraint> &slice,
+  const std::vector<SymConstraint> *assumptions, bool deferred) {
+  ++numSlices;
+  numSentConstraints += slice.size();
+  backend->push();
+  for (unsigned i = 0; i < slice.size(); ++i)
+    backend->assertSymConstraint(slice[i]);
+  SolverResult result = deferred ? backend->checkSat()
+    : checkBackend(assumptions);
+  if (assumptions && result == SAT_Unsatisfiable)
+    backend->getFailedAssumptions(lastFailed);
+  if (result == SAT_Satisfiable) {
+    SymModel m;
+    backend->getModel(m);
+    // A backend may also report the symbols of earlier slices.
+    for (unsigned i = 0; i < slice.size(); ++i)
+      copySymbols(m, getSymbols(slice[i].cond));
+    if (assumptions) {
+      for (unsigned i = 0; i < assumptions->size(); ++i)
+        copySymbols(m, getSymbols((*assumptions)[i].cond));
+    }
+  }
+  backend->pop();
+  return result;
+}
+
+SolverResult IndependentSolverAdapter::checkSat() {
+  epoch.begin();
+  ++numQueries;
+  numConstraints += constraints.size();
+  lastModel.clear();
+  pendingSlices.clear();
+  deferredResult = SAT_Satisfiable;
+
+  std::vector<std::vector<SymConstraint> > slices;
+  std::vector<bool> relevant;
+  partition(std::vector<SymConstraint>(), slices, relevant);
+
+  SolverResult result = SAT_Satisfiable;
+  for (unsigned i = 0; i < slices.size(); ++i) {
+    SolverResult r = checkSlice(slices[i], 0);
+    if (r == SAT_Unsatisfiable)
+      return r;
+    if (r != SAT_Satisfiable)
+      result = r;
+  }
+  return result;
+}
+
+SolverResult IndependentSolverAdapter::checkSatAssuming(
+  const std::vector<SymConstraint> &assumptions) {
+  epoch.begin();
+  ++numQueries;
+  numConstraints += constraints.size();
+  lastModel.clear();
+  lastFailed.clear();
+  pendingSlices.clear();
+  deferredResult = SAT_Satisfiable;
+
+  std::vector<std::vector<SymConstraint> > slices;
+  std::vector<bool> relevant;
+  partition(assumptions, slices, relevant);
+
+  std::vector<SymConstraint> slice;
+  for (unsigned i = 0; i < slices.size(); ++i) {
+    if (relevant[i]) {
+      slice.insert(slice.end(), slices[i].begin(), slices[i].end());
+    } else {
+      pendingSlices.push_back(std::vector<SymConstraint>());
+      pendingSlices.back().swap(slices[i]);
+    }
+  }
+  // Ground constraints are repeated in every slice.
+  std::sort(slice.begin(), slice.end(), SymConstraintLess());
+  slice.erase(std::unique(slice.begin(), slice.end()), slice.end());
+
+  SolverResult result = checkSlice(slice, &assumptions);
+  if (result != SAT_Satisfiable)
+    pendingSlices.clear();
+  return result;
+}
+
+void IndependentSolverAdapter::getFailedAssumptions(
+  std::vector<SymConstraint> &failed) {
+  failed = lastFailed;
+}
+
+void IndependentSolverAdapter::assertSymConstraint(const SymConstraint &sc) {
+  constraints.push_back(sc);
+}
+
+void IndependentSolverAdapter::getModel(SymModel &m) {
+  // The slices that a checkSatAssuming() did not depend on are only solved
+  // when their model is asked for. An UNSAT one wins over the others.
+  for (unsigned i = 0; i < pendingSlices.size(); ++i) {
+    SolverResult r = checkSlice(pendingSlices[i], 0, true);
+    if (r != SAT_Satisfiable && deferredResult != SAT_Unsatisfiable)
+      deferredResult = r;
+  }
+  pendingSlices.clear();
+  m = lastModel;
+}
+
+void IndependentSolverAdapter::printModel() {
+  SymModel m;
+  getModel(m);
+  m.print(std::cout);
+}
+
+void IndependentSolverAdapter::reset() {
+  constraints.clear();
+  scopeMarks.clear();
+  symbolCache.clear();
+  pendingSlices.clear();
+  deferredResult = SAT_Satisfiable;
+  lastModel.clear();
+  lastFailed.clear();
+  backend->reset();
+}
+
+void IndependentSolverAdapter::push() {
+  scopeMarks.push_back(constraints.size());
+}
+
+void IndependentSolverAdapter::pop(unsigned n) {
+  assert(n <= scopeMarks.size() && "Cannot pop more scopes than pushed.");
+  if (n == 0)
+    return;
+  constraints.erase(constraints.begin() + scopeMarks[scopeMarks.size() - n],
+                    constraints.end());
+  scopeMarks.resize(scopeMarks.size() - n);
+}
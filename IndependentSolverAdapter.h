@@ -0,0 +1,84 @@
+#ifndef SMTADAPTER_INDEPENDENT_SOLVER_ADAPTER_H	// -*- C++ -*-
+#define SMTADAPTER_INDEPENDENT_SOLVER_ADAPTER_H
+#include "SolverAdapterLayer.h"
+#include <map>
+#include <vector>
+
+namespace smt {
+
+// Partition the asserted constraints into independent slices, i.e. the
+// connected components of the "shares a Symbol" relation, and only send the
+// slices a query depends on to the backend. Each slice is checked in a
+// scope of its own on an otherwise empty backend, so a caching backend sees
+// and caches every slice separately.
+//
+// checkSat() decides every slice. checkSatAssuming() only sends the slices
+// the assumptions share symbols with: like the path condition of a symbolic
+// executor, the asserted constraints are assumed to be satisfiable on their
+// own. The other slices are only solved by getModel(), see
+// getDeferredResult().
+class IndependentSolverAdapter : public SolverAdapterLayer {
+public:
+  IndependentSolverAdapter(SolverAdapter *b);
+
+  virtual SolverResult checkSat();
+  virtual SolverResult
+  checkSatAssuming(const std::vector<SymConstraint> &assumptions);
+  virtual void getFailedAssumptions(std::vector<SymConstraint> &failed);
+  virtual void assertSymConstraint(const SymConstraint &sc);
+  virtual void printModel();
+  virtual void getModel(SymModel &m);
+  virtual void reset();
+  virtual void push();
+  virtual void pop(unsigned n = 1);
+
+  unsigned getNumQueries() const { return numQueries; }
+  unsigned getNumSlices() const { return numSlices; }
+  // The number of constraints asserted at query time, and the number of
+  // them actually sent to the backend.
+  unsigned long long getNumConstraints() const { return numConstraints; }
+  unsigned long long getNumSentConstraints() const {
+    return numSentConstraints;
+  }
+  // The result of the slices the last checkSatAssuming() did not depend on,
+  // once getModel() solved them: SAT_Satisfiable unless one of them is not,
+  // e.g. SAT_Unsatisfiable when the asserted constraints were not
+  // satisfiable on their own after all. The symbols of such slices are left
+  // out of the model.
+  SolverResult getDeferredResult() const { return deferredResult; }
+
+private:
+  typedef std::vector<unsigned> SymbolSet;
+
+  // The symbols of a constraint.
+  const SymbolSet &getSymbols(const SymExpr *root);
+  unsigned findRoot(std::map<unsigned, unsigned> &parent, unsigned id);
+  // Group the constraints by slice. Ground constraints are in every slice.
+  void partition(const std::vector<SymConstraint> &assumptions,
+                 std::vector<std::vector<SymConstraint> > &slices,
+                 std::vector<bool> &relevant);
+  void copySymbols(const SymModel &m, const SymbolSet &syms);
+  // A deferred slice is checked outside of a check of the layer, so it
+  // cannot be interrupted.
+  SolverResult checkSlice(const std::vector<SymConstraint> &slice,
+                          const std::vector<SymConstraint> *assumptions,
+                          bool deferred = false);
+
+private:
+  // Symbol IDs of each constraint and assumption, sorted.
+  std::map<const SymExpr *, SymbolSet> symbolCache;
+
+  std::vector<std::vector<SymConstraint> > pendingSlices;
+  SolverResult deferredResult;
+  SymModel lastModel;
+  std::vector<SymConstraint> lastFailed;
+
+  unsigned numQueries;
+  unsigned numSlices;
+  unsigned long long numConstraints;
+  unsigned long long numSentConstraints;
+};
+
+}
+
+#endif
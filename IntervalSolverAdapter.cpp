@@ -0,0 +1,269 @@
+#include "IntervalSolverAdapter.h"
+#include "BitVector.h"
+#include <algorithm>
+#include <iostream>
+
+using namespace smt;
+
+namespace {
+
+// Turn c op x into x op' c.
+LogicalOpcode swapOperands(LogicalOpcode op) {
+  switch (op) {
+  default: return op;
+  case BO_SLT: return BO_SGT;
+  case BO_ULT: return BO_UGT;
+  case BO_SGT: return BO_SLT;
+  case BO_UGT: return BO_ULT;
+  case BO_SLE: return BO_SGE;
+  case BO_ULE: return BO_UGE;
+  case BO_SGE: return BO_SLE;
+  case BO_UGE: return BO_ULE;
+  }
+}
+
+LogicalOpcode negate(LogicalOpcode op) {
+  switch (op) {
+  default: return op;
+  case BO_SLT: return BO_SGE;
+  case BO_ULT: return BO_UGE;
+  case BO_SGT: return BO_SLE;
+  case BO_UGT: return BO_ULE;
+  case BO_SLE: return BO_SGT;
+  case BO_ULE: return BO_UGT;
+  case BO_SGE: return BO_SLT;
+  case BO_UGE: return BO_ULT;
+  case BO_EQ: return BO_NE;
+  case BO_NE: return BO_EQ;
+  }
+}
+
+}
+
+IntervalSolverAdapter::IntervalSolverAdapter(SolverAdapter *b)
+  : SolverAdapterLayer(b), lastDecided(false), numQueries(0),
+    numDecided(0) {}
+
+bool IntervalSolverAdapter::addConstraint(const SymExpr *cond, bool b,
+                                          unsigned assumption) {
+  if (UnarySymExpr::classof(cond)) {
+    const UnarySymExpr *un = static_cast<const UnarySymExpr *>(cond);
+    if (un->getUnaryOpcode() != UO_LNot)
+      return false;
+    return addConstraint(un->getOperand(), !b, assumption);
+  }
+  if (!LogicalSymExpr::classof(cond))
+    return false;
+  const LogicalSymExpr *cmp = static_cast<const LogicalSymExpr *>(cond);
+  // a && b, or !(a || b): both sides must hold.
+  if ((cmp->getOpcode() == BO_LAnd && b) ||
+      (cmp->getOpcode() == BO_LOr && !b))
+    return addConstraint(cmp->getLHS(), b, assumption) &&
+      addConstraint(cmp->getRHS(), b, assumption);
+  if (cmp->getOpcode() == BO_LAnd || cmp->getOpcode() == BO_LOr)
+    return false;
+  return addComparison(cmp, b, assumption);
+}
+
+bool IntervalSolverAdapter::addComparison(const LogicalSymExpr *cmp, bool b,
+                                          unsigned assumption) {
+  const SymExpr *l = cmp->getLHS(), *r = cmp->getRHS();
+  LogicalOpcode op = cmp->getOpcode();
+  if (ConstExpr::classof(l) && ScalarSymbol::classof(r)) {
+    std::swap(l, r);
+    op = swapOperands(op);
+  }
+  if (!ScalarSymbol::classof(l) || !ConstExpr::classof(r))
+    return false;
+  if (!b)
+    op = negate(op);
+
+  const ScalarSymbol *sym = static_cast<const ScalarSymbol *>(l);
+  const ConstExpr *ce = static_cast<const ConstExpr *>(r);
+  unsigned w = sym->getBitWidth(ctx);
+  if (w == 0 || w > 64 || ce->getBitWidth(ctx) != w)
+    return false;
+
+  std::map<unsigned, Domain>::iterator it =
+    domains.find(sym->getSymbolID());
+  if (it == domains.end()) {
+    Domain d;
+    d.width = w;
+    d.ulo = 0;
+    d.uhi = bv::mask(w);
+    d.slo = bv::toSigned((uint64_t)1 << (w - 1), w);
+    d.shi = bv::toSigned(bv::mask(w) >> 1, w);
+    it = domains.insert(std::make_pair(sym->getSymbolID(), d)).first;
+  }
+  Domain &d = it->second;
+  if (d.width != w)
+    return false;
+  if (assumption != ~0U &&
+      (d.assumptions.empty() || d.assumptions.back() != assumption))
+    d.assumptions.push_back(assumption);
+
+  uint64_t c = bv::trunc(ce->getValue(), w);
+  int64_t sc = bv::toSigned(c, w);
+  // c - 1 and c + 1 must not wrap around at the ends of the range; an
+  // interval with nothing left is [1, 0].
+  switch (op) {
+  default:
+    return false;
+  case BO_ULT:
+    if (c == 0)
+      d.ulo = 1, d.uhi = 0;
+    else
+      d.uhi = std::min(d.uhi, c - 1);
+    break;
+  case BO_ULE:
+    d.uhi = std::min(d.uhi, c);
+    break;
+  case BO_UGT:
+    if (c == bv::mask(w))
+      d.ulo = 1, d.uhi = 0;
+    else
+      d.ulo = std::max(d.ulo, c + 1);
+    break;
+  case BO_UGE:
+    d.ulo = std::max(d.ulo, c);
+    break;
+  case BO_SLT:
+    if (sc == bv::toSigned((uint64_t)1 << (w - 1), w))
+      d.slo = 1, d.shi = 0;
+    else
+      d.shi = std::min(d.shi, sc - 1);
+    break;
+  case BO_SLE:
+    d.shi = std::min(d.shi, sc);
+    break;
+  case BO_SGT:
+    if (sc == bv::toSigned(bv::mask(w) >> 1, w))
+      d.slo = 1, d.shi = 0;
+    else
+      d.slo = std::max(d.slo, sc + 1);
+    break;
+  case BO_SGE:
+    d.slo = std::max(d.slo, sc);
+    break;
+  case BO_EQ:
+    d.ulo = std::max(d.ulo, c);
+    d.uhi = std::min(d.uhi, c);
+    break;
+  case BO_NE:
+    d.excluded.insert(c);
+    break;
+  }
+  return true;
+}
+
+bool IntervalSolverAdapter::findValue(const Domain &d, uint64_t &v) {
+  if (d.ulo > d.uhi || d.slo > d.shi)
+    return false;
+  // The signed interval as one or two unsigned ones.
+  uint64_t lo[2], hi[2];
+  unsigned n = 0;
+  uint64_t slo = bv::trunc((uint64_t)d.slo, d.width);
+  uint64_t shi = bv::trunc((uint64_t)d.shi, d.width);
+  if (d.slo < 0 && d.shi >= 0) {
+    lo[n] = 0, hi[n++] = shi;
+    lo[n] = slo, hi[n++] = bv::mask(d.width);
+  } else {
+    lo[n] = slo, hi[n++] = shi;
+  }
+  for (unsigned i = 0; i < n; ++i) {
+    uint64_t a = std::max(lo[i], d.ulo), b = std::min(hi[i], d.uhi);
+    if (a > b)
+      continue;
+    // Step over the excluded values from a on.
+    v = a;
+    std::set<uint64_t>::const_iterator it = d.excluded.lower_bound(a);
+    for (; it != d.excluded.end() && *it == v && v < b; ++it)
+      ++v;
+    if (it == d.excluded.end() || *it != v)
+      return true;
+  }
+  return false;
+}
+
+bool IntervalSolverAdapter::decide(
+  const std::vector<SymConstraint> &assumptions, SolverResult &result) {
+  domains.clear();
+  bool complete = true;
+  for (unsigned i = 0; i < constraints.size(); ++i)
+    if (!addConstraint(constraints[i].cond, constraints[i].assumption, ~0U))
+      complete = false;
+  for (unsigned i = 0; i < assumptions.size(); ++i)
+    if (!addConstraint(assumptions[i].cond, assumptions[i].assumption, i))
+      complete = false;
+
+  // The comparisons that were added before a constraint left the fragment
+  // only strengthen the domains, so an empty one is still UNSAT.
+  lastModel.clear();
+  lastFailed.clear();
+  for (std::map<unsigned, Domain>::iterator it = domains.begin(),
+         ie = domains.end(); it != ie; ++it) {
+    uint64_t v = 0;
+    if (!findValue(it->second, v)) {
+      const std::vector<unsigned> &used = it->second.assumptions;
+      for (unsigned i = 0; i < used.size(); ++i)
+        lastFailed.push_back(assumptions[used[i]]);
+      result = SAT_Unsatisfiable;
+      return true;
+    }
+    lastModel.setScalar(it->first, v);
+  }
+  if (!complete)
+    return false;
+  result = SAT_Satisfiable;
+  return true;
+}
+
+SolverResult IntervalSolverAdapter::checkSat() {
+  return checkSatAssuming(std::vector<SymConstraint>());
+}
+
+SolverResult IntervalSolverAdapter::checkSatAssuming(
+  const std::vector<SymConstraint> &assumptions) {
+  epoch.begin();
+  ++numQueries;
+  SolverResult result;
+  lastDecided = decide(assumptions, result);
+  if (lastDecided) {
+    ++numDecided;
+    return result;
+  }
+  return checkBackend(assumptions.empty() ? 0 : &assumptions);
+}
+
+void IntervalSolverAdapter::getFailedAssumptions(
+  std::vector<SymConstraint> &failed) {
+  if (!lastDecided) {
+    backend->getFailedAssumptions(failed);
+    return;
+  }
+  failed = lastFailed;
+}
+
+void IntervalSolverAdapter::printModel() {
+  if (!lastDecided) {
+    backend->printModel();
+    return;
+  }
+  lastModel.print(std::cout);
+}
+
+void IntervalSolverAdapter::getModel(SymModel &m) {
+  if (!lastDecided) {
+    backend->getModel(m);
+    return;
+  }
+  m = lastModel;
+}
+
+void IntervalSolverAdapter::reset() {
+  SolverAdapterLayer::reset();
+  domains.clear();
+  lastDecided = false;
+  lastModel.clear();
+  lastFailed.clear();
+}
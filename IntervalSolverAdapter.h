@@ -0,0 +1,73 @@
+#ifndef SMTADAPTER_INTERVAL_SOLVER_ADAPTER_H	// -*- C++ -*-
+#define SMTADAPTER_INTERVAL_SOLVER_ADAPTER_H
+#include "SolverAdapterLayer.h"
+#include "smtadapter/Symbol.h"
+#include <map>
+#include <set>
+#include <stdint.h>
+
+namespace smt {
+
+// Decide queries made of comparisons between a ScalarSymbol and a
+// ConstExpr, such as x <u 10 or x != 3, without the backend. Each symbol
+// gets an unsigned and a signed interval and a set of excluded values;
+// since every comparison constrains one symbol, the query is SAT exactly
+// when each symbol has a value left, which is the witness model. Logical
+// not, conjunctions and negated disjunctions of such comparisons are
+// split.
+//
+// A query with other constraints goes to the backend, unless the
+// comparisons among its constraints are already UNSAT on their own.
+class IntervalSolverAdapter : public SolverAdapterLayer {
+public:
+  IntervalSolverAdapter(SolverAdapter *b);
+
+  virtual SolverResult checkSat();
+  virtual SolverResult
+  checkSatAssuming(const std::vector<SymConstraint> &assumptions);
+  virtual void getFailedAssumptions(std::vector<SymConstraint> &failed);
+  virtual void printModel();
+  virtual void getModel(SymModel &m);
+  virtual void reset();
+
+  unsigned getNumQueries() const { return numQueries; }
+  // The number of queries decided without the backend.
+  unsigned getNumDecided() const { return numDecided; }
+
+private:
+  // The values left for one symbol.
+  struct Domain {
+    unsigned width;
+    uint64_t ulo, uhi;
+    int64_t slo, shi;
+    std::set<uint64_t> excluded;
+    // The assumptions that constrain the symbol, by index.
+    std::vector<unsigned> assumptions;
+  };
+
+  // Add the comparisons of cond, if it is expected to be b, to the
+  // domains. Return false if cond is not in the fragment.
+  bool addConstraint(const SymExpr *cond, bool b, unsigned assumption);
+  bool addComparison(const LogicalSymExpr *cmp, bool b, unsigned assumption);
+  // Find a value of the domain, false if it is empty.
+  static bool findValue(const Domain &d, uint64_t &v);
+  // Decide the current query with the assumptions, if possible.
+  bool decide(const std::vector<SymConstraint> &assumptions,
+              SolverResult &result);
+
+private:
+  std::map<unsigned, Domain> domains;
+
+  // Whether the last query was decided here, with its model or failed
+  // assumptions.
+  bool lastDecided;
+  SymModel lastModel;
+  std::vector<SymConstraint> lastFailed;
+
+  unsigned numQueries;
+  unsigned numDecided;
+};
+
+}
+
+#endif
@@ -0,0 +1,123 @@
+#include "ModelReuseSolverAdapter.h"
+#include "smtadapter/SymExprVisitor.h"
+#include <iostream>
+#include <set>
+
+using namespace smt;
+
+ModelReuseSolverAdapter::ModelReuseSolverAdapter(SolverAdapter *b,
+                                                 unsigned cap)
+  : SolverAdapterLayer(b), capacity(cap), lastFromStore(false), numHits(0),
+    numMisses(0) {
+  assert(capacity > 0 && "The store needs at least one model.");
+}
+
+ModelReuseSolverAdapter::~ModelReuseSolverAdapter() {
+  clearModels();
+}
+
+void ModelReuseSolverAdapter::clearModels() {
+  for (std::list<StoredModel *>::iterator it = models.begin(),
+         ie = models.end(); it != ie; ++it)
+    delete *it;
+  models.clear();
+}
+
+bool ModelReuseSolverAdapter::findModel(
+  const std::vector<SymConstraint> &assumptions) {
+  for (std::list<StoredModel *>::iterator it = models.begin(),
+         ie = models.end(); it != ie; ++it) {
+    SymExprEvaluator &evaluator = (*it)->evaluator;
+    bool fits = true;
+    for (unsigned i = 0; fits && i < assumptions.size(); ++i)
+      fits = evaluator.satisfies(assumptions[i]);
+    // The latest constraints are the most likely to fail.
+    for (unsigned i = constraints.size(); fits && i > 0; --i)
+      fits = evaluator.satisfies(constraints[i - 1]);
+    // The memo only serves one lookup, a model kept for long would pile up
+    // the values of every query otherwise.
+    evaluator.clear();
+    if (!fits)
+      continue;
+    lastModel = (*it)->model;
+    addDefaults(assumptions);
+    models.splice(models.begin(), models, it);
+    return true;
+  }
+  return false;
+}
+
+void ModelReuseSolverAdapter::addDefaults(
+  const std::vector<SymConstraint> &assumptions) {
+  std::vector<const SymExpr *> work;
+  for (unsigned i = 0; i < constraints.size(); ++i)
+    work.push_back(constraints[i].cond);
+  for (unsigned i = 0; i < assumptions.size(); ++i)
+    work.push_back(assumptions[i].cond);
+  std::set<const SymExpr *> visited;
+  while (!work.empty()) {
+    const SymExpr *e = work.back();
+    work.pop_back();
+    if (!visited.insert(e).second)
+      continue;
+    if (ScalarSymbol::classof(e)) {
+      unsigned id = static_cast<const Symbol *>(e)->getSymbolID();
+      uint64_t v;
+      if (!lastModel.getScalar(id, v))
+        lastModel.setScalar(id, 0);
+    } else if (RegionSymbol::classof(e)) {
+      unsigned id = static_cast<const Symbol *>(e)->getSymbolID();
+      if (!lastModel.getArray(id))
+        lastModel.getOrCreateArray(id).setValue(ArrayValue::Index(), 0);
+    }
+    const SymExpr *ops[2];
+    for (unsigned n = getSymExprOperands(e, ops); n > 0; --n)
+      work.push_back(ops[n - 1]);
+  }
+}
+
+void ModelReuseSolverAdapter::addModel() {
+  backend->getModel(lastModel);
+  if (models.size() == capacity) {
+    delete models.back();
+    models.pop_back();
+  }
+  models.push_front(new StoredModel(ctx, lastModel));
+}
+
+SolverResult ModelReuseSolverAdapter::checkSat() {
+  return checkSatAssuming(std::vector<SymConstraint>());
+}
+
+SolverResult ModelReuseSolverAdapter::checkSatAssuming(
+  const std::vector<SymConstraint> &assumptions) {
+  epoch.begin();
+  lastFromStore = findModel(assumptions);
+  if (lastFromStore) {
+    ++numHits;
+    return SAT_Satisfiable;
+  }
+
+  ++numMisses;
+  SolverResult result =
+    checkBackend(assumptions.empty() ? 0 : &assumptions);
+  if (result == SAT_Satisfiable)
+    addModel();
+  return result;
+}
+
+void ModelReuseSolverAdapter::printModel() {
+  if (lastFromStore)
+    lastModel.print(std::cout);
+  else
+    backend->printModel();
+}
+
+void ModelReuseSolverAdapter::getModel(SymModel &m) {
+  m = lastModel;
+}
+
+void ModelReuseSolverAdapter::reset() {
+  SolverAdapterLayer::reset();
+  lastFromStore = false;
+}
@@ -0,0 +1,65 @@
+#ifndef SMTADAPTER_MODEL_REUSE_SOLVER_ADAPTER_H	// -*- C++ -*-
+#define SMTADAPTER_MODEL_REUSE_SOLVER_ADAPTER_H
+#include "SolverAdapterLayer.h"
+#include "SymExprEvaluator.h"
+#include <list>
+
+namespace smt {
+
+// Keep the models of the most recent satisfiable queries, and before going
+// to the backend evaluate the constraints of a query under each of them. A
+// model that satisfies them answers the query with SAT. Queries along one
+// path usually extend the previous ones, so its latest model often fits.
+//
+// Models are keyed by Symbol ID and stay valid across reset(). The model
+// of a query answered from the store also assigns 0 to the symbols of the
+// query that the stored model does not mention, as the evaluation did.
+class ModelReuseSolverAdapter : public SolverAdapterLayer {
+public:
+  ModelReuseSolverAdapter(SolverAdapter *b, unsigned capacity = 16);
+  virtual ~ModelReuseSolverAdapter();
+
+  virtual SolverResult checkSat();
+  virtual SolverResult
+  checkSatAssuming(const std::vector<SymConstraint> &assumptions);
+  virtual void printModel();
+  virtual void getModel(SymModel &m);
+  virtual void reset();
+
+  void clearModels();
+
+  unsigned getNumHits() const { return numHits; }
+  unsigned getNumMisses() const { return numMisses; }
+
+private:
+  struct StoredModel {
+    SymModel model;
+    SymExprEvaluator evaluator;
+
+    StoredModel(SolverContext &c, const SymModel &m)
+      : model(m), evaluator(c, model) {}
+  };
+
+  // Find a stored model that satisfies the asserted constraints and the
+  // assumptions, and move it to the front.
+  bool findModel(const std::vector<SymConstraint> &assumptions);
+  // Add the symbols of the query missing from lastModel, as 0.
+  void addDefaults(const std::vector<SymConstraint> &assumptions);
+  void addModel();
+
+private:
+  // Most recently used first.
+  std::list<StoredModel *> models;
+  unsigned capacity;
+  // The model of the last satisfiable query, and whether it came from the
+  // store rather than the backend.
+  SymModel lastModel;
+  bool lastFromStore;
+
+  unsigned numHits;
+  unsigned numMisses;
+};
+
+}
+
+#endif
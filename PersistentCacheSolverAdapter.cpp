@@ -0,0 +1,288 @@
+#include "PersistentCacheSolverAdapter.h"
+#include "SymExprEvaluator.h"
+#include "smtadapter/Symbol.h"
+#include "smtadapter/SymExprVisitor.h"
+#include <algorithm>
+#include <iostream>
+#include <set>
+
+using namespace smt;
+
+namespace {
+
+// Two differently seeded lanes of a boost style combine, each finished with
+// the splitmix64 finalizer.
+uint64_t mixLane(uint64_t h, uint64_t v, uint64_t k) {
+  h ^= v + k + (h << 6) + (h >> 2);
+  h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+  return h ^ (h >> 31);
+}
+
+template <typename H>
+void mix(H &hash, uint64_t v) {
+  hash.h[0] = mixLane(hash.h[0], v, 0x9e3779b97f4a7c15ULL);
+  hash.h[1] = mixLane(hash.h[1], v, 0xc2b2ae3d27d4eb4fULL);
+}
+
+template <typename H, typename C>
+void mixHash(H &hash, const C &child) {
+  mix(hash, child.h[0]);
+  mix(hash, child.h[1]);
+}
+
+}
+
+PersistentCacheSolverAdapter::PersistentCacheSolverAdapter(
+  SolverAdapter *b, const std::string &path, uint64_t maxSize)
+  : SolverAdapterLayer(b), store(path, maxSize), lastFromCache(false),
+    numHits(0), numMisses(0), numRejected(0) {}
+
+const PersistentCacheSolverAdapter::Hash &
+PersistentCacheSolverAdapter::getHash(const SymExpr *e, bool shape) {
+  std::map<const SymExpr *, Hash> &cache = shape ? shapeCache : queryCache;
+  std::map<const SymExpr *, Hash>::iterator it = cache.find(e);
+  if (it != cache.end())
+    return it->second;
+  // Post-order walk with an explicit stack like Z3Adapter::genZ3Expr(), so
+  // that deep chains cannot overflow the native stack. Operands are pushed
+  // in reverse and hashed left to right.
+  work.clear();
+  work.push_back(std::make_pair(e, false));
+  while (!work.empty()) {
+    const SymExpr *n = work.back().first;
+    if (!work.back().second) {
+      if (cache.count(n)) {
+        work.pop_back();
+        continue;
+      }
+      work.back().second = true;
+      const SymExpr *ops[2];
+      for (unsigned i = getSymExprOperands(n, ops); i > 0; --i)
+        work.push_back(std::make_pair(ops[i - 1], false));
+      continue;
+    }
+    work.pop_back();
+    Hash h = hashNode(n, shape);
+    cache.insert(std::pair<const SymExpr *, Hash>(n, h));
+  }
+  return cache.find(e)->second;
+}
+
+// With shape set, symbols only contribute their type, otherwise their
+// number in the query as well. The operands are already hashed, left to
+// right, which fixes the numbering.
+PersistentCacheSolverAdapter::Hash
+PersistentCacheSolverAdapter::hashNode(const SymExpr *e, bool shape) {
+  Hash h = {{ 1, 2 }};
+  mix(h, e->getKind());
+  const SymExpr *ops[2] = { 0, 0 };
+  switch (e->getKind()) {
+  default:
+    assert(0 && "Unprocessed SymExpr kind.");
+  case SymExpr::S_ScalarSymbol:
+  case SymExpr::S_RegionSymbol: {
+    const Symbol *sym = static_cast<const Symbol *>(e);
+    if (ScalarSymbol::classof(e)) {
+      mix(h, e->getBitWidth(ctx));
+    } else {
+      const RegionSymbol *region = static_cast<const RegionSymbol *>(e);
+      mix(h, region->getElementTypeSizeInBits(ctx));
+      mix(h, region->getNumberDimension(ctx));
+    }
+    if (shape)
+      break;
+    std::map<unsigned, unsigned>::iterator it =
+      canonIDs.find(sym->getSymbolID());
+    if (it == canonIDs.end()) {
+      it = canonIDs.insert(std::pair<unsigned, unsigned>(
+        sym->getSymbolID(), canonSymbols.size())).first;
+      canonSymbols.push_back(sym->getSymbolID());
+    }
+    mix(h, it->second);
+    break;
+  }
+  case SymExpr::S_ConstExpr: {
+    unsigned width = e->getBitWidth(ctx);
+    uint64_t v = static_cast<const ConstExpr *>(e)->getValue();
+    mix(h, width);
+    mix(h, width < 64 ? v & (((uint64_t)1 << width) - 1) : v);
+    break;
+  }
+  case SymExpr::S_ElemSymExpr: {
+    const ElemSymExpr *elem = static_cast<const ElemSymExpr *>(e);
+    ops[0] = elem->getBaseExpr();
+    ops[1] = elem->getIndexExpr();
+    break;
+  }
+  case SymExpr::S_ArithSymExpr:
+    mix(h, static_cast<const ArithSymExpr *>(e)->getOpcode());
+    ops[0] = static_cast<const BinSymExpr *>(e)->getLHS();
+    ops[1] = static_cast<const BinSymExpr *>(e)->getRHS();
+    break;
+  case SymExpr::S_LogicalSymExpr:
+    mix(h, static_cast<const LogicalSymExpr *>(e)->getOpcode());
+    ops[0] = static_cast<const BinSymExpr *>(e)->getLHS();
+    ops[1] = static_cast<const BinSymExpr *>(e)->getRHS();
+    break;
+  case SymExpr::S_UnarySymExpr:
+    mix(h, static_cast<const UnarySymExpr *>(e)->getUnaryOpcode());
+    ops[0] = static_cast<const UnarySymExpr *>(e)->getOperand();
+    break;
+  case SymExpr::S_TruncSymExpr:
+    mix(h, e->getBitWidth(ctx));
+    ops[0] = static_cast<const CastSymExpr *>(e)->getOperand();
+    break;
+  case SymExpr::S_ExtendSymExpr:
+    mix(h, e->getBitWidth(ctx));
+    mix(h, static_cast<const ExtendSymExpr *>(e)->isSignedExt());
+    ops[0] = static_cast<const CastSymExpr *>(e)->getOperand();
+    break;
+  }
+  const std::map<const SymExpr *, Hash> &cache =
+    shape ? shapeCache : queryCache;
+  for (unsigned i = 0; i < 2 && ops[i]; ++i)
+    mixHash(h, cache.find(ops[i])->second);
+  return h;
+}
+
+namespace {
+
+struct ShapeLess {
+  bool operator()(const std::pair<uint64_t, SymConstraint> &a,
+                  const std::pair<uint64_t, SymConstraint> &b) const {
+    if (a.first != b.first)
+      return a.first < b.first;
+    return a.second.assumption < b.second.assumption;
+  }
+};
+
+}
+
+QueryKey PersistentCacheSolverAdapter::getQueryKey(
+  const std::vector<SymConstraint> &assumptions) {
+  std::set<SymConstraint, SymConstraintLess> seen;
+  std::vector<std::pair<uint64_t, SymConstraint> > sorted;
+  for (unsigned i = 0; i < constraints.size() + assumptions.size(); ++i) {
+    const SymConstraint &sc = i < constraints.size() ? constraints[i]
+      : assumptions[i - constraints.size()];
+    if (seen.insert(sc).second)
+      sorted.push_back(std::make_pair(getShapeHash(sc.cond).h[0], sc));
+  }
+  // Constraints of the same shape keep their order.
+  std::stable_sort(sorted.begin(), sorted.end(), ShapeLess());
+
+  queryCache.clear();
+  canonIDs.clear();
+  canonSymbols.clear();
+  QueryKey key = {{ sorted.size(), 3 }};
+  for (unsigned i = 0; i < sorted.size(); ++i) {
+    mixHash(key, getQueryHash(sorted[i].second.cond));
+    mix(key, sorted[i].second.assumption);
+  }
+  return key;
+}
+
+bool PersistentCacheSolverAdapter::checkModel(
+  const std::vector<SymConstraint> &assumptions) {
+  SymExprEvaluator evaluator(ctx, lastModel);
+  for (unsigned i = 0; i < assumptions.size(); ++i)
+    if (!evaluator.satisfies(assumptions[i]))
+      return false;
+  for (unsigned i = 0; i < constraints.size(); ++i)
+    if (!evaluator.satisfies(constraints[i]))
+      return false;
+  return true;
+}
+
+SolverResult PersistentCacheSolverAdapter::checkSat() {
+  return checkSatAssuming(std::vector<SymConstraint>());
+}
+
+SolverResult PersistentCacheSolverAdapter::checkSatAssuming(
+  const std::vector<SymConstraint> &assumptions) {
+  epoch.begin();
+  QueryKey key = getQueryKey(assumptions);
+  SolverResult result;
+  SymModel canonModel;
+  lastFailed.clear();
+  if (store.lookup(key, result, canonModel)) {
+    if (result == SAT_Unsatisfiable) {
+      ++numHits;
+      lastFromCache = true;
+      // Which assumptions failed is not stored.
+      lastFailed = assumptions;
+      return result;
+    }
+    // Number the model after the symbols of this query.
+    lastModel.clear();
+    const SymModel::ScalarMap &scalars = canonModel.getScalars();
+    for (SymModel::ScalarMap::const_iterator it = scalars.begin(),
+           ie = scalars.end(); it != ie; ++it)
+      if (it->first < canonSymbols.size())
+        lastModel.setScalar(canonSymbols[it->first], it->second);
+    const SymModel::ArrayMap &arrays = canonModel.getArrays();
+    for (SymModel::ArrayMap::const_iterator it = arrays.begin(),
+           ie = arrays.end(); it != ie; ++it)
+      if (it->first < canonSymbols.size())
+        lastModel.getOrCreateArray(canonSymbols[it->first]) = it->second;
+    if (checkModel(assumptions)) {
+      ++numHits;
+      lastFromCache = true;
+      return SAT_Satisfiable;
+    }
+    ++numRejected;
+  }
+
+  ++numMisses;
+  lastFromCache = false;
+  result = checkBackend(assumptions.empty() ? 0 : &assumptions);
+  canonModel.clear();
+  if (result == SAT_Satisfiable) {
+    backend->getModel(lastModel);
+    const SymModel::ScalarMap &scalars = lastModel.getScalars();
+    for (SymModel::ScalarMap::const_iterator it = scalars.begin(),
+           ie = scalars.end(); it != ie; ++it) {
+      std::map<unsigned, unsigned>::iterator ci = canonIDs.find(it->first);
+      if (ci != canonIDs.end())
+        canonModel.setScalar(ci->second, it->second);
+    }
+    const SymModel::ArrayMap &arrays = lastModel.getArrays();
+    for (SymModel::ArrayMap::const_iterator it = arrays.begin(),
+           ie = arrays.end(); it != ie; ++it) {
+      std::map<unsigned, unsigned>::iterator ci = canonIDs.find(it->first);
+      if (ci != canonIDs.end())
+        canonModel.getOrCreateArray(ci->second) = it->second;
+    }
+    store.insert(key, result, canonModel);
+  } else if (result == SAT_Unsatisfiable) {
+    if (!assumptions.empty())
+      backend->getFailedAssumptions(lastFailed);
+    store.insert(key, result, canonModel);
+  }
+  return result;
+}
+
+void PersistentCacheSolverAdapter::getFailedAssumptions(
+  std::vector<SymConstraint> &failed) {
+  failed = lastFailed;
+}
+
+void PersistentCacheSolverAdapter::printModel() {
+  if (lastFromCache)
+    lastModel.print(std::cout);
+  else
+    backend->printModel();
+}
+
+void PersistentCacheSolverAdapter::getModel(SymModel &m) {
+  m = lastModel;
+}
+
+void PersistentCacheSolverAdapter::reset() {
+  SolverAdapterLayer::reset();
+  shapeCache.clear();
+  queryCache.clear();
+  lastFromCache = false;
+  lastFailed.clear();
+}
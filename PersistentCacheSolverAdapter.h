@@ -0,0 +1,78 @@
+#ifndef SMTADAPTER_PERSISTENT_CACHE_SOLVER_ADAPTER_H	// -*- C++ -*-
+#define SMTADAPTER_PERSISTENT_CACHE_SOLVER_ADAPTER_H
+#include "PersistentQueryStore.h"
+#include "SolverAdapterLayer.h"
+#include <map>
+#include <string>
+#include <vector>
+
+namespace smt {
+
+// Cache query results in a PersistentQueryStore, so that they survive the
+// process and are shared by the processes of one machine.
+//
+// A query is keyed by a structural hash of its constraint set that does
+// not depend on Symbol IDs: symbols are numbered in the order they are
+// first met, after sorting the constraints by a hash of their shape.
+// Models are stored under these numbers and mapped back to the symbols of
+// the query at hand. A cached model is checked against the query before it
+// is trusted; UNSAT results rely on the 128 bit key.
+class PersistentCacheSolverAdapter : public SolverAdapterLayer {
+public:
+  PersistentCacheSolverAdapter(SolverAdapter *b, const std::string &path,
+                               uint64_t maxSize = 256 << 20);
+
+  virtual SolverResult checkSat();
+  virtual SolverResult
+  checkSatAssuming(const std::vector<SymConstraint> &assumptions);
+  virtual void getFailedAssumptions(std::vector<SymConstraint> &failed);
+  virtual void printModel();
+  virtual void getModel(SymModel &m);
+  virtual void reset();
+
+  bool isOpen() const { return store.isOpen(); }
+  // Get the key of the asserted constraints and the assumptions.
+  QueryKey getQueryKey(const std::vector<SymConstraint> &assumptions);
+
+  unsigned getNumHits() const { return numHits; }
+  unsigned getNumMisses() const { return numMisses; }
+  // Cached models that did not satisfy the query.
+  unsigned getNumRejected() const { return numRejected; }
+
+private:
+  struct Hash {
+    uint64_t h[2];
+  };
+
+  const Hash &getShapeHash(const SymExpr *e) { return getHash(e, true); }
+  const Hash &getQueryHash(const SymExpr *e) { return getHash(e, false); }
+  const Hash &getHash(const SymExpr *e, bool shape);
+  // Hash one node whose operands are in the cache of shape.
+  Hash hashNode(const SymExpr *e, bool shape);
+  bool checkModel(const std::vector<SymConstraint> &assumptions);
+
+private:
+  PersistentQueryStore store;
+  // Shape hashes of nodes, by address, until reset().
+  std::map<const SymExpr *, Hash> shapeCache;
+
+  // Of the current query: the hashes of its nodes, the number of each
+  // symbol and the symbol of each number.
+  std::map<const SymExpr *, Hash> queryCache;
+  std::map<unsigned, unsigned> canonIDs;
+  std::vector<unsigned> canonSymbols;
+  // The stack of getHash(), kept to reuse its storage.
+  std::vector<std::pair<const SymExpr *, bool> > work;
+
+  SymModel lastModel;
+  bool lastFromCache;
+  std::vector<SymConstraint> lastFailed;
+
+  unsigned numHits;
+  unsigned numMisses;
+  unsigned numRejected;
+};
+
+}
+
+#endif
@@ -0,0 +1,319 @@
+#include "PersistentQueryStore.h"
+#include <assert.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace smt;
+
+namespace {
+
+const char Magic[8] = { 'S', 'M', 'T', 'Q', 'C', '0', '0', '1' };
+
+struct ScalarEntry {
+  uint32_t sym;
+  uint32_t pad;
+  uint64_t value;
+};
+
+// Followed by indexLen uint64_t indices.
+struct ElemEntry {
+  uint32_t sym;
+  uint32_t indexLen;
+  uint64_t value;
+};
+
+bool writeAll(int fd, const void *buf, size_t size, off_t offset) {
+  const char *p = static_cast<const char *>(buf);
+  while (size > 0) {
+    ssize_t n = pwrite(fd, p, size, offset);
+    if (n <= 0)
+      return false;
+    p += n;
+    size -= n;
+    offset += n;
+  }
+  return true;
+}
+
+}
+
+PersistentQueryStore::PersistentQueryStore(const std::string &p,
+                                           uint64_t max)
+  : path(p), maxSize(max), fd(-1), lockFd(-1), inode(0), data(0),
+    mappedSize(0), scannedEnd(0), numRecords(0), numCompactions(0) {
+  lockFd = ::open((path + ".lock").c_str(), O_RDWR | O_CREAT, 0644);
+  if (lockFd < 0)
+    return;
+  flock(lockFd, LOCK_EX);
+  open();
+  flock(lockFd, LOCK_UN);
+}
+
+PersistentQueryStore::~PersistentQueryStore() {
+  close();
+  if (lockFd >= 0)
+    ::close(lockFd);
+}
+
+bool PersistentQueryStore::open() {
+  fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close();
+    return false;
+  }
+  if (st.st_size < HeaderSize) {
+    char header[HeaderSize];
+    memset(header, 0, sizeof(header));
+    FileHeader *h = reinterpret_cast<FileHeader *>(header);
+    memcpy(h->magic, Magic, sizeof(Magic));
+    h->dataEnd = HeaderSize;
+    if (!writeAll(fd, header, sizeof(header), 0)) {
+      close();
+      return false;
+    }
+  }
+  inode = st.st_ino;
+  if (!map()) {
+    close();
+    return false;
+  }
+  if (memcmp(data, Magic, sizeof(Magic)) != 0) {
+    // Not ours, leave it alone.
+    close();
+    return false;
+  }
+  scannedEnd = HeaderSize;
+  index.clear();
+  numRecords = 0;
+  scan();
+  return true;
+}
+
+void PersistentQueryStore::close() {
+  if (data)
+    munmap(const_cast<char *>(data), mappedSize);
+  data = 0;
+  mappedSize = 0;
+  if (fd >= 0)
+    ::close(fd);
+  fd = -1;
+  index.clear();
+  numRecords = 0;
+}
+
+bool PersistentQueryStore::map() {
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < HeaderSize)
+    return false;
+  if (data)
+    munmap(const_cast<char *>(data), mappedSize);
+  void *p = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  if (p == MAP_FAILED) {
+    data = 0;
+    mappedSize = 0;
+    return false;
+  }
+  data = static_cast<const char *>(p);
+  mappedSize = st.st_size;
+  return true;
+}
+
+void PersistentQueryStore::scan() {
+  if (!data)
+    return;
+  const FileHeader *h = reinterpret_cast<const FileHeader *>(data);
+  uint64_t end = *static_cast<const volatile uint64_t *>(&h->dataEnd);
+  if (end > mappedSize && !map())
+    return;
+  if (end > mappedSize)
+    end = mappedSize;
+  while (scannedEnd + sizeof(RecordHeader) <= end) {
+    const RecordHeader *rec =
+      reinterpret_cast<const RecordHeader *>(data + scannedEnd);
+    // A torn or foreign file, don't read past it.
+    if (rec->size < sizeof(RecordHeader) || rec->size % 8 != 0 ||
+        scannedEnd + rec->size > end)
+      break;
+    index.insert(std::pair<uint64_t, uint64_t>(rec->key.h[0], scannedEnd));
+    ++numRecords;
+    scannedEnd += rec->size;
+  }
+}
+
+void PersistentQueryStore::refresh() {
+  struct stat st;
+  if (stat(path.c_str(), &st) == 0 && st.st_ino != inode) {
+    close();
+    open();
+    return;
+  }
+  scan();
+}
+
+const PersistentQueryStore::RecordHeader *
+PersistentQueryStore::find(const QueryKey &key) const {
+  typedef std::multimap<uint64_t, uint64_t>::const_iterator It;
+  std::pair<It, It> range = index.equal_range(key.h[0]);
+  for (It it = range.first; it != range.second; ++it) {
+    const RecordHeader *rec =
+      reinterpret_cast<const RecordHeader *>(data + it->second);
+    if (rec->key == key)
+      return rec;
+  }
+  return 0;
+}
+
+bool PersistentQueryStore::lookup(const QueryKey &key, SolverResult &result,
+                                  SymModel &model) {
+  if (!isOpen())
+    return false;
+  const RecordHeader *rec = find(key);
+  if (!rec) {
+    refresh();
+    if (!isOpen() || !(rec = find(key)))
+      return false;
+  }
+  result = static_cast<SolverResult>(rec->result);
+  readModel(rec, model);
+  return true;
+}
+
+void PersistentQueryStore::readModel(const RecordHeader *rec,
+                                     SymModel &model) const {
+  model.clear();
+  const char *p = reinterpret_cast<const char *>(rec) + sizeof(RecordHeader);
+  const char *end = reinterpret_cast<const char *>(rec) + rec->size;
+  for (unsigned i = 0; i < rec->numScalars && p + sizeof(ScalarEntry) <= end;
+       ++i) {
+    const ScalarEntry *s = reinterpret_cast<const ScalarEntry *>(p);
+    model.setScalar(s->sym, s->value);
+    p += sizeof(ScalarEntry);
+  }
+  for (unsigned i = 0; i < rec->numElems && p + sizeof(ElemEntry) <= end;
+       ++i) {
+    const ElemEntry *e = reinterpret_cast<const ElemEntry *>(p);
+    p += sizeof(ElemEntry);
+    if (p + e->indexLen * sizeof(uint64_t) > end)
+      break;
+    const uint64_t *indices = reinterpret_cast<const uint64_t *>(p);
+    ArrayValue::Index index(indices, indices + e->indexLen);
+    model.getOrCreateArray(e->sym).setValue(index, e->value);
+    p += e->indexLen * sizeof(uint64_t);
+  }
+}
+
+void PersistentQueryStore::writeRecord(std::vector<char> &buf,
+                                       const QueryKey &key,
+                                       SolverResult result,
+                                       const SymModel &model) const {
+  const SymModel::ScalarMap &scalars = model.getScalars();
+  const SymModel::ArrayMap &arrays = model.getArrays();
+  size_t size = sizeof(RecordHeader) + scalars.size() * sizeof(ScalarEntry);
+  unsigned numElems = 0;
+  for (SymModel::ArrayMap::const_iterator it = arrays.begin(),
+         ie = arrays.end(); it != ie; ++it) {
+    const ArrayValue::ElemMap &elems = it->second.getElems();
+    for (ArrayValue::ElemMap::const_iterator ei = elems.begin(),
+           ee = elems.end(); ei != ee; ++ei) {
+      size += sizeof(ElemEntry) + ei->first.size() * sizeof(uint64_t);
+      ++numElems;
+    }
+  }
+  size = (size + 7) & ~(size_t)7;
+  buf.assign(size, 0);
+
+  RecordHeader *rec = reinterpret_cast<RecordHeader *>(&buf[0]);
+  rec->size = size;
+  rec->result = result;
+  rec->key = key;
+  rec->numScalars = scalars.size();
+  rec->numElems = numElems;
+  char *p = &buf[0] + sizeof(RecordHeader);
+  for (SymModel::ScalarMap::const_iterator it = scalars.begin(),
+         ie = scalars.end(); it != ie; ++it) {
+    ScalarEntry *s = reinterpret_cast<ScalarEntry *>(p);
+    s->sym = it->first;
+    s->value = it->second;
+    p += sizeof(ScalarEntry);
+  }
+  for (SymModel::ArrayMap::const_iterator it = arrays.begin(),
+         ie = arrays.end(); it != ie; ++it) {
+    const ArrayValue::ElemMap &elems = it->second.getElems();
+    for (ArrayValue::ElemMap::const_iterator ei = elems.begin(),
+           ee = elems.end(); ei != ee; ++ei) {
+      ElemEntry *e = reinterpret_cast<ElemEntry *>(p);
+      e->sym = it->first;
+      e->indexLen = ei->first.size();
+      e->value = ei->second;
+      p += sizeof(ElemEntry);
+      for (unsigned i = 0; i < ei->first.size(); ++i, p += sizeof(uint64_t))
+        memcpy(p, &ei->first[i], sizeof(uint64_t));
+    }
+  }
+}
+
+void PersistentQueryStore::insert(const QueryKey &key, SolverResult result,
+                                  const SymModel &model) {
+  if (lockFd < 0)
+    return;
+  std::vector<char> buf;
+  writeRecord(buf, key, result, model);
+  // Records larger than half the cap would evict everything else.
+  if (buf.size() > maxSize / 2)
+    return;
+
+  flock(lockFd, LOCK_EX);
+  refresh();
+  if (isOpen() && !find(key)) {
+    if (scannedEnd + buf.size() > maxSize)
+      compact();
+    uint64_t end = scannedEnd;
+    if (isOpen() && writeAll(fd, &buf[0], buf.size(), end)) {
+      end += buf.size();
+      // Publish the record.
+      writeAll(fd, &end, sizeof(end), offsetof(FileHeader, dataEnd));
+      scan();
+    }
+  }
+  flock(lockFd, LOCK_UN);
+}
+
+void PersistentQueryStore::compact() {
+  // Find the oldest record to keep.
+  std::vector<uint64_t> offsets;
+  for (uint64_t off = HeaderSize; off < scannedEnd;
+       off += reinterpret_cast<const RecordHeader *>(data + off)->size)
+    offsets.push_back(off);
+  unsigned first = 0;
+  while (first < offsets.size() && scannedEnd - offsets[first] > maxSize / 2)
+    ++first;
+  uint64_t begin = first < offsets.size() ? offsets[first] : scannedEnd;
+
+  std::string tmp = path + ".tmp";
+  int tfd = ::open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (tfd < 0)
+    return;
+  char header[HeaderSize];
+  memcpy(header, data, HeaderSize);
+  FileHeader *h = reinterpret_cast<FileHeader *>(header);
+  h->dataEnd = HeaderSize + (scannedEnd - begin);
+  bool ok = writeAll(tfd, header, HeaderSize, 0) &&
+    writeAll(tfd, data + begin, scannedEnd - begin, HeaderSize) &&
+    fsync(tfd) == 0;
+  ::close(tfd);
+  if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+    unlink(tmp.c_str());
+    return;
+  }
+  ++numCompactions;
+  close();
+  open();
+}
@@ -0,0 +1,100 @@
+#ifndef SMTADAPTER_PERSISTENT_QUERY_STORE_H	// -*- C++ -*-
+#define SMTADAPTER_PERSISTENT_QUERY_STORE_H
+#include "smtadapter/SolverAdapter.h"
+#include "smtadapter/SymModel.h"
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <sys/types.h>
+
+namespace smt {
+
+// A 128 bit key of a query.
+struct QueryKey {
+  uint64_t h[2];
+
+  bool operator==(const QueryKey &rhs) const {
+    return h[0] == rhs.h[0] && h[1] == rhs.h[1];
+  }
+};
+
+// Query results in a file shared by the processes of one machine. The file
+// is memory-mapped and only ever appended to:
+//
+//   FileHeader, padded to HeaderSize
+//   record*    each a RecordHeader, the scalars and the array elements of
+//              the model, padded to 8 bytes
+//
+// Writers serialize on an flock() of "<path>.lock", append a record and
+// then publish it by advancing FileHeader::dataEnd, so that readers, which
+// take no lock, only see complete records. When the file would grow past
+// the size cap, the writer copies the newest records into a new file and
+// renames it over the old one; the other processes notice the new inode
+// and map it on their next lookup.
+class PersistentQueryStore {
+public:
+  PersistentQueryStore(const std::string &path, uint64_t maxSize);
+  ~PersistentQueryStore();
+
+  // False if the file could not be opened; the store is empty then.
+  bool isOpen() const { return data != 0; }
+
+  bool lookup(const QueryKey &key, SolverResult &result, SymModel &model);
+  void insert(const QueryKey &key, SolverResult result,
+              const SymModel &model);
+
+  unsigned getNumRecords() const { return numRecords; }
+  unsigned getNumCompactions() const { return numCompactions; }
+
+private:
+  struct FileHeader {
+    char magic[8];
+    // The end of the published records.
+    uint64_t dataEnd;
+  };
+
+  struct RecordHeader {
+    // Of the whole record, padded.
+    uint32_t size;
+    uint32_t result;
+    QueryKey key;
+    uint32_t numScalars;
+    uint32_t numElems;
+  };
+
+  enum { HeaderSize = 64 };
+
+  bool open();
+  void close();
+  bool map();
+  // Pick up the records other processes appended, and the file they
+  // replaced this one with.
+  void refresh();
+  void scan();
+  const RecordHeader *find(const QueryKey &key) const;
+  void readModel(const RecordHeader *rec, SymModel &model) const;
+  void writeRecord(std::vector<char> &buf, const QueryKey &key,
+                   SolverResult result, const SymModel &model) const;
+  // Keep the newest records that fill up to half of the cap.
+  void compact();
+
+private:
+  std::string path;
+  uint64_t maxSize;
+  int fd;
+  int lockFd;
+  ino_t inode;
+  const char *data;
+  uint64_t mappedSize;
+  // Records up to here are in the index.
+  uint64_t scannedEnd;
+  // The first word of the key to the record offset.
+  std::multimap<uint64_t, uint64_t> index;
+  unsigned numRecords;
+  unsigned numCompactions;
+};
+
+}
+
+#endif
@@ -0,0 +1,190 @@
+#include "PortfolioSolverAdapter.h"
+#include "Timer.h"
+#include "smtadapter/SolverStats.h"
+#include <algorithm>
+#include <assert.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+using namespace smt;
+
+namespace {
+
+// How often the interrupts of a race are sent again.
+const std::chrono::milliseconds RetryInterval(10);
+
+// The state shared by the workers of one race.
+struct Race {
+  std::mutex lock;
+  std::condition_variable finished;
+  std::vector<bool> running;
+  std::vector<SolverResult> results;
+  unsigned numRunning;
+  int winner;
+
+  Race(unsigned n)
+    : running(n, true), results(n, SAT_Undetermined), numRunning(n),
+      winner(-1) {}
+};
+
+void runWorker(Race *race, SolverAdapter *worker, unsigned i,
+               const std::vector<SymConstraint> *assumptions) {
+  SolverResult r = SAT_Undetermined;
+  try {
+    r = assumptions ? worker->checkSatAssuming(*assumptions)
+                    : worker->checkSat();
+  } catch (...) {
+    // E.g. a z3::exception from a solver that does not support the query,
+    // which must not escape the thread. Some other worker may answer.
+  }
+  std::lock_guard<std::mutex> guard(race->lock);
+  race->results[i] = r;
+  race->running[i] = false;
+  --race->numRunning;
+  if (race->winner < 0 && (r == SAT_Satisfiable || r == SAT_Unsatisfiable))
+    race->winner = i;
+  race->finished.notify_one();
+}
+
+}
+
+PortfolioSolverAdapter::PortfolioSolverAdapter(
+  SolverContext &sc, const std::vector<SolverAdapter *> &w)
+  : SolverAdapter(sc), workers(w), wins(w.size(), 0), winner(0),
+    workerEpochs(w.size(), 0) {
+  assert(!workers.empty() && "A portfolio needs at least one worker.");
+}
+
+PortfolioSolverAdapter::~PortfolioSolverAdapter() {
+  for (unsigned i = 0; i < workers.size(); ++i)
+    delete workers[i];
+}
+
+SolverResult
+PortfolioSolverAdapter::race(const std::vector<SymConstraint> *assumptions) {
+  {
+    std::lock_guard<std::mutex> guard(epochLock);
+    if (epoch.isInterrupted())
+      return SAT_Undetermined;
+    for (unsigned i = 0; i < workers.size(); ++i)
+      workerEpochs[i] = workers[i]->getCheckEpoch() + 1;
+  }
+  if (workers.size() == 1) {
+    winner = 0;
+    ++wins[0];
+    return assumptions ? workers[0]->checkSatAssuming(*assumptions)
+                       : workers[0]->checkSat();
+  }
+
+  Race race(workers.size());
+  std::vector<std::thread> threads;
+  for (unsigned i = 0; i < workers.size(); ++i)
+    threads.push_back(std::thread(runWorker, &race, workers[i], i,
+                                  assumptions));
+
+  {
+    std::unique_lock<std::mutex> guard(race.lock);
+    while (race.winner < 0 && race.numRunning > 0 && !epoch.isInterrupted())
+      race.finished.wait_for(guard, RetryInterval);
+    // Interrupt the checks that are still running. Z3 may drop an interrupt
+    // that arrives while it sets up a check, so they are sent again until
+    // every worker has returned; a worker returns under the lock, so none
+    // reaches its next check.
+    while (race.numRunning > 0) {
+      for (unsigned i = 0; i < workers.size(); ++i) {
+        if (race.running[i])
+          workers[i]->interruptCheck(
+            std::max(workerEpochs[i], workers[i]->getCheckEpoch()));
+      }
+      race.finished.wait_for(guard, RetryInterval);
+    }
+  }
+  for (unsigned i = 0; i < threads.size(); ++i)
+    threads[i].join();
+
+  if (race.winner >= 0) {
+    winner = race.winner;
+  } else {
+    // Nobody decided: prefer reporting a timeout.
+    winner = 0;
+    for (unsigned i = 0; i < workers.size(); ++i) {
+      if (race.results[i] == SAT_Timeout) {
+        winner = i;
+        break;
+      }
+    }
+  }
+  ++wins[winner];
+  return race.results[winner];
+}
+
+SolverResult PortfolioSolverAdapter::checkSat() {
+  epoch.begin();
+  Timer timer;
+  return finishRace(race(0), timer.getMicroseconds());
+}
+
+SolverResult PortfolioSolverAdapter::checkSatAssuming(
+  const std::vector<SymConstraint> &assumptions) {
+  epoch.begin();
+  Timer timer;
+  return finishRace(race(&assumptions), timer.getMicroseconds());
+}
+
+SolverResult PortfolioSolverAdapter::finishRace(SolverResult r,
+                                                double time) {
+  QueryStats qs;
+  qs.result = r;
+  qs.solveTime = time;
+  recordQuery(qs);
+  return r;
+}
+
+void PortfolioSolverAdapter::getFailedAssumptions(
+  std::vector<SymConstraint> &failed) {
+  workers[winner]->getFailedAssumptions(failed);
+}
+
+void PortfolioSolverAdapter::assertSymConstraint(const SymConstraint &sc) {
+  for (unsigned i = 0; i < workers.size(); ++i)
+    workers[i]->assertSymConstraint(sc);
+}
+
+void PortfolioSolverAdapter::printModel() {
+  workers[winner]->printModel();
+}
+
+void PortfolioSolverAdapter::getModel(SymModel &m) {
+  workers[winner]->getModel(m);
+}
+
+void PortfolioSolverAdapter::reset() {
+  for (unsigned i = 0; i < workers.size(); ++i)
+    workers[i]->reset();
+  winner = 0;
+}
+
+void PortfolioSolverAdapter::interruptCheck(unsigned e) {
+  std::lock_guard<std::mutex> guard(epochLock);
+  if (epoch.interrupt(e)) {
+    for (unsigned i = 0; i < workers.size(); ++i)
+      workers[i]->interruptCheck(
+        std::max(workerEpochs[i], workers[i]->getCheckEpoch()));
+  }
+}
+
+void PortfolioSolverAdapter::push() {
+  for (unsigned i = 0; i < workers.size(); ++i)
+    workers[i]->push();
+}
+
+void PortfolioSolverAdapter::pop(unsigned n) {
+  for (unsigned i = 0; i < workers.size(); ++i)
+    workers[i]->pop(n);
+}
+
+unsigned PortfolioSolverAdapter::getNumScopes() const {
+  return workers[0]->getNumScopes();
+}
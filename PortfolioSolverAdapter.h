@@ -0,0 +1,64 @@
+#ifndef SMTADAPTER_PORTFOLIO_SOLVER_ADAPTER_H	// -*- C++ -*-
+#define SMTADAPTER_PORTFOLIO_SOLVER_ADAPTER_H
+#include "CheckEpoch.h"
+#include "smtadapter/SolverAdapter.h"
+#include "smtadapter/SymModel.h"
+#include <mutex>
+#include <vector>
+
+namespace smt {
+
+// Race several differently configured solvers on every check. Each worker
+// holds its own copy of the asserted constraints; a check runs all workers
+// in parallel, returns the first SAT or UNSAT answer and interrupts the
+// others. Models and failed assumptions come from the winning worker.
+//
+// Constraints are translated on the calling thread, except the assumptions
+// of checkSatAssuming(), which every worker translates on its own thread.
+class PortfolioSolverAdapter : public SolverAdapter {
+public:
+  // The adapter owns the workers.
+  PortfolioSolverAdapter(SolverContext &sc,
+                         const std::vector<SolverAdapter *> &w);
+  ~PortfolioSolverAdapter();
+
+  virtual SolverResult checkSat();
+  virtual SolverResult
+  checkSatAssuming(const std::vector<SymConstraint> &assumptions);
+  virtual void getFailedAssumptions(std::vector<SymConstraint> &failed);
+  virtual void assertSymConstraint(const SymConstraint &sc);
+  virtual void printModel();
+  virtual void getModel(SymModel &m);
+  virtual void reset();
+  virtual unsigned getCheckEpoch() const { return epoch.get(); }
+  virtual void interruptCheck(unsigned e);
+  virtual void push();
+  virtual void pop(unsigned n = 1);
+  virtual unsigned getNumScopes() const;
+
+  unsigned getNumWorkers() const { return workers.size(); }
+  // The worker that answered the last check.
+  unsigned getLastWinner() const { return winner; }
+  // How many checks each worker has won.
+  unsigned getNumWins(unsigned i) const { return wins[i]; }
+
+private:
+  SolverResult race(const std::vector<SymConstraint> *assumptions);
+  // Record the wall time of a race; the workers keep their own statistics.
+  SolverResult finishRace(SolverResult r, double time);
+
+private:
+  std::vector<SolverAdapter *> workers;
+  std::vector<unsigned> wins;
+  unsigned winner;
+
+  CheckEpoch epoch;
+  // The check of each worker for the current check, under epochLock, see
+  // SolverAdapterLayer::backendEpoch.
+  std::vector<unsigned> workerEpochs;
+  std::mutex epochLock;
+};
+
+}
+
+#endif
@@ -0,0 +1,144 @@
+#include "SimplifyingSolverAdapter.h"
+#include <iostream>
+
+using namespace smt;
+
+SimplifyingSolverAdapter::SimplifyingSolverAdapter(SolverAdapter *b)
+  : SolverAdapterLayer(b), mgr(b->getContext()),
+    simplifier(b->getContext(), mgr), numForwarded(0), falseScope(~0U),
+    lastDecided(false), numQueries(0), numDecided(0) {}
+
+bool SimplifyingSolverAdapter::isDecided(SolverResult &result) const {
+  if (falseScope != ~0U) {
+    result = SAT_Unsatisfiable;
+    return true;
+  }
+  if (numForwarded == 0) {
+    result = SAT_Satisfiable;
+    return true;
+  }
+  return false;
+}
+
+SolverResult SimplifyingSolverAdapter::checkSat() {
+  epoch.begin();
+  ++numQueries;
+  lastFailed.clear();
+  SolverResult result;
+  lastDecided = isDecided(result);
+  if (lastDecided) {
+    ++numDecided;
+    return result;
+  }
+  return checkBackend(0);
+}
+
+SolverResult SimplifyingSolverAdapter::checkSatAssuming(
+  const std::vector<SymConstraint> &assumptions) {
+  epoch.begin();
+  ++numQueries;
+  lastFailed.clear();
+  SolverResult result;
+  lastDecided = isDecided(result);
+  if (lastDecided && result == SAT_Unsatisfiable) {
+    ++numDecided;
+    return result;
+  }
+
+  std::vector<SymConstraint> simplified;
+  std::vector<unsigned> origins;
+  for (unsigned i = 0; i < assumptions.size(); ++i) {
+    const SymExpr *cond = simplifier.simplify(assumptions[i].cond);
+    bool expected = assumptions[i].assumption;
+    if ((expected && simplifier.isFalse(cond)) ||
+        (!expected && simplifier.isTrue(cond))) {
+      lastDecided = true;
+      lastFailed.push_back(assumptions[i]);
+      ++numDecided;
+      return SAT_Unsatisfiable;
+    }
+    if (simplifier.isTrue(cond) || simplifier.isFalse(cond))
+      continue;
+    simplified.push_back(SymConstraint(cond, expected));
+    origins.push_back(i);
+  }
+
+  if (lastDecided && simplified.empty()) {
+    ++numDecided;
+    return result;
+  }
+  lastDecided = false;
+  result = checkBackend(&simplified);
+  if (result == SAT_Unsatisfiable) {
+    std::vector<SymConstraint> failed;
+    backend->getFailedAssumptions(failed);
+    for (unsigned i = 0; i < failed.size(); ++i)
+      for (unsigned j = 0; j < simplified.size(); ++j)
+        if (failed[i] == simplified[j]) {
+          lastFailed.push_back(assumptions[origins[j]]);
+          break;
+        }
+  }
+  return result;
+}
+
+void SimplifyingSolverAdapter::getFailedAssumptions(
+  std::vector<SymConstraint> &failed) {
+  failed = lastFailed;
+}
+
+void SimplifyingSolverAdapter::assertSymConstraint(const SymConstraint &sc) {
+  constraints.push_back(sc);
+  const SymExpr *cond = simplifier.simplify(sc.cond);
+  if (simplifier.isTrue(cond) || simplifier.isFalse(cond)) {
+    if (simplifier.isTrue(cond) != sc.assumption && falseScope == ~0U)
+      falseScope = scopeMarks.size();
+    return;
+  }
+  backend->assertSymConstraint(SymConstraint(cond, sc.assumption));
+  ++numForwarded;
+}
+
+void SimplifyingSolverAdapter::printModel() {
+  if (!lastDecided) {
+    backend->printModel();
+    return;
+  }
+  SymModel m;
+  m.print(std::cout);
+}
+
+void SimplifyingSolverAdapter::getModel(SymModel &m) {
+  if (!lastDecided) {
+    backend->getModel(m);
+    return;
+  }
+  // Nothing was left to satisfy, any assignment does.
+  m.clear();
+}
+
+void SimplifyingSolverAdapter::reset() {
+  SolverAdapterLayer::reset();
+  numForwarded = 0;
+  forwardedMarks.clear();
+  falseScope = ~0U;
+  lastDecided = false;
+  lastFailed.clear();
+  mgr.clear();
+  simplifier.clear();
+}
+
+void SimplifyingSolverAdapter::push() {
+  SolverAdapterLayer::push();
+  forwardedMarks.push_back(numForwarded);
+}
+
+void SimplifyingSolverAdapter::pop(unsigned n) {
+  SolverAdapterLayer::pop(n);
+  if (n == 0)
+    return;
+  numForwarded = forwardedMarks[forwardedMarks.size() - n];
+  forwardedMarks.resize(forwardedMarks.size() - n);
+  if (falseScope != ~0U && falseScope > scopeMarks.size())
+    falseScope = ~0U;
+}
@@ -0,0 +1,58 @@
+#ifndef SMTADAPTER_SIMPLIFYING_SOLVER_ADAPTER_H	// -*- C++ -*-
+#define SMTADAPTER_SIMPLIFYING_SOLVER_ADAPTER_H
+#include "SolverAdapterLayer.h"
+#include "SymExprSimplifier.h"
+
+namespace smt {
+
+// Simplify every constraint before it reaches the backend. Constraints that
+// fold to true are dropped, and a query with a constraint that folds to
+// false is UNSAT without calling the backend, as is a query left with
+// nothing to check SAT.
+class SimplifyingSolverAdapter : public SolverAdapterLayer {
+public:
+  SimplifyingSolverAdapter(SolverAdapter *b);
+
+  virtual SolverResult checkSat();
+  virtual SolverResult
+  checkSatAssuming(const std::vector<SymConstraint> &assumptions);
+  virtual void getFailedAssumptions(std::vector<SymConstraint> &failed);
+  virtual void assertSymConstraint(const SymConstraint &sc);
+  virtual void printModel();
+  virtual void getModel(SymModel &m);
+  virtual void reset();
+  virtual void push();
+  virtual void pop(unsigned n = 1);
+
+  SymExprSimplifier &getSimplifier() { return simplifier; }
+
+  unsigned getNumQueries() const { return numQueries; }
+  // The number of queries decided without the backend.
+  unsigned getNumDecided() const { return numDecided; }
+
+private:
+  // Get the result of the current query if it is decided by the asserted
+  // constraints alone.
+  bool isDecided(SolverResult &result) const;
+
+private:
+  SymExprManager mgr;
+  SymExprSimplifier simplifier;
+  // The number of constraints sent to the backend, and its value at each
+  // push().
+  unsigned numForwarded;
+  std::vector<unsigned> forwardedMarks;
+  // The scope depth at which a constraint folded to false, or ~0U.
+  unsigned falseScope;
+
+  // Whether the last query was decided here, and its failed assumptions.
+  bool lastDecided;
+  std::vector<SymConstraint> lastFailed;
+
+  unsigned numQueries;
+  unsigned numDecided;
+};
+
+}
+
+#endif
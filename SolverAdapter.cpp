@@ -1,8 +1,136 @@
 #include "smtadapter/SolverAdapter.h"
+#include "smtadapter/SolverFuture.h"
+#include "smtadapter/SolverStats.h"
+#include "smtadapter/SymModel.h"
+#include "ArrayEliminatingSolverAdapter.h"
+#include "AsyncSolverAdapter.h"
+#include "BitBlastAdapter.h"
 #include "Z3Adapter.h"
+#include "BoolectorAdapter.h"
+#include "CachingSolverAdapter.h"
+#include "IndependentSolverAdapter.h"
+#include "IntervalSolverAdapter.h"
+#include "ModelReuseSolverAdapter.h"
+#include "PersistentCacheSolverAdapter.h"
+#include "PortfolioSolverAdapter.h"
+#include "SimplifyingSolverAdapter.h"
+#include "SymExprEvaluator.h"
 
 namespace smt {
+SolverAdapter::SolverAdapter(SolverContext &c)
+  : ctx(c), stats(new SolverStats()), traceHook(0), traceData(0),
+    collectBackendStats(false), statsDump(0) {}
+
+SolverAdapter::~SolverAdapter() {
+  if (statsDump)
+    stats->print(*statsDump);
+  delete stats;
+}
+
+void SolverAdapter::recordQuery(const QueryStats &qs) {
+  stats->addQuery(qs);
+  if (traceHook)
+    traceHook(qs, traceData);
+}
+
+SolverFuture
+SolverAdapter::checkSatAsync(const std::vector<SymConstraint> &assumptions) {
+  std::shared_ptr<SolverFutureState> state(new SolverFutureState());
+  SolverResult r = assumptions.empty() ? checkSat()
+    : checkSatAssuming(assumptions);
+  if (r == SAT_Satisfiable)
+    getModel(state->model);
+  else if (r == SAT_Unsatisfiable && !assumptions.empty())
+    getFailedAssumptions(state->failed);
+  state->finish(r);
+  return SolverFuture(state);
+}
+
+std::vector<SolverResult>
+SolverAdapter::checkSatBatch(const std::vector<SymConstraint> &prefix,
+                             const std::vector<SymConstraint> &candidates) {
+  std::vector<SolverResult> results(candidates.size(), SAT_Undetermined);
+  push();
+  for (unsigned i = 0; i < prefix.size(); ++i)
+    assertSymConstraint(prefix[i]);
+  for (unsigned i = 0; i < candidates.size(); ++i) {
+    if (results[i] != SAT_Undetermined)
+      continue;
+    results[i] =
+      checkSatAssuming(std::vector<SymConstraint>(1, candidates[i]));
+    if (results[i] != SAT_Satisfiable)
+      continue;
+    SymModel m;
+    getModel(m);
+    SymExprEvaluator ev(ctx, m);
+    settleCandidates(ev, candidates, i + 1, results);
+  }
+  pop();
+  return results;
+}
+
 SolverAdapter *CreateZ3SolverAdapter(SolverContext &ctx) {
   return new Z3Adapter(ctx);
 }
+
+SolverAdapter *CreateBoolectorSolverAdapter(SolverContext &ctx) {
+  return new BoolectorAdapter(ctx);
+}
+
+SolverAdapter *CreateBitBlastSolverAdapter(SolverContext &ctx) {
+  return new BitBlastAdapter(ctx);
+}
+
+SolverAdapter *CreatePortfolioSolverAdapter(SolverContext &ctx) {
+  std::vector<SolverAdapter *> workers;
+  Z3Config cfg;
+  workers.push_back(new Z3Adapter(ctx, cfg));
+  cfg.logic = "QF_ABV";
+  cfg.seed = 1;
+  workers.push_back(new Z3Adapter(ctx, cfg));
+  cfg.logic = "QF_AUFBV";
+  cfg.seed = 2;
+  workers.push_back(new Z3Adapter(ctx, cfg));
+  return new PortfolioSolverAdapter(ctx, workers);
+}
+
+SolverAdapter *
+CreatePortfolioSolverAdapter(SolverContext &ctx,
+                             const std::vector<SolverAdapter *> &workers) {
+  return new PortfolioSolverAdapter(ctx, workers);
+}
+
+SolverAdapter *CreateCachingSolverAdapter(SolverAdapter *backend) {
+  return new CachingSolverAdapter(backend);
+}
+
+SolverAdapter *CreateIndependentSolverAdapter(SolverAdapter *backend) {
+  return new IndependentSolverAdapter(backend);
+}
+
+SolverAdapter *CreateSimplifyingSolverAdapter(SolverAdapter *backend) {
+  return new SimplifyingSolverAdapter(backend);
+}
+
+SolverAdapter *CreateIntervalSolverAdapter(SolverAdapter *backend) {
+  return new IntervalSolverAdapter(backend);
+}
+
+SolverAdapter *CreateArrayEliminatingSolverAdapter(SolverAdapter *backend) {
+  return new ArrayEliminatingSolverAdapter(backend);
+}
+
+SolverAdapter *CreateModelReuseSolverAdapter(SolverAdapter *backend) {
+  return new ModelReuseSolverAdapter(backend);
+}
+
+SolverAdapter *CreatePersistentCacheSolverAdapter(SolverAdapter *backend,
+                                                  const char *path) {
+  return new PersistentCacheSolverAdapter(backend, path);
+}
+
+SolverAdapter *CreateAsyncSolverAdapter(SolverAdapter *backend,
+                                        unsigned maxOutstanding) {
+  return new AsyncSolverAdapter(backend, maxOutstanding);
+}
 }
@@ -0,0 +1,125 @@
+#ifndef SMTADAPTER_SOLVER_ADAPTER_LAYER_H	// -*- C++ -*-
+#define SMTADAPTER_SOLVER_ADAPTER_LAYER_H
+#include "CheckEpoch.h"
+#include "smtadapter/SolverAdapter.h"
+#include "smtadapter/SymModel.h"
+#include <algorithm>
+#include <assert.h>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace smt {
+
+// Order constraints by address, to put constraint sets in canonical form.
+struct SymConstraintLess {
+  bool operator()(const SymConstraint &a, const SymConstraint &b) const {
+    if (a.cond != b.cond)
+      return std::less<const SymExpr *>()(a.cond, b.cond);
+    return a.assumption < b.assumption;
+  }
+};
+
+// A SolverAdapter that sits in front of another one. It keeps its own copy
+// of the asserted constraints and their scopes, so that a layer can reason
+// about the whole query, and forwards everything to the backend by default.
+//
+// A layer numbers its own checks, since it may answer some without the
+// backend and run several backend checks for others: a check starts with
+// epoch.begin() and goes to the backend through checkBackend().
+class SolverAdapterLayer : public SolverAdapter {
+protected:
+  SolverAdapter *backend;
+  // The asserted constraints, outermost scope first.
+  std::vector<SymConstraint> constraints;
+  // constraints.size() at each push().
+  std::vector<unsigned> scopeMarks;
+
+  CheckEpoch epoch;
+  // The last backend check started by a check of the layer, under
+  // epochLock, so that interruptCheck() reaches the backend check of the
+  // current check and no other.
+  unsigned backendEpoch;
+  std::mutex epochLock;
+
+  // Check with the backend for the current check, unless it was
+  // interrupted; assumptions is 0 for checkSat().
+  SolverResult checkBackend(const std::vector<SymConstraint> *assumptions) {
+    {
+      std::lock_guard<std::mutex> guard(epochLock);
+      if (epoch.isInterrupted())
+        return SAT_Undetermined;
+      backendEpoch = backend->getCheckEpoch() + 1;
+    }
+    return assumptions ? backend->checkSatAssuming(*assumptions)
+                       : backend->checkSat();
+  }
+
+public:
+  SolverAdapterLayer(SolverAdapter *b)
+    : SolverAdapter(b->getContext()), backend(b), backendEpoch(0) {}
+  virtual ~SolverAdapterLayer() { delete backend; }
+
+  SolverAdapter *getBackend() const { return backend; }
+  const std::vector<SymConstraint> &getConstraints() const {
+    return constraints;
+  }
+
+  virtual const SolverStats &getStats() const { return backend->getStats(); }
+  virtual void setTraceHook(QueryTraceHook hook, void *data) {
+    backend->setTraceHook(hook, data);
+  }
+  virtual void setCollectBackendStats(bool b) {
+    backend->setCollectBackendStats(b);
+  }
+  virtual void setStatsDump(std::ostream *os) { backend->setStatsDump(os); }
+
+  virtual SolverResult checkSat() {
+    epoch.begin();
+    return checkBackend(0);
+  }
+  virtual SolverResult
+  checkSatAssuming(const std::vector<SymConstraint> &assumptions) {
+    epoch.begin();
+    return checkBackend(&assumptions);
+  }
+  virtual void getFailedAssumptions(std::vector<SymConstraint> &failed) {
+    backend->getFailedAssumptions(failed);
+  }
+  virtual void assertSymConstraint(const SymConstraint &sc) {
+    constraints.push_back(sc);
+    backend->assertSymConstraint(sc);
+  }
+  virtual void printModel() { backend->printModel(); }
+  virtual void getModel(SymModel &m) { backend->getModel(m); }
+  virtual void reset() {
+    constraints.clear();
+    scopeMarks.clear();
+    backend->reset();
+  }
+  virtual unsigned getCheckEpoch() const { return epoch.get(); }
+  virtual void interruptCheck(unsigned e) {
+    std::lock_guard<std::mutex> guard(epochLock);
+    if (epoch.interrupt(e))
+      backend->interruptCheck(std::max(backendEpoch,
+                                       backend->getCheckEpoch()));
+  }
+  virtual void push() {
+    scopeMarks.push_back(constraints.size());
+    backend->push();
+  }
+  virtual void pop(unsigned n = 1) {
+    assert(n <= scopeMarks.size() && "Cannot pop more scopes than pushed.");
+    if (n == 0)
+      return;
+    constraints.erase(constraints.begin() + scopeMarks[scopeMarks.size() - n],
+                      constraints.end());
+    scopeMarks.resize(scopeMarks.size() - n);
+    backend->pop(n);
+  }
+  virtual unsigned getNumScopes() const { return scopeMarks.size(); }
+};
+
+}
+
+#endif
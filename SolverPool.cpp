@@ -0,0 +1,183 @@
+#include "smtadapter/SolverPool.h"
+#include "AsyncSolverAdapter.h"
+#include "SymExprEvaluator.h"
+#include <assert.h>
+
+using namespace smt;
+
+SolverPool::SolverPool(SolverContext &c, unsigned size,
+                       SolverAdapterFactory f, void *data, const char *path)
+  : ctx(c), factory(f), factoryData(data), cachePath(path ? path : ""),
+    nextSlot(0), numReady(0), stopping(false), numCheckouts(0),
+    numAffinityHits(0), numSteals(0) {
+  assert(size > 0 && "A pool needs at least one adapter.");
+  for (unsigned i = 0; i < size; ++i)
+    slots.push_back(new Slot());
+  // Set up the contexts in parallel.
+  for (unsigned i = 0; i < size; ++i)
+    slots[i]->thread = std::thread(&SolverPool::run, this, i);
+  std::unique_lock<std::mutex> guard(lock);
+  while (numReady < size)
+    changed.wait(guard);
+}
+
+SolverPool::~SolverPool() {
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    stopping = true;
+    for (unsigned i = 0; i < slots.size(); ++i) {
+      Slot &slot = *slots[i];
+      assert((!slot.busy || slot.current) &&
+             "Adapter still checked out.");
+      for (unsigned j = 0; j < slot.queue.size(); ++j)
+        slot.queue[j].state->finish(SAT_Undetermined);
+      slot.queue.clear();
+      if (slot.current)
+        SolverFuture(slot.current).cancel();
+    }
+    changed.notify_all();
+  }
+  for (unsigned i = 0; i < slots.size(); ++i) {
+    slots[i]->thread.join();
+    delete slots[i]->adapter;
+    delete slots[i];
+  }
+}
+
+void SolverPool::run(unsigned i) {
+  Slot &slot = *slots[i];
+  SolverAdapter *adapter = factory ? factory(ctx, factoryData)
+    : CreateZ3SolverAdapter(ctx);
+  adapter->checkSat();
+  if (!cachePath.empty())
+    adapter = CreatePersistentCacheSolverAdapter(adapter, cachePath.c_str());
+
+  std::unique_lock<std::mutex> guard(lock);
+  slot.adapter = adapter;
+  ++numReady;
+  changed.notify_all();
+  for (;;) {
+    Job job;
+    while (!stopping && (slot.busy || !takeJob(i, job)))
+      changed.wait(guard);
+    if (stopping)
+      return;
+    slot.busy = true;
+    slot.current = job.state;
+    guard.unlock();
+    AsyncSolverAdapter::runCheck(adapter, *job.state, job.constraints,
+                                 job.assumptions);
+    guard.lock();
+    slot.busy = false;
+    slot.current.reset();
+    changed.notify_all();
+  }
+}
+
+bool SolverPool::takeJob(unsigned i, Job &job) {
+  std::deque<Job> &own = slots[i]->queue;
+  if (!own.empty()) {
+    job = own.front();
+    own.pop_front();
+    ++numAffinityHits;
+    return true;
+  }
+  // Steal the newest query of the longest queue; its owner works on the
+  // oldest ones.
+  unsigned victim = i;
+  size_t longest = 0;
+  for (unsigned j = 0; j < slots.size(); ++j)
+    if (slots[j]->queue.size() > longest) {
+      victim = j;
+      longest = slots[j]->queue.size();
+    }
+  if (!longest)
+    return false;
+  job = slots[victim]->queue.back();
+  slots[victim]->queue.pop_back();
+  ++numSteals;
+  return true;
+}
+
+unsigned SolverPool::getHomeSlot() {
+  std::thread::id id = std::this_thread::get_id();
+  std::map<std::thread::id, unsigned>::iterator it = affinity.find(id);
+  if (it != affinity.end())
+    return it->second;
+  unsigned i = nextSlot++ % slots.size();
+  affinity[id] = i;
+  return i;
+}
+
+SolverAdapter *SolverPool::checkout() {
+  std::unique_lock<std::mutex> guard(lock);
+  unsigned home = getHomeSlot(), chosen = slots.size();
+  for (;;) {
+    if (!slots[home]->busy) {
+      chosen = home;
+      ++numAffinityHits;
+      break;
+    }
+    for (unsigned i = 0; i < slots.size() && chosen == slots.size(); ++i)
+      if (!slots[i]->busy)
+        chosen = i;
+    if (chosen < slots.size())
+      break;
+    changed.wait(guard);
+  }
+  slots[chosen]->busy = true;
+  affinity[std::this_thread::get_id()] = chosen;
+  ++numCheckouts;
+  SolverAdapter *adapter = slots[chosen]->adapter;
+  guard.unlock();
+  adapter->push();
+  return adapter;
+}
+
+void SolverPool::checkin(SolverAdapter *adapter) {
+  adapter->pop(adapter->getNumScopes());
+  std::lock_guard<std::mutex> guard(lock);
+  unsigned i = 0;
+  while (i < slots.size() && slots[i]->adapter != adapter)
+    ++i;
+  assert(i < slots.size() && slots[i]->busy && "Not checked out.");
+  slots[i]->busy = false;
+  changed.notify_all();
+}
+
+SolverFuture
+SolverPool::submit(const std::vector<SymConstraint> &constraints,
+                   const std::vector<SymConstraint> &assumptions) {
+  std::shared_ptr<SolverFutureState> state(new SolverFutureState());
+  Job job;
+  job.state = state;
+  job.constraints = constraints;
+  job.assumptions = assumptions;
+  std::lock_guard<std::mutex> guard(lock);
+  slots[getHomeSlot()]->queue.push_back(job);
+  changed.notify_all();
+  return SolverFuture(state);
+}
+
+std::vector<SolverResult>
+SolverPool::checkSatBatch(const std::vector<SymConstraint> &constraints,
+                          const std::vector<SymConstraint> &candidates) {
+  std::vector<SolverResult> results(candidates.size(), SAT_Undetermined);
+  unsigned next = 0;
+  while (next < candidates.size()) {
+    std::vector<std::pair<unsigned, SolverFuture> > wave;
+    for (; next < candidates.size() && wave.size() < slots.size(); ++next)
+      if (results[next] == SAT_Undetermined)
+        wave.push_back(std::make_pair(
+          next, submit(constraints,
+                       std::vector<SymConstraint>(1, candidates[next]))));
+    for (unsigned i = 0; i < wave.size(); ++i) {
+      results[wave[i].first] = wave[i].second.wait();
+      if (results[wave[i].first] != SAT_Satisfiable)
+        continue;
+      SymExprEvaluator ev(ctx, wave[i].second.getModel());
+      settleCandidates(ev, candidates, next, results);
+    }
+  }
+  return results;
+}
@@ -0,0 +1,86 @@
+#include "smtadapter/SolverStats.h"
+#include <algorithm>
+#include <iomanip>
+
+using namespace smt;
+
+void LatencyHistogram::clear() {
+  for (unsigned i = 0; i < NumBuckets; ++i)
+    buckets[i] = 0;
+  count = 0;
+  total = 0;
+  max = 0;
+}
+
+void LatencyHistogram::add(double us) {
+  unsigned i = 0;
+  while (i + 1 < NumBuckets && us >= (double)((uint64_t)1 << i))
+    ++i;
+  ++buckets[i];
+  ++count;
+  total += us;
+  if (us > max)
+    max = us;
+}
+
+double LatencyHistogram::getPercentile(unsigned p) const {
+  uint64_t rank = (count * p + 99) / 100;
+  uint64_t seen = 0;
+  for (unsigned i = 0; i < NumBuckets; ++i) {
+    seen += buckets[i];
+    if (seen >= rank && seen > 0)
+      return std::min(max, (double)((uint64_t)1 << i));
+  }
+  return max;
+}
+
+void LatencyHistogram::print(std::ostream &os) const {
+  os << "count " << count << ", mean "
+     << (count ? total / count : 0) << "us, p50 " << getPercentile(50)
+     << "us, p90 " << getPercentile(90) << "us, p99 " << getPercentile(99)
+     << "us, max " << max << "us\n";
+  for (unsigned i = 0; i < NumBuckets; ++i) {
+    if (buckets[i])
+      os << "    < " << std::setw(12) << ((uint64_t)1 << i) << "us: "
+         << buckets[i] << "\n";
+  }
+}
+
+void SolverStats::clear() {
+  numQueries = 0;
+  for (unsigned i = 0; i < 4; ++i)
+    numResults[i] = 0;
+  numNodes = 0;
+  maxDecls = 0;
+  translateTimes.clear();
+  solveTimes.clear();
+  backendStats.clear();
+}
+
+void SolverStats::addQuery(const QueryStats &qs) {
+  ++numQueries;
+  ++numResults[qs.result];
+  numNodes += qs.numNodes;
+  if (qs.numDecls > maxDecls)
+    maxDecls = qs.numDecls;
+  translateTimes.add(qs.translateTime);
+  solveTimes.add(qs.solveTime);
+  for (unsigned i = 0; i < qs.backendStats.size(); ++i)
+    backendStats[qs.backendStats[i].first] += qs.backendStats[i].second;
+}
+
+void SolverStats::print(std::ostream &os) const {
+  os << "queries: " << numQueries << " (sat " << numResults[SAT_Satisfiable]
+     << ", unsat " << numResults[SAT_Unsatisfiable] << ", timeout "
+     << numResults[SAT_Timeout] << ", undetermined "
+     << numResults[SAT_Undetermined] << ")\n";
+  os << "translated nodes: " << numNodes << ", max decls: " << maxDecls
+     << "\n";
+  os << "translate time: ";
+  translateTimes.print(os);
+  os << "solve time: ";
+  solveTimes.print(os);
+  for (std::map<std::string, double>::const_iterator
+         it = backendStats.begin(), ie = backendStats.end(); it != ie; ++it)
+    os << "  " << it->first << ": " << it->second << "\n";
+}
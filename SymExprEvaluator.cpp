@@ -0,0 +1,191 @@
+#include "SymExprEvaluator.h"
+#include "BitVector.h"
+#include "smtadapter/SymExprVisitor.h"
+#include <algorithm>
+
+using namespace smt;
+
+SymExprEvaluator::SymExprEvaluator(SolverContext &c, const SymModel &m)
+  : ctx(c), model(m) {}
+
+bool SymExprEvaluator::evaluate(const SymExpr *e, uint64_t &v) {
+  const Value &val = eval(e);
+  v = val.bits;
+  return val.valid;
+}
+
+bool SymExprEvaluator::satisfies(const SymConstraint &sc) {
+  uint64_t v = 0;
+  return evaluate(sc.cond, v) && (v != 0) == sc.assumption;
+}
+
+SymExprEvaluator::Value SymExprEvaluator::evalElem(const ElemSymExpr *e) {
+  Value val = { 0, 0, false };
+  // Collect the indices, innermost dimension first.
+  ArrayValue::Index index;
+  const SymExpr *base = e;
+  while (ElemSymExpr::classof(base)) {
+    const ElemSymExpr *elem = static_cast<const ElemSymExpr *>(base);
+    const Value &i = lookup(elem->getIndexExpr());
+    if (!i.valid)
+      return val;
+    index.push_back(i.bits);
+    base = elem->getBaseExpr();
+  }
+  assert(RegionSymbol::classof(base) && "Unknown array base.");
+  const RegionSymbol *region = static_cast<const RegionSymbol *>(base);
+  if (index.size() != region->getNumberDimension(ctx))
+    return val;
+  val.width = region->getElementTypeSizeInBits(ctx);
+  if (val.width > 64)
+    return val;
+  std::reverse(index.begin(), index.end());
+  const ArrayValue *array = model.getArray(region->getSymbolID());
+  val.bits = array ? bv::trunc(array->getValue(index), val.width) : 0;
+  val.valid = true;
+  return val;
+}
+
+// Compute the value of one node from the cached values of its operands.
+class SymExprEvaluator::Visitor
+  : public SymExprVisitor<SymExprEvaluator::Visitor, SymExprEvaluator::Value> {
+public:
+  Visitor(SymExprEvaluator &e) : ev(e), ctx(e.ctx) {}
+
+  Value visitScalarSymbol(const ScalarSymbol *sym) {
+    Value val = { 0, sym->getBitWidth(ctx), false };
+    ev.model.getScalar(sym->getSymbolID(), val.bits);
+    val.bits = bv::trunc(val.bits, val.width);
+    val.valid = val.width <= 64;
+    return val;
+  }
+
+  Value visitRegionSymbol(const RegionSymbol *) {
+    Value val = { 0, 0, false };
+    return val;
+  }
+
+  Value visitConstExpr(const ConstExpr *ce) {
+    Value val = { 0, ce->getBitWidth(ctx), false };
+    val.bits = bv::trunc((uint64_t)ce->getValue(), val.width);
+    val.valid = val.width <= 64;
+    return val;
+  }
+
+  Value visitElemSymExpr(const ElemSymExpr *e) { return ev.evalElem(e); }
+
+  Value visitArithSymExpr(const ArithSymExpr *bin) {
+    Value val = { 0, 0, false };
+    const Value &l = ev.lookup(bin->getLHS());
+    const Value &r = ev.lookup(bin->getRHS());
+    if (!l.valid || !r.valid)
+      return val;
+    val.width = l.width;
+    val.bits = bv::evalArith(bin->getOpcode(), l.bits, r.bits, l.width);
+    val.valid = true;
+    return val;
+  }
+
+  Value visitLogicalSymExpr(const LogicalSymExpr *bin) {
+    Value val = { 0, 0, false };
+    const Value &l = ev.lookup(bin->getLHS());
+    const Value &r = ev.lookup(bin->getRHS());
+    if (!l.valid || !r.valid)
+      return val;
+    val.width = 1;
+    val.bits = bv::evalLogical(bin->getOpcode(), l.bits, r.bits, l.width);
+    val.valid = true;
+    return val;
+  }
+
+  Value visitUnarySymExpr(const UnarySymExpr *un) {
+    Value val = { 0, 0, false };
+    const Value &op = ev.lookup(un->getOperand());
+    if (!op.valid)
+      return val;
+    val.width = op.width;
+    val.bits = bv::evalUnary(un->getUnaryOpcode(), op.bits, op.width);
+    val.valid = true;
+    return val;
+  }
+
+  Value visitTruncSymExpr(const TruncSymExpr *ce) {
+    Value val = { 0, 0, false };
+    const Value &op = ev.lookup(ce->getOperand());
+    if (!op.valid)
+      return val;
+    val.width = ce->getBitWidth(ctx);
+    val.bits = bv::trunc(op.bits, val.width);
+    val.valid = true;
+    return val;
+  }
+
+  Value visitExtendSymExpr(const ExtendSymExpr *ce) {
+    Value val = { 0, ce->getBitWidth(ctx), false };
+    const Value &op = ev.lookup(ce->getOperand());
+    if (!op.valid || val.width > 64)
+      return val;
+    // A Boolean extends to 0 or 1.
+    if (isBoolSymExpr(ce->getOperand()))
+      val.bits = op.bits;
+    else if (ce->isSignedExt())
+      val.bits = bv::sext(op.bits, op.width, val.width);
+    else
+      val.bits = bv::zext(op.bits, op.width, val.width);
+    val.valid = true;
+    return val;
+  }
+
+private:
+  SymExprEvaluator &ev;
+  SolverContext &ctx;
+};
+
+const SymExprEvaluator::Value &
+SymExprEvaluator::lookup(const SymExpr *e) const {
+  std::map<const SymExpr *, Value>::const_iterator it = cache.find(e);
+  assert(it != cache.end() && "Operand evaluated out of order.");
+  return it->second;
+}
+
+const SymExprEvaluator::Value &SymExprEvaluator::eval(const SymExpr *e) {
+  std::map<const SymExpr *, Value>::iterator it = cache.find(e);
+  if (it != cache.end())
+    return it->second;
+  // Post-order walk with an explicit stack like Z3Adapter::genZ3Expr(),
+  // so that deep chains cannot overflow the native stack. A node is
+  // computed on its second visit, when its operands are in the cache.
+  work.clear();
+  work.push_back(std::make_pair(e, false));
+  while (!work.empty()) {
+    const SymExpr *n = work.back().first;
+    if (!work.back().second) {
+      if (cache.count(n)) {
+        work.pop_back();
+        continue;
+      }
+      work.back().second = true;
+      const SymExpr *ops[2];
+      for (unsigned i = getSymExprOperands(n, ops); i > 0; --i)
+        work.push_back(std::make_pair(ops[i - 1], false));
+      continue;
+    }
+    work.pop_back();
+    Value val = Visitor(*this).visit(n);
+    cache.insert(std::pair<const SymExpr *, Value>(n, val));
+  }
+  return lookup(e);
+}
+
+unsigned smt::settleCandidates(SymExprEvaluator &ev,
+                               const std::vector<SymConstraint> &candidates,
+                               unsigned first,
+                               std::vector<SolverResult> &results) {
+  unsigned n = 0;
+  for (unsigned i = first; i < candidates.size(); ++i)
+    if (results[i] == SAT_Undetermined && ev.satisfies(candidates[i])) {
+      results[i] = SAT_Satisfiable;
+      ++n;
+    }
+  return n;
+}
@@ -0,0 +1,60 @@
+#ifndef SMTADAPTER_SYMEXPR_EVALUATOR_H	// -*- C++ -*-
+#define SMTADAPTER_SYMEXPR_EVALUATOR_H
+#include "smtadapter/SolverAdapter.h"
+#include "smtadapter/Symbol.h"
+#include "smtadapter/SymModel.h"
+#include <map>
+#include <vector>
+#include <stdint.h>
+
+namespace smt {
+
+// Evaluate SymExprs under a SymModel with the semantics of the solver.
+// Symbols missing from the model are 0. Values wider than 64 bits and reads
+// of a whole array are not supported, and make evaluation fail.
+//
+// Values are memoized by the address of the node until clear().
+class SymExprEvaluator {
+public:
+  SymExprEvaluator(SolverContext &c, const SymModel &m);
+
+  // Get the bits of the value of e, Booleans are 0 or 1.
+  bool evaluate(const SymExpr *e, uint64_t &v);
+  // Check if the model satisfies sc. False if sc cannot be evaluated.
+  bool satisfies(const SymConstraint &sc);
+
+  const SymModel &getModel() const { return model; }
+  void clear() { cache.clear(); }
+
+private:
+  struct Value {
+    uint64_t bits;
+    unsigned width;
+    bool valid;
+  };
+
+  class Visitor;
+
+  const Value &eval(const SymExpr *e);
+  // The cached value of a node whose value was computed.
+  const Value &lookup(const SymExpr *e) const;
+  Value evalElem(const ElemSymExpr *e);
+
+private:
+  SolverContext &ctx;
+  const SymModel &model;
+  std::map<const SymExpr *, Value> cache;
+  // The stack of eval(), kept to reuse its storage.
+  std::vector<std::pair<const SymExpr *, bool> > work;
+};
+
+// Settle the candidates from first on whose result is still
+// SAT_Undetermined and that the model of the evaluator satisfies, as
+// SAT_Satisfiable. Return how many were settled.
+unsigned settleCandidates(SymExprEvaluator &ev,
+                          const std::vector<SymConstraint> &candidates,
+                          unsigned first, std::vector<SolverResult> &results);
+
+}
+
+#endif
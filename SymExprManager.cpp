@@ -0,0 +1,444 @@
+#include "smtadapter/SymExprManager.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <new>
+
+using namespace smt;
+
+namespace {
+
+const size_t SlabSize = 64 * 1024;
+
+// The concrete nodes of the kinds whose base class needs more state.
+// They only hold plain data, so the arena frees them without destruction.
+
+class UScalarSymbol : public ScalarSymbol {
+  unsigned width;
+
+public:
+  UScalarSymbol(unsigned id, unsigned w) : ScalarSymbol(id), width(w) {}
+  virtual unsigned getTypeSizeInBits(SolverContext &) const { return width; }
+};
+
+class URegionSymbol : public RegionSymbol {
+  unsigned elemWidth;
+  unsigned nDim;
+
+public:
+  URegionSymbol(unsigned id, unsigned ew, unsigned n)
+    : RegionSymbol(id), elemWidth(ew), nDim(n) {}
+  virtual unsigned getNumberDimension(SolverContext &) const { return nDim; }
+  virtual unsigned getElementTypeSizeInBits(SolverContext &) const {
+    return elemWidth;
+  }
+};
+
+class UElemSymExpr : public ElemSymExpr {
+  // The element width of the region, and the number of its dimensions
+  // left after this read.
+  unsigned elemWidth;
+  unsigned remainingDims;
+
+public:
+  UElemSymExpr(const SymExpr *base, const SymExpr *index, unsigned ew,
+               unsigned rd)
+    : ElemSymExpr(const_cast<SymExpr *>(base), const_cast<SymExpr *>(index)),
+      elemWidth(ew), remainingDims(rd) {}
+
+  unsigned getElementWidth() const { return elemWidth; }
+  unsigned getRemainingDims() const { return remainingDims; }
+
+  virtual unsigned getTypeSizeInBits(SolverContext &) const {
+    assert(remainingDims == 0 && "A partial array read has no width.");
+    return elemWidth;
+  }
+};
+
+class UTruncSymExpr : public TruncSymExpr {
+  unsigned width;
+
+public:
+  UTruncSymExpr(const SymExpr *op, unsigned w)
+    : TruncSymExpr(op), width(w) {}
+  virtual unsigned getTypeSizeInBits(SolverContext &) const { return width; }
+};
+
+class UExtendSymExpr : public ExtendSymExpr {
+  unsigned width;
+
+public:
+  UExtendSymExpr(const SymExpr *op, unsigned w, bool sext)
+    : ExtendSymExpr(op, sext), width(w) {}
+  virtual unsigned getTypeSizeInBits(SolverContext &) const { return width; }
+};
+
+class UConstExpr : public ConstExpr {
+  uint64_t value;
+  unsigned width;
+  bool sign;
+
+public:
+  UConstExpr(uint64_t v, unsigned w, bool s)
+    : ConstExpr(), value(v), width(w), sign(s) {}
+  virtual long long getValue() const { return value; }
+  virtual bool isSigned() const { return sign; }
+  virtual unsigned getTypeSizeInBits(SolverContext &) const { return width; }
+};
+
+inline unsigned hashCombine(unsigned h, uint64_t v) {
+  v = (v ^ (v >> 33)) * 0xff51afd7ed558ccdULL;
+  v ^= v >> 33;
+  return (h ^ (unsigned)v ^ (unsigned)(v >> 32)) * 0x01000193u + (h >> 7);
+}
+
+}
+
+namespace smt {
+
+// The shallow structure of a node: children are compared by address.
+struct SymExprManager::NodeKey {
+  SymExpr::Kind kind;
+  unsigned op;
+  unsigned width;
+  unsigned nDim;
+  bool flag;
+  uint64_t value;
+  const SymExpr *ops[2];
+
+  NodeKey(SymExpr::Kind k)
+    : kind(k), op(0), width(0), nDim(0), flag(false), value(0) {
+    ops[0] = ops[1] = 0;
+  }
+};
+
+}
+
+SymExprManager::SymExprManager(SolverContext &c)
+  : ctx(c), table(1024, (const SymExpr *)0), numNodes(0), cur(0), end(0) {}
+
+SymExprManager::~SymExprManager() {
+  clear();
+}
+
+void SymExprManager::clear() {
+  for (unsigned i = 0; i < slabs.size(); ++i)
+    free(slabs[i]);
+  slabs.clear();
+  cur = end = 0;
+  table.assign(1024, (const SymExpr *)0);
+  numNodes = 0;
+}
+
+size_t SymExprManager::getMemoryUsage() const {
+  return slabs.size() * SlabSize + table.size() * sizeof(const SymExpr *);
+}
+
+void *SymExprManager::allocate(size_t size) {
+  const size_t align = sizeof(uint64_t);
+  size = (size + align - 1) & ~(align - 1);
+  assert(size <= SlabSize && "Node is larger than a slab.");
+  if (cur + size > end) {
+    cur = static_cast<char *>(malloc(SlabSize));
+    if (!cur)
+      throw std::bad_alloc();
+    slabs.push_back(cur);
+    end = cur + SlabSize;
+  }
+  void *p = cur;
+  cur += size;
+  return p;
+}
+
+SymExprManager::NodeKey SymExprManager::getKey(const SymExpr *e) {
+  NodeKey key(e->getKind());
+  switch (e->getKind()) {
+  default:
+    assert(0 && "Unprocessed SymExpr kind.");
+  case SymExpr::S_ScalarSymbol:
+    key.value = static_cast<const Symbol *>(e)->getSymbolID();
+    key.width = e->getBitWidth(ctx);
+    break;
+  case SymExpr::S_RegionSymbol: {
+    const RegionSymbol *region = static_cast<const RegionSymbol *>(e);
+    key.value = region->getSymbolID();
+    key.width = region->getElementTypeSizeInBits(ctx);
+    key.nDim = region->getNumberDimension(ctx);
+    break;
+  }
+  case SymExpr::S_ConstExpr: {
+    const ConstExpr *ce = static_cast<const ConstExpr *>(e);
+    key.width = ce->getBitWidth(ctx);
+    key.value = (uint64_t)ce->getValue();
+    if (key.width < 64)
+      key.value &= ((uint64_t)1 << key.width) - 1;
+    key.flag = ce->isSigned();
+    break;
+  }
+  case SymExpr::S_ElemSymExpr: {
+    const ElemSymExpr *elem = static_cast<const ElemSymExpr *>(e);
+    key.ops[0] = elem->getBaseExpr();
+    key.ops[1] = elem->getIndexExpr();
+    break;
+  }
+  case SymExpr::S_ArithSymExpr: {
+    const ArithSymExpr *bin = static_cast<const ArithSymExpr *>(e);
+    key.op = bin->getOpcode();
+    key.ops[0] = bin->getLHS();
+    key.ops[1] = bin->getRHS();
+    break;
+  }
+  case SymExpr::S_LogicalSymExpr: {
+    const LogicalSymExpr *bin = static_cast<const LogicalSymExpr *>(e);
+    key.op = bin->getOpcode();
+    key.ops[0] = bin->getLHS();
+    key.ops[1] = bin->getRHS();
+    break;
+  }
+  case SymExpr::S_UnarySymExpr: {
+    const UnarySymExpr *un = static_cast<const UnarySymExpr *>(e);
+    key.op = un->getUnaryOpcode();
+    key.ops[0] = un->getOperand();
+    break;
+  }
+  case SymExpr::S_TruncSymExpr:
+    key.width = e->getBitWidth(ctx);
+    key.ops[0] = static_cast<const CastSymExpr *>(e)->getOperand();
+    break;
+  case SymExpr::S_ExtendSymExpr:
+    key.width = e->getBitWidth(ctx);
+    key.flag = static_cast<const ExtendSymExpr *>(e)->isSignedExt();
+    key.ops[0] = static_cast<const CastSymExpr *>(e)->getOperand();
+    break;
+  }
+  return key;
+}
+
+unsigned SymExprManager::computeHash(const NodeKey &key) {
+  unsigned h = hashCombine(0x811c9dc5u, key.kind);
+  h = hashCombine(h, key.op);
+  h = hashCombine(h, key.width);
+  h = hashCombine(h, key.nDim);
+  h = hashCombine(h, key.flag);
+  h = hashCombine(h, key.value);
+  for (unsigned i = 0; i < 2; ++i) {
+    if (key.ops[i])
+      h = hashCombine(h, key.ops[i]->getHashValue());
+  }
+  // 0 marks the nodes that are not uniqued.
+  return h ? h : 1;
+}
+
+bool SymExprManager::isEqual(const NodeKey &key, const NodeKey &other) {
+  return key.kind == other.kind && key.op == other.op &&
+    key.width == other.width && key.nDim == other.nDim &&
+    key.flag == other.flag && key.value == other.value &&
+    key.ops[0] == other.ops[0] && key.ops[1] == other.ops[1];
+}
+
+const SymExpr *SymExprManager::getOrCreate(const NodeKey &key) {
+  unsigned hash = computeHash(key);
+  unsigned mask = table.size() - 1;
+  unsigned i = hash & mask;
+  while (const SymExpr *node = table[i]) {
+    if (node->getHashValue() == hash && isEqual(key, getKey(node)))
+      return node;
+    i = (i + 1) & mask;
+  }
+
+  SymExpr *node = createNode(key);
+  node->hashValue = hash;
+  table[i] = node;
+  if (++numNodes * 4 > table.size() * 3)
+    grow();
+  return node;
+}
+
+void SymExprManager::grow() {
+  std::vector<const SymExpr *> old(table.size() * 2, (const SymExpr *)0);
+  old.swap(table);
+  unsigned mask = table.size() - 1;
+  for (unsigned j = 0; j < old.size(); ++j) {
+    if (!old[j])
+      continue;
+    unsigned i = old[j]->getHashValue() & mask;
+    while (table[i])
+      i = (i + 1) & mask;
+    table[i] = old[j];
+  }
+}
+
+SymExpr *SymExprManager::createNode(const NodeKey &key) {
+  switch (key.kind) {
+  default:
+    assert(0 && "Unprocessed SymExpr kind.");
+  case SymExpr::S_ScalarSymbol:
+    return new (allocate(sizeof(UScalarSymbol)))
+      UScalarSymbol(key.value, key.width);
+  case SymExpr::S_RegionSymbol:
+    return new (allocate(sizeof(URegionSymbol)))
+      URegionSymbol(key.value, key.width, key.nDim);
+  case SymExpr::S_ConstExpr:
+    return new (allocate(sizeof(UConstExpr)))
+      UConstExpr(key.value, key.width, key.flag);
+  case SymExpr::S_ElemSymExpr: {
+    const SymExpr *base = key.ops[0];
+    unsigned elemWidth, dims;
+    if (RegionSymbol::classof(base)) {
+      const URegionSymbol *region = static_cast<const URegionSymbol *>(base);
+      elemWidth = region->getElementTypeSizeInBits(ctx);
+      dims = region->getNumberDimension(ctx);
+    } else {
+      assert(ElemSymExpr::classof(base) && "Unknown array base.");
+      const UElemSymExpr *elem = static_cast<const UElemSymExpr *>(base);
+      elemWidth = elem->getElementWidth();
+      dims = elem->getRemainingDims();
+    }
+    assert(dims > 0 && "Too many indices for the region.");
+    return new (allocate(sizeof(UElemSymExpr)))
+      UElemSymExpr(base, key.ops[1], elemWidth, dims - 1);
+  }
+  case SymExpr::S_ArithSymExpr:
+    return new (allocate(sizeof(ArithSymExpr)))
+      ArithSymExpr(key.ops[0], key.ops[1], (ArithOpcode)key.op);
+  case SymExpr::S_LogicalSymExpr:
+    return new (allocate(sizeof(LogicalSymExpr)))
+      LogicalSymExpr(key.ops[0], key.ops[1], (LogicalOpcode)key.op);
+  case SymExpr::S_UnarySymExpr:
+    return new (allocate(sizeof(UnarySymExpr)))
+      UnarySymExpr(key.ops[0], (UnaryOpcode)key.op);
+  case SymExpr::S_TruncSymExpr:
+    return new (allocate(sizeof(UTruncSymExpr)))
+      UTruncSymExpr(key.ops[0], key.width);
+  case SymExpr::S_ExtendSymExpr:
+    return new (allocate(sizeof(UExtendSymExpr)))
+      UExtendSymExpr(key.ops[0], key.width, key.flag);
+  }
+}
+
+bool SymExprManager::isUniqued(const SymExpr *e) {
+  unsigned hash = e->getHashValue();
+  if (!hash)
+    return false;
+  unsigned mask = table.size() - 1;
+  for (unsigned i = hash & mask; table[i]; i = (i + 1) & mask) {
+    if (table[i] == e)
+      return true;
+  }
+  return false;
+}
+
+const ScalarSymbol *SymExprManager::getScalarSymbol(unsigned id,
+                                                    unsigned width) {
+  NodeKey key(SymExpr::S_ScalarSymbol);
+  key.value = id;
+  key.width = width;
+  return static_cast<const ScalarSymbol *>(getOrCreate(key));
+}
+
+const RegionSymbol *SymExprManager::getRegionSymbol(unsigned id,
+                                                    unsigned elemWidth,
+                                                    unsigned nDim) {
+  NodeKey key(SymExpr::S_RegionSymbol);
+  key.value = id;
+  key.width = elemWidth;
+  key.nDim = nDim;
+  return static_cast<const RegionSymbol *>(getOrCreate(key));
+}
+
+const ConstExpr *SymExprManager::getConst(uint64_t v, unsigned width,
+                                          bool isSigned) {
+  NodeKey key(SymExpr::S_ConstExpr);
+  key.value = width < 64 ? v & (((uint64_t)1 << width) - 1) : v;
+  key.width = width;
+  key.flag = isSigned;
+  return static_cast<const ConstExpr *>(getOrCreate(key));
+}
+
+const ElemSymExpr *SymExprManager::getElem(const SymExpr *base,
+                                           const SymExpr *index) {
+  NodeKey key(SymExpr::S_ElemSymExpr);
+  key.ops[0] = base;
+  key.ops[1] = index;
+  return static_cast<const ElemSymExpr *>(getOrCreate(key));
+}
+
+const ArithSymExpr *SymExprManager::getArith(const SymExpr *l,
+                                             const SymExpr *r,
+                                             ArithOpcode op) {
+  NodeKey key(SymExpr::S_ArithSymExpr);
+  key.op = op;
+  key.ops[0] = l;
+  key.ops[1] = r;
+  return static_cast<const ArithSymExpr *>(getOrCreate(key));
+}
+
+const LogicalSymExpr *SymExprManager::getLogical(const SymExpr *l,
+                                                 const SymExpr *r,
+                                                 LogicalOpcode op) {
+  NodeKey key(SymExpr::S_LogicalSymExpr);
+  key.op = op;
+  key.ops[0] = l;
+  key.ops[1] = r;
+  return static_cast<const LogicalSymExpr *>(getOrCreate(key));
+}
+
+const UnarySymExpr *SymExprManager::getUnary(const SymExpr *e,
+                                             UnaryOpcode op) {
+  NodeKey key(SymExpr::S_UnarySymExpr);
+  key.op = op;
+  key.ops[0] = e;
+  return static_cast<const UnarySymExpr *>(getOrCreate(key));
+}
+
+const TruncSymExpr *SymExprManager::getTrunc(const SymExpr *e,
+                                             unsigned width) {
+  NodeKey key(SymExpr::S_TruncSymExpr);
+  key.width = width;
+  key.ops[0] = e;
+  return static_cast<const TruncSymExpr *>(getOrCreate(key));
+}
+
+const ExtendSymExpr *SymExprManager::getExtend(const SymExpr *e,
+                                               unsigned width, bool sext) {
+  NodeKey key(SymExpr::S_ExtendSymExpr);
+  key.width = width;
+  key.flag = sext;
+  key.ops[0] = e;
+  return static_cast<const ExtendSymExpr *>(getOrCreate(key));
+}
+
+const SymExpr *SymExprManager::import(const SymExpr *e) {
+  if (isUniqued(e))
+    return e;
+  // Post-order walk with an explicit stack like Z3Adapter::genZ3Expr(), so
+  // that deep chains cannot overflow the native stack. A node is uniqued
+  // on its second visit, when its operands are imported.
+  std::map<const SymExpr *, const SymExpr *> imported;
+  std::vector<std::pair<const SymExpr *, bool> > work;
+  work.push_back(std::make_pair(e, false));
+  while (!work.empty()) {
+    const SymExpr *n = work.back().first;
+    if (!work.back().second) {
+      if (isUniqued(n) || imported.count(n)) {
+        work.pop_back();
+        continue;
+      }
+      work.back().second = true;
+      NodeKey key = getKey(n);
+      for (unsigned i = 2; i > 0; --i) {
+        if (key.ops[i - 1])
+          work.push_back(std::make_pair(key.ops[i - 1], false));
+      }
+      continue;
+    }
+    work.pop_back();
+    NodeKey key = getKey(n);
+    for (unsigned i = 0; i < 2; ++i) {
+      if (key.ops[i] && !isUniqued(key.ops[i]))
+        key.ops[i] = imported.find(key.ops[i])->second;
+    }
+    imported.insert(std::pair<const SymExpr *, const SymExpr *>(
+      n, getOrCreate(key)));
+  }
+  return imported.find(e)->second;
+}
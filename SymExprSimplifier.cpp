@@ -0,0 +1,430 @@
+#include "SymExprSimplifier.h"
+#include "BitVector.h"
+#include "smtadapter/SymExprVisitor.h"
+
+using namespace smt;
+
+namespace {
+
+LogicalOpcode getInverse(LogicalOpcode op) {
+  switch (op) {
+  default:
+    assert(0 && "No inverse of a logical operator.");
+  case BO_SLT: return BO_SGE;
+  case BO_ULT: return BO_UGE;
+  case BO_SGT: return BO_SLE;
+  case BO_UGT: return BO_ULE;
+  case BO_SLE: return BO_SGT;
+  case BO_ULE: return BO_UGT;
+  case BO_SGE: return BO_SLT;
+  case BO_UGE: return BO_ULT;
+  case BO_EQ: return BO_NE;
+  case BO_NE: return BO_EQ;
+  }
+}
+
+}
+
+SymExprSimplifier::SymExprSimplifier(SolverContext &c, SymExprManager &m)
+  : ctx(c), mgr(m), numRewrites(0) {
+  clear();
+}
+
+void SymExprSimplifier::clear() {
+  cache.clear();
+  const SymExpr *zero = mgr.getConst(0, 1, false);
+  trueExpr = mgr.getLogical(zero, zero, BO_EQ);
+  falseExpr = mgr.getLogical(zero, zero, BO_NE);
+}
+
+const SymExpr *SymExprSimplifier::simplify(const SymExpr *e) {
+  // Post-order walk with an explicit stack like Z3Adapter::genZ3Expr(), so
+  // that deep chains cannot overflow the native stack. A node is rewritten
+  // on its second visit, when its operands are in the cache.
+  work.clear();
+  work.push_back(std::make_pair(e, false));
+  while (!work.empty()) {
+    const SymExpr *n = work.back().first;
+    if (!work.back().second) {
+      if (cache.count(n)) {
+        work.pop_back();
+        continue;
+      }
+      work.back().second = true;
+      const SymExpr *ops[2];
+      for (unsigned i = getSymExprOperands(n, ops); i > 0; --i)
+        work.push_back(std::make_pair(ops[i - 1], false));
+      continue;
+    }
+    work.pop_back();
+    Simplified s = simplifyNode(n);
+    cache.insert(std::pair<const SymExpr *, Simplified>(n, s));
+  }
+  return lookup(e).expr;
+}
+
+const SymExprSimplifier::Simplified &
+SymExprSimplifier::lookup(const SymExpr *e) const {
+  std::map<const SymExpr *, Simplified>::const_iterator it = cache.find(e);
+  assert(it != cache.end() && "Operand simplified out of order.");
+  return it->second;
+}
+
+bool SymExprSimplifier::getConstValue(const SymExpr *e, unsigned w,
+                                      uint64_t &v) const {
+  if (e == trueExpr || e == falseExpr) {
+    v = e == trueExpr;
+    return true;
+  }
+  if (!ConstExpr::classof(e) || w > 64)
+    return false;
+  v = bv::trunc((uint64_t)static_cast<const ConstExpr *>(e)->getValue(), w);
+  return true;
+}
+
+const SymExpr *SymExprSimplifier::getConst(uint64_t v, unsigned w,
+                                           const SymExpr *like) {
+  bool sign = ConstExpr::classof(like) &&
+    static_cast<const ConstExpr *>(like)->isSigned();
+  return mgr.getConst(bv::trunc(v, w), w, sign);
+}
+
+unsigned SymExprSimplifier::getElemWidth(const ElemSymExpr *e) {
+  unsigned nIndices = 0;
+  const SymExpr *base = e;
+  while (ElemSymExpr::classof(base)) {
+    ++nIndices;
+    base = static_cast<const ElemSymExpr *>(base)->getBaseExpr();
+  }
+  assert(RegionSymbol::classof(base) && "Unknown array base.");
+  const RegionSymbol *region = static_cast<const RegionSymbol *>(base);
+  if (nIndices < region->getNumberDimension(ctx))
+    return 0;
+  return region->getElementTypeSizeInBits(ctx);
+}
+
+SymExprSimplifier::Simplified
+SymExprSimplifier::simplifyNode(const SymExpr *e) {
+  Simplified s;
+  const SymExpr *rewritten = 0;
+  switch (e->getKind()) {
+  default:
+    assert(0 && "Unprocessed SymExpr kind.");
+  case SymExpr::S_ScalarSymbol:
+  case SymExpr::S_ConstExpr:
+    s.expr = mgr.import(e);
+    s.width = e->getBitWidth(ctx);
+    break;
+  case SymExpr::S_RegionSymbol:
+    s.expr = mgr.import(e);
+    s.width = 0;
+    break;
+  case SymExpr::S_ElemSymExpr: {
+    const ElemSymExpr *elem = static_cast<const ElemSymExpr *>(e);
+    const SymExpr *base = lookup(elem->getBaseExpr()).expr;
+    const SymExpr *index = lookup(elem->getIndexExpr()).expr;
+    s.expr = mgr.getElem(base, index);
+    s.width = getElemWidth(elem);
+    break;
+  }
+  case SymExpr::S_ArithSymExpr: {
+    const ArithSymExpr *bin = static_cast<const ArithSymExpr *>(e);
+    const Simplified &l = lookup(bin->getLHS());
+    const SymExpr *r = lookup(bin->getRHS()).expr;
+    s.width = l.width;
+    rewritten = simplifyArith(bin, l.expr, r, s.width);
+    if (!rewritten)
+      s.expr = mgr.getArith(l.expr, r, bin->getOpcode());
+    break;
+  }
+  case SymExpr::S_LogicalSymExpr: {
+    const LogicalSymExpr *bin = static_cast<const LogicalSymExpr *>(e);
+    const Simplified &l = lookup(bin->getLHS());
+    const SymExpr *r = lookup(bin->getRHS()).expr;
+    s.width = 1;
+    rewritten = simplifyLogical(bin, l.expr, r, l.width);
+    if (!rewritten)
+      s.expr = mgr.getLogical(l.expr, r, bin->getOpcode());
+    break;
+  }
+  case SymExpr::S_UnarySymExpr: {
+    const UnarySymExpr *un = static_cast<const UnarySymExpr *>(e);
+    const Simplified &op = lookup(un->getOperand());
+    s.width = op.width;
+    rewritten = simplifyUnary(un, op.expr, op.width);
+    if (!rewritten)
+      s.expr = mgr.getUnary(op.expr, un->getUnaryOpcode());
+    break;
+  }
+  case SymExpr::S_TruncSymExpr: {
+    const TruncSymExpr *ce = static_cast<const TruncSymExpr *>(e);
+    const Simplified &op = lookup(ce->getOperand());
+    s.width = ce->getBitWidth(ctx);
+    rewritten = simplifyTrunc(op.expr, op.width, s.width);
+    if (!rewritten)
+      s.expr = mgr.getTrunc(op.expr, s.width);
+    break;
+  }
+  case SymExpr::S_ExtendSymExpr: {
+    const ExtendSymExpr *ce = static_cast<const ExtendSymExpr *>(e);
+    const Simplified &op = lookup(ce->getOperand());
+    s.width = ce->getBitWidth(ctx);
+    rewritten = simplifyExtend(ce, op.expr, op.width, s.width);
+    if (!rewritten)
+      s.expr = mgr.getExtend(op.expr, s.width, ce->isSignedExt());
+    break;
+  }
+  }
+
+  if (rewritten) {
+    ++numRewrites;
+    s.expr = rewritten;
+  }
+  return s;
+}
+
+const SymExpr *SymExprSimplifier::simplifyArith(const ArithSymExpr *e,
+                                                const SymExpr *l,
+                                                const SymExpr *r,
+                                                unsigned w) {
+  uint64_t a = 0, b = 0;
+  bool lc = getConstValue(l, w, a);
+  bool rc = getConstValue(r, w, b);
+  if (lc && rc)
+    return getConst(bv::evalArith(e->getOpcode(), a, b, w), w, l);
+
+  switch (e->getOpcode()) {
+  default:
+    break;
+  case BO_Add:
+    if (rc && b == 0)
+      return l;
+    if (lc && a == 0)
+      return r;
+    break;
+  case BO_Sub:
+    if (rc && b == 0)
+      return l;
+    if (l == r)
+      return mgr.getConst(0, w, false);
+    break;
+  case BO_Mul:
+    if ((rc && b == 0) || (lc && a == 0))
+      return mgr.getConst(0, w, false);
+    if (rc && b == 1)
+      return l;
+    if (lc && a == 1)
+      return r;
+    break;
+  case BO_UDiv:
+  case BO_SDiv:
+    if (rc && b == 1)
+      return l;
+    break;
+  case BO_URem:
+  case BO_SRem:
+    if (rc && b == 1)
+      return mgr.getConst(0, w, false);
+    break;
+  case BO_Shl:
+  case BO_Shr:
+    if (rc && b == 0)
+      return l;
+    if ((lc && a == 0) || (rc && b >= w))
+      return mgr.getConst(0, w, false);
+    break;
+  case BO_And:
+    if ((rc && b == 0) || (lc && a == 0))
+      return mgr.getConst(0, w, false);
+    if (rc && b == bv::mask(w))
+      return l;
+    if (lc && a == bv::mask(w))
+      return r;
+    if (l == r)
+      return l;
+    break;
+  case BO_Or:
+    if (rc && b == 0)
+      return l;
+    if (lc && a == 0)
+      return r;
+    if (rc && b == bv::mask(w))
+      return r;
+    if (lc && a == bv::mask(w))
+      return l;
+    if (l == r)
+      return l;
+    break;
+  case BO_Xor:
+    if (rc && b == 0)
+      return l;
+    if (lc && a == 0)
+      return r;
+    if (l == r)
+      return mgr.getConst(0, w, false);
+    break;
+  }
+  return 0;
+}
+
+const SymExpr *SymExprSimplifier::simplifyLogical(const LogicalSymExpr *e,
+                                                  const SymExpr *l,
+                                                  const SymExpr *r,
+                                                  unsigned w) {
+  LogicalOpcode op = e->getOpcode();
+  if (op == BO_LAnd) {
+    if (isFalse(l) || isFalse(r))
+      return falseExpr;
+    if (isTrue(l))
+      return r;
+    if (isTrue(r) || l == r)
+      return l;
+    return 0;
+  }
+  if (op == BO_LOr) {
+    if (isTrue(l) || isTrue(r))
+      return trueExpr;
+    if (isFalse(l))
+      return r;
+    if (isFalse(r) || l == r)
+      return l;
+    return 0;
+  }
+
+  uint64_t a = 0, b = 0;
+  bool lc = getConstValue(l, w, a);
+  bool rc = getConstValue(r, w, b);
+  if (lc && rc)
+    return getBool(bv::evalLogical(op, a, b, w));
+
+  if (l == r) {
+    switch (op) {
+    default:
+      return falseExpr;
+    case BO_EQ: case BO_ULE: case BO_SLE: case BO_UGE: case BO_SGE:
+      return trueExpr;
+    }
+  }
+
+  // (b == true) is b, (b == false) is !b.
+  if ((op == BO_EQ || op == BO_NE) && isBoolSymExpr(l) && (lc || rc)) {
+    const SymExpr *other = lc ? r : l;
+    bool value = lc ? a : b;
+    if (value == (op == BO_EQ))
+      return other;
+    const SymExpr *neg = mgr.getUnary(other, UO_LNot);
+    const SymExpr *simplified = simplifyUnary(
+      static_cast<const UnarySymExpr *>(neg), other, 1);
+    return simplified ? simplified : neg;
+  }
+
+  switch (op) {
+  default:
+    break;
+  case BO_ULT:
+    if ((rc && b == 0) || (lc && a == bv::mask(w)))
+      return falseExpr;
+    break;
+  case BO_UGE:
+    if ((rc && b == 0) || (lc && a == bv::mask(w)))
+      return trueExpr;
+    break;
+  case BO_ULE:
+    if ((lc && a == 0) || (rc && b == bv::mask(w)))
+      return trueExpr;
+    break;
+  case BO_UGT:
+    if ((lc && a == 0) || (rc && b == bv::mask(w)))
+      return falseExpr;
+    break;
+  }
+  return 0;
+}
+
+const SymExpr *SymExprSimplifier::simplifyUnary(const UnarySymExpr *e,
+                                                const SymExpr *op,
+                                                unsigned w) {
+  UnaryOpcode uo = e->getUnaryOpcode();
+  if (uo == UO_LNot) {
+    if (isTrue(op))
+      return falseExpr;
+    if (isFalse(op))
+      return trueExpr;
+    if (UnarySymExpr::classof(op) &&
+        static_cast<const UnarySymExpr *>(op)->getUnaryOpcode() == UO_LNot)
+      return static_cast<const UnarySymExpr *>(op)->getOperand();
+    // !(a < b) is a >= b.
+    if (LogicalSymExpr::classof(op)) {
+      const LogicalSymExpr *cmp = static_cast<const LogicalSymExpr *>(op);
+      if (cmp->getOpcode() != BO_LAnd && cmp->getOpcode() != BO_LOr)
+        return mgr.getLogical(cmp->getLHS(), cmp->getRHS(),
+                              getInverse(cmp->getOpcode()));
+    }
+    return 0;
+  }
+
+  uint64_t a = 0;
+  if (getConstValue(op, w, a))
+    return getConst(bv::evalUnary(uo, a, w), w, op);
+  // -(-x) and ~(~x) are x.
+  if (UnarySymExpr::classof(op) &&
+      static_cast<const UnarySymExpr *>(op)->getUnaryOpcode() == uo)
+    return static_cast<const UnarySymExpr *>(op)->getOperand();
+  return 0;
+}
+
+const SymExpr *SymExprSimplifier::simplifyTrunc(const SymExpr *op,
+                                                unsigned opWidth,
+                                                unsigned w) {
+  if (w == opWidth)
+    return op;
+  uint64_t a = 0;
+  if (getConstValue(op, opWidth, a))
+    return getConst(a, w, op);
+
+  // trunc(ext(x)) is x, ext(x) or trunc(x) depending on the widths.
+  if (ExtendSymExpr::classof(op)) {
+    const ExtendSymExpr *ext = static_cast<const ExtendSymExpr *>(op);
+    const SymExpr *x = ext->getOperand();
+    if (isBoolSymExpr(x))
+      return 0;
+    unsigned xw = x->getBitWidth(ctx);
+    if (xw == w)
+      return x;
+    if (xw < w)
+      return mgr.getExtend(x, w, ext->isSignedExt());
+    return mgr.getTrunc(x, w);
+  }
+  if (TruncSymExpr::classof(op))
+    return mgr.getTrunc(static_cast<const TruncSymExpr *>(op)->getOperand(),
+                        w);
+  return 0;
+}
+
+const SymExpr *SymExprSimplifier::simplifyExtend(const ExtendSymExpr *e,
+                                                 const SymExpr *op,
+                                                 unsigned opWidth,
+                                                 unsigned w) {
+  // A Boolean extends to 0 or 1.
+  if (isBoolSymExpr(op)) {
+    if (isTrue(op) || isFalse(op))
+      return mgr.getConst(isTrue(op), w, false);
+    return 0;
+  }
+  uint64_t a = 0;
+  if (getConstValue(op, opWidth, a) && w <= 64) {
+    uint64_t v = e->isSignedExt() ? bv::sext(a, opWidth, w)
+                                  : bv::zext(a, opWidth, w);
+    return getConst(v, w, op);
+  }
+
+  // ext(ext(x)) is one extension. The top bit of a zext is 0, so a sext
+  // of it is a zext too.
+  if (ExtendSymExpr::classof(op)) {
+    const ExtendSymExpr *ext = static_cast<const ExtendSymExpr *>(op);
+    if (!isBoolSymExpr(ext->getOperand()) &&
+        (ext->isSignedExt() == e->isSignedExt() || !ext->isSignedExt()))
+      return mgr.getExtend(ext->getOperand(), w, ext->isSignedExt());
+  }
+  return 0;
+}
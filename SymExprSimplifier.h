@@ -0,0 +1,71 @@
+#ifndef SMTADAPTER_SYMEXPR_SIMPLIFIER_H	// -*- C++ -*-
+#define SMTADAPTER_SYMEXPR_SIMPLIFIER_H
+#include "smtadapter/SymExprManager.h"
+#include <map>
+#include <vector>
+
+namespace smt {
+
+// Rewrite SymExpr DAGs with width-correct bitvector constant folding and
+// algebraic identities such as x + 0, x & 0, trunc(zext(x)) and x == x.
+// The results are built in a SymExprManager, and Booleans that fold to a
+// constant become the manager nodes returned by getTrue() and getFalse(),
+// so deciding a constraint is a pointer comparison.
+//
+// Results are memoized by the address of the input node until clear().
+class SymExprSimplifier {
+public:
+  SymExprSimplifier(SolverContext &c, SymExprManager &m);
+
+  const SymExpr *simplify(const SymExpr *e);
+
+  // (0 == 0) and (0 != 0) over 1 bit constants.
+  const SymExpr *getTrue() const { return trueExpr; }
+  const SymExpr *getFalse() const { return falseExpr; }
+  bool isTrue(const SymExpr *e) const { return e == trueExpr; }
+  bool isFalse(const SymExpr *e) const { return e == falseExpr; }
+
+  void clear();
+
+  // The number of nodes that were rewritten to something simpler.
+  unsigned getNumRewrites() const { return numRewrites; }
+
+private:
+  struct Simplified {
+    const SymExpr *expr;
+    // The bit width, 1 for Booleans and 0 for arrays.
+    unsigned width;
+  };
+
+  // Rewrite one node whose operands are in the cache.
+  Simplified simplifyNode(const SymExpr *e);
+  const Simplified &lookup(const SymExpr *e) const;
+  const SymExpr *simplifyArith(const ArithSymExpr *e, const SymExpr *l,
+                               const SymExpr *r, unsigned w);
+  const SymExpr *simplifyLogical(const LogicalSymExpr *e, const SymExpr *l,
+                                 const SymExpr *r, unsigned w);
+  const SymExpr *simplifyUnary(const UnarySymExpr *e, const SymExpr *op,
+                               unsigned w);
+  const SymExpr *simplifyTrunc(const SymExpr *op, unsigned opWidth,
+                               unsigned w);
+  const SymExpr *simplifyExtend(const ExtendSymExpr *e, const SymExpr *op,
+                                unsigned opWidth, unsigned w);
+  const SymExpr *getBool(bool b) const { return b ? trueExpr : falseExpr; }
+  bool getConstValue(const SymExpr *e, unsigned w, uint64_t &v) const;
+  const SymExpr *getConst(uint64_t v, unsigned w, const SymExpr *like);
+  unsigned getElemWidth(const ElemSymExpr *e);
+
+private:
+  SolverContext &ctx;
+  SymExprManager &mgr;
+  const SymExpr *trueExpr;
+  const SymExpr *falseExpr;
+  std::map<const SymExpr *, Simplified> cache;
+  // The stack of simplify(), kept to reuse its storage.
+  std::vector<std::pair<const SymExpr *, bool> > work;
+  unsigned numRewrites;
+};
+
+}
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef SMTADAPTER_TIMER_H	// -*- C++ -*-
+#define SMTADAPTER_TIMER_H
+#include <chrono>
+
+namespace smt {
+
+// Wall clock time since construction or the last restart().
+class Timer {
+  std::chrono::steady_clock::time_point start;
+
+public:
+  Timer() : start(std::chrono::steady_clock::now()) {}
+
+  void restart() { start = std::chrono::steady_clock::now(); }
+  double getMicroseconds() const {
+    return std::chrono::duration<double, std::micro>(
+      std::chrono::steady_clock::now() - start).count();
+  }
+};
+
+}
+
+#endif
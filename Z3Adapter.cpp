@@ -1,27 +1,272 @@
 #include "smtadapter/SolverContext.h"
 #include "Z3Adapter.h"
+#include "Timer.h"
+#include "smtadapter/SolverStats.h"
+#include "smtadapter/SymExprVisitor.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
 #include <cstdlib>
 #include <string>
 #include <sstream>
+#include <unistd.h>
 
 using namespace smt;
 
+namespace {
+
+// Numbers the dumped queries of all adapters in the process.
+std::atomic<unsigned> numDumpedQueries(0);
+
+const char *getResultName(SolverResult r) {
+  switch (r) {
+  case SAT_Satisfiable: return "sat";
+  case SAT_Unsatisfiable: return "unsat";
+  case SAT_Timeout: return "timeout";
+  default: return "unknown";
+  }
+}
+
+}
+
 Z3Adapter::Z3Adapter(SolverContext &sc)
-: SolverAdapter(sc), timeout(5000), c(), s(c) {
-  z3::params p(c);
-  p.set(":timeout", timeout);
-  s.set(p);
+: SolverAdapter(sc), timeout(5000), seed(0), c(new z3::context()), s(*c),
+  numScopes(0), exprCacheHits(0), exprCacheMisses(0), exprsByScope(1),
+  litsByScope(1), numAssumptionLits(0), checkedNodes(0), translateTime(0),
+  maxChecks(0), maxMemory(0), numChecks(0), baseMemory(-1), lastMemory(0),
+  numRecycles(0), solving(false) {
+  setUpSolver();
 }
 
 Z3Adapter::Z3Adapter(SolverContext &sc, unsigned t)
-: SolverAdapter(sc), timeout(t), c(), s(c) {
-  z3::params p(c);
+: SolverAdapter(sc), timeout(t), seed(0), c(new z3::context()), s(*c),
+  numScopes(0), exprCacheHits(0), exprCacheMisses(0), exprsByScope(1),
+  litsByScope(1), numAssumptionLits(0), checkedNodes(0), translateTime(0),
+  maxChecks(0), maxMemory(0), numChecks(0), baseMemory(-1), lastMemory(0),
+  numRecycles(0), solving(false) {
+  setUpSolver();
+}
+
+Z3Adapter::Z3Adapter(SolverContext &sc, const Z3Config &cfg)
+: SolverAdapter(sc), timeout(cfg.timeout), seed(cfg.seed),
+  c(new z3::context()), s(*c), numScopes(0), exprCacheHits(0),
+  exprCacheMisses(0), exprsByScope(1), litsByScope(1), numAssumptionLits(0),
+  checkedNodes(0), translateTime(0), logic(cfg.logic ? cfg.logic : ""),
+  tactic(cfg.tactic ? cfg.tactic : ""),
+  dumpDir(cfg.dumpDir ? cfg.dumpDir : ""), maxChecks(cfg.maxChecks),
+  maxMemory(cfg.maxMemory), numChecks(0), baseMemory(-1), lastMemory(0),
+  numRecycles(0), solving(false) {
+  setUpSolver();
+}
+
+void Z3Adapter::setUpSolver() {
+  if (!tactic.empty())
+    s = z3::tactic(*c, tactic.c_str()).mk_solver();
+  else if (!logic.empty())
+    s = z3::solver(*c, logic.c_str());
+  else
+    s = z3::solver(*c);
+  z3::params p(*c);
   p.set(":timeout", timeout);
+  p.set(":random_seed", seed);
   s.set(p);
 }
 
+void Z3Adapter::recycle() {
+  // Everything that refers to the old context must go before it.
+  std::unique_ptr<z3::context> old;
+  {
+    std::lock_guard<std::mutex> guard(contextLock);
+    old = std::move(c);
+    c.reset(new z3::context());
+  }
+  lastModel.reset();
+  setUpSolver();
+  decls.clear();
+  exprCache.clear();
+  assumptionLits.clear();
+  litsByScope.assign(1, std::vector<const SymExpr *>());
+  exprsByScope.assign(1, std::vector<const SymExpr *>());
+  lastAssumptions.clear();
+  lastAssumptionLits.clear();
+  old.reset();
+  numChecks = 0;
+  baseMemory = -1;
+  lastMemory = 0;
+  ++numRecycles;
+
+  // The assumption literals come back as they are used.
+  unsigned scope = 0;
+  for (unsigned i = 0; i < asserted.size(); ++i) {
+    for (; scope < scopeMarks.size() && scopeMarks[scope] == i; ++scope) {
+      s.push();
+      litsByScope.push_back(std::vector<const SymExpr *>());
+      exprsByScope.push_back(std::vector<const SymExpr *>());
+    }
+    s.add(getConstraintExpr(asserted[i]));
+  }
+  for (; scope < scopeMarks.size(); ++scope) {
+    s.push();
+    litsByScope.push_back(std::vector<const SymExpr *>());
+    exprsByScope.push_back(std::vector<const SymExpr *>());
+  }
+}
+
+void Z3Adapter::checkLimits() {
+  // The memory is the one of the whole process, see Z3Config::maxMemory.
+  if ((maxChecks && numChecks >= maxChecks) ||
+      (maxMemory && baseMemory >= 0 && lastMemory - baseMemory >= maxMemory))
+    recycle();
+}
+
+void Z3Adapter::beginCheck() {
+  std::lock_guard<std::mutex> guard(contextLock);
+  epoch.begin();
+  // Left set if Z3 threw.
+  solving = false;
+}
+
+SolverResult Z3Adapter::solve(const z3::expr_vector &lits) {
+  {
+    std::lock_guard<std::mutex> guard(contextLock);
+    if (epoch.isInterrupted())
+      return SAT_Undetermined;
+    solving = true;
+  }
+  z3::check_result result = lits.size() ? s.check(lits) : s.check();
+  {
+    std::lock_guard<std::mutex> guard(contextLock);
+    solving = false;
+  }
+  return getSolverResult(result);
+}
+
 SolverResult Z3Adapter::checkSat() {
-  int result = s.check();
+  beginCheck();
+  checkLimits();
+  z3::expr_vector lits(*c);
+  if (!dumpDir.empty())
+    dumpQuery(lits);
+  Timer timer;
+  SolverResult result = solve(lits);
+  return finishCheck(result, timer.getMicroseconds());
+}
+
+SolverResult
+Z3Adapter::checkSatAssuming(const std::vector<SymConstraint> &assumptions) {
+  beginCheck();
+  checkLimits();
+  lastAssumptions = assumptions;
+  lastAssumptionLits.clear();
+  z3::expr_vector lits(*c);
+  Timer timer;
+  for (unsigned i = 0; i < assumptions.size(); ++i) {
+    z3::expr lit = getAssumptionLiteral(assumptions[i]);
+    lastAssumptionLits.push_back(lit);
+    lits.push_back(lit);
+  }
+  translateTime += timer.getMicroseconds();
+  if (!dumpDir.empty())
+    dumpQuery(lits);
+  timer.restart();
+  SolverResult result = solve(lits);
+  return finishCheck(result, timer.getMicroseconds());
+}
+
+SolverResult Z3Adapter::finishCheck(SolverResult r, double solveTime) {
+  lastModel.reset();
+  QueryStats qs;
+  qs.result = r;
+  qs.numNodes = exprCacheMisses - checkedNodes;
+  qs.translateTime = translateTime;
+  qs.solveTime = solveTime;
+  qs.numDecls = decls.size();
+  if (collectBackendStats || maxMemory) {
+    z3::stats st = s.statistics();
+    for (unsigned i = 0; i < st.size(); ++i) {
+      double v = st.is_uint(i) ? (double)st.uint_value(i)
+                               : st.double_value(i);
+      if (collectBackendStats)
+        qs.backendStats.push_back(std::make_pair(st.key(i), v));
+      if (st.key(i) == "memory") {
+        lastMemory = v;
+        if (baseMemory < 0)
+          baseMemory = v;
+      }
+    }
+  }
+  ++numChecks;
+  checkedNodes = exprCacheMisses;
+  translateTime = 0;
+  recordQuery(qs);
+
+  if (!dumpPath.empty()) {
+    if (FILE *f = fopen(dumpPath.c_str(), "a")) {
+      fprintf(f, "; result: %s\n; solve-time-us: %.0f\n",
+              getResultName(qs.result), solveTime);
+      fclose(f);
+    }
+    dumpPath.clear();
+  }
+  return qs.result;
+}
+
+void Z3Adapter::dumpQuery(const z3::expr_vector &lits) {
+  // The assumptions become assertions of the dumped query.
+  z3::expr_vector assertions = s.assertions();
+  std::vector<Z3_ast> formulas;
+  for (unsigned i = 0; i < assertions.size(); ++i)
+    formulas.push_back(assertions[i]);
+  for (unsigned i = 0; i < lits.size(); ++i)
+    formulas.push_back(lits[i]);
+  const char *text = Z3_benchmark_to_smtlib_string(
+    *c, "smtadapter", logic.c_str(), "unknown", "", formulas.size(),
+    formulas.empty() ? 0 : &formulas[0], c->bool_val(true));
+
+  std::stringstream ss;
+  ss << dumpDir << "/query-" << getpid() << "-" << numDumpedQueries++
+     << ".smt2";
+  FILE *f = fopen(ss.str().c_str(), "w");
+  if (!f)
+    return;
+  fprintf(f, "; timeout-ms: %u\n; assumptions: %u\n%s", timeout,
+          lits.size(), text);
+  fclose(f);
+  dumpPath = ss.str();
+}
+
+void Z3Adapter::getFailedAssumptions(std::vector<SymConstraint> &failed) {
+  failed.clear();
+  z3::expr_vector core = s.unsat_core();
+  for (unsigned i = 0; i < core.size(); ++i) {
+    Z3_ast lit = core[i];
+    for (unsigned j = 0; j < lastAssumptionLits.size(); ++j) {
+      if (lit == (Z3_ast)lastAssumptionLits[j]) {
+        failed.push_back(lastAssumptions[j]);
+        break;
+      }
+    }
+  }
+}
+
+z3::expr Z3Adapter::getAssumptionLiteral(const SymConstraint &sc) {
+  std::map<const SymExpr *, z3::expr>::iterator it =
+    assumptionLits.find(sc.cond);
+  if (it == assumptionLits.end()) {
+    std::stringstream ss;
+    ss << "!assume" << numAssumptionLits++;
+    z3::expr lit = c->bool_const(ss.str().c_str());
+    s.add(lit == genZ3Expr(sc.cond));
+    it = assumptionLits.insert(
+      std::pair<const SymExpr *, z3::expr>(sc.cond, lit)).first;
+    litsByScope.back().push_back(sc.cond);
+  }
+  if (sc.assumption)
+    return it->second;
+  return !it->second;
+}
+
+SolverResult Z3Adapter::getSolverResult(z3::check_result result) {
   if(result == z3::unsat)
     return SAT_Unsatisfiable;
   if(result == z3::sat)
@@ -38,76 +283,339 @@ SolverResult Z3Adapter::checkSat() {
 }
 
 void Z3Adapter::reset() {
+  lastModel.reset();
   s.reset();
+  numScopes = 0;
+  asserted.clear();
+  scopeMarks.clear();
+  assumptionLits.clear();
+  litsByScope.assign(1, std::vector<const SymExpr *>());
+  exprsByScope.assign(1, std::vector<const SymExpr *>());
+  lastAssumptions.clear();
+  lastAssumptionLits.clear();
   decls.clear();
+  exprCache.clear();
+}
+
+void Z3Adapter::interruptCheck(unsigned e) {
+  // Z3 drops an interrupt that arrives outside of a check, so one for a
+  // check that has not reached Z3 yet keeps it from starting. Z3 may also
+  // drop one that arrives while it sets up the check; callers that must
+  // not wait for the timeout send it again until the check returns.
+  std::lock_guard<std::mutex> guard(contextLock);
+  if (epoch.interrupt(e) && solving)
+    c->interrupt();
+}
+
+void Z3Adapter::push() {
+  scopeMarks.push_back(asserted.size());
+  s.push();
+  ++numScopes;
+  litsByScope.push_back(std::vector<const SymExpr *>());
+  exprsByScope.push_back(std::vector<const SymExpr *>());
+}
+
+void Z3Adapter::pop(unsigned n) {
+  assert(n <= numScopes && "Cannot pop more scopes than pushed.");
+  s.pop(n);
+  numScopes -= n;
+  if (n > 0) {
+    asserted.erase(asserted.begin() + scopeMarks[scopeMarks.size() - n],
+                   asserted.end());
+    scopeMarks.resize(scopeMarks.size() - n);
+  }
+  // The (p == cond) definitions of the popped scopes are gone.
+  while (litsByScope.size() > numScopes + 1) {
+    std::vector<const SymExpr *> &conds = litsByScope.back();
+    for (unsigned i = 0; i < conds.size(); ++i)
+      assumptionLits.erase(conds[i]);
+    litsByScope.pop_back();
+  }
+  // So are the nodes translated in them, whose storage the client may reuse.
+  while (exprsByScope.size() > numScopes + 1) {
+    std::vector<const SymExpr *> &exprs = exprsByScope.back();
+    for (unsigned i = 0; i < exprs.size(); ++i)
+      exprCache.erase(exprs[i]);
+    exprsByScope.pop_back();
+  }
+  lastAssumptions.clear();
+  lastAssumptionLits.clear();
 }
 
 void Z3Adapter::printModel() {
-  z3::model m = s.get_model();
-  std::ostringstream oss;
-  oss << m;
-  std::cout << oss.str() << "\n";
+  std::cout << getLastModel() << "\n";
+}
+
+const z3::model &Z3Adapter::getLastModel() {
+  if (!lastModel)
+    lastModel.reset(new z3::model(s.get_model()));
+  return *lastModel;
+}
+
+bool Z3Adapter::evalScalar(const Symbol *sym, z3::expr &val) {
+  z3::expr *decl = decls.lookup(sym->getSymbolID());
+  if (!decl || decl->is_array())
+    return false;
+  const z3::model &m = getLastModel();
+  if (!Z3_model_has_interp(*c, m, decl->decl()))
+    return false;
+  val = m.eval(*decl, true);
+  return true;
+}
+
+void Z3Adapter::getZ3Bytes(const z3::expr &val, unsigned width,
+                           uint8_t *out) {
+  // 64 bits at a time; Z3 only hands out numerals up to 64 bits.
+  for (unsigned lo = 0; lo < width; lo += 64) {
+    unsigned hi = std::min(lo + 63, width - 1);
+    uint64_t v = 0;
+    z3::expr chunk = val;
+    if (lo != 0 || hi != width - 1)
+      chunk = z3::expr(*c, Z3_mk_extract(*c, hi, lo, val)).simplify();
+    if (!Z3_get_numeral_uint64(*c, chunk, &v))
+      assert(0 && "Model value is not a numeral.");
+    for (unsigned k = lo / 8; k < (hi + 8) / 8; ++k)
+      out[k] = (uint8_t)(v >> (8 * k - lo));
+  }
+}
+
+bool Z3Adapter::getValue(const Symbol *sym, uint64_t &v) {
+  z3::expr val(*c);
+  if (!evalScalar(sym, val))
+    return false;
+  v = getZ3Numeral(val);
+  return true;
+}
+
+bool Z3Adapter::getValue(const Symbol *sym, std::vector<uint8_t> &bytes) {
+  z3::expr val(*c);
+  if (!evalScalar(sym, val))
+    return false;
+  unsigned width = val.get_sort().bv_size();
+  bytes.assign((width + 7) / 8, 0);
+  getZ3Bytes(val, width, &bytes[0]);
+  return true;
+}
+
+bool Z3Adapter::getValue(const RegionSymbol *region, ArrayValue &av) {
+  av = ArrayValue();
+  z3::expr *decl = decls.lookup(region->getSymbolID());
+  if (!decl || !decl->is_array())
+    return false;
+  const z3::model &m = getLastModel();
+  if (!Z3_model_has_interp(*c, m, decl->decl()))
+    return false;
+  ArrayValue::Index prefix;
+  extractArrayValue(m, m.eval(*decl, true), prefix, av);
+  return true;
+}
+
+void Z3Adapter::extractModel(const std::vector<const Symbol *> &syms,
+                             FlatModel &fm) {
+  fm.clear();
+  fm.entries.resize(syms.size());
+  unsigned size = 0;
+  for (unsigned i = 0; i < syms.size(); ++i) {
+    FlatModel::Entry &entry = fm.entries[i];
+    entry.id = syms[i]->getSymbolID();
+    entry.width = syms[i]->getBitWidth(ctx);
+    entry.offset = size;
+    entry.valid = false;
+    size += fm.getNumBytes(i);
+  }
+  fm.data.assign(size, 0);
+  z3::expr val(*c);
+  for (unsigned i = 0; i < syms.size(); ++i) {
+    FlatModel::Entry &entry = fm.entries[i];
+    if (!evalScalar(syms[i], val))
+      continue;
+    entry.valid = true;
+    getZ3Bytes(val, entry.width, &fm.data[entry.offset]);
+  }
+}
+
+void Z3Adapter::getModel(SymModel &sm) {
+  sm.clear();
+  const z3::model &m = getLastModel();
+  for (DeclTable<z3::expr>::const_iterator it = decls.begin(),
+         ie = decls.end(); it != ie; ++it) {
+    // Skip the symbols that are not in the current assertions.
+    if (!Z3_model_has_interp(*c, m, it->second.decl()))
+      continue;
+    z3::expr val = m.eval(it->second, true);
+    if (it->second.is_array()) {
+      ArrayValue::Index prefix;
+      extractArrayValue(m, val, prefix, sm.getOrCreateArray(it->first));
+    } else {
+      sm.setScalar(it->first, getZ3Numeral(val));
+    }
+  }
+}
+
+uint64_t Z3Adapter::getZ3Numeral(const z3::expr &e) {
+  z3::expr val = e;
+  if (val.is_bv() && val.get_sort().bv_size() > 64)
+    val = z3::expr(*c, Z3_mk_extract(*c, 63, 0, val)).simplify();
+  uint64_t v = 0;
+  if (!Z3_get_numeral_uint64(*c, val, &v))
+    assert(0 && "Model value is not a numeral.");
+  return v;
+}
+
+// Flatten an array value of the model. Stores are visited from the most
+// recent one, so an index that is already set is shadowed.
+void Z3Adapter::extractArrayValue(const z3::model &m, const z3::expr &val,
+                                  ArrayValue::Index &prefix,
+                                  ArrayValue &av) {
+  if (!val.is_app())
+    return;
+  switch (val.decl().decl_kind()) {
+  default:
+    // Lambdas and other symbolic values leave the elements unspecified.
+    return;
+  case Z3_OP_CONST_ARRAY: {
+    // A constant array of arrays repeats its element under every index of
+    // this dimension, which the flat layout cannot express. Only keep the
+    // innermost default.
+    z3::expr elem = val.arg(0);
+    while (elem.is_array() && elem.is_app()) {
+      Z3_decl_kind k = elem.decl().decl_kind();
+      if (k != Z3_OP_CONST_ARRAY && k != Z3_OP_STORE)
+        return;
+      elem = elem.arg(0);
+    }
+    if (!elem.is_array() && !av.hasValue(prefix))
+      av.setValue(prefix, getZ3Numeral(elem));
+    return;
+  }
+  case Z3_OP_STORE:
+    extractElemValue(m, getZ3Numeral(val.arg(1)), val.arg(2), prefix, av);
+    extractArrayValue(m, val.arg(0), prefix, av);
+    return;
+  case Z3_OP_AS_ARRAY: {
+    z3::func_decl f(*c, Z3_get_as_array_func_decl(*c, val));
+    z3::func_interp fi = m.get_func_interp(f);
+    for (unsigned i = 0; i < fi.num_entries(); ++i) {
+      z3::func_entry entry = fi.entry(i);
+      extractElemValue(m, getZ3Numeral(entry.arg(0)), entry.value(), prefix,
+                       av);
+    }
+    z3::expr elem = fi.else_value();
+    if (elem.is_array())
+      extractArrayValue(m, elem, prefix, av);
+    else if (!av.hasValue(prefix))
+      av.setValue(prefix, getZ3Numeral(elem));
+    return;
+  }
+  }
+}
+
+void Z3Adapter::extractElemValue(const z3::model &m, uint64_t index,
+                                 const z3::expr &elem,
+                                 ArrayValue::Index &prefix, ArrayValue &av) {
+  prefix.push_back(index);
+  if (elem.is_array()) {
+    if (!av.hasValueUnder(prefix))
+      extractArrayValue(m, elem, prefix, av);
+  } else if (!av.hasValue(prefix)) {
+    av.setValue(prefix, getZ3Numeral(elem));
+  }
+  prefix.pop_back();
 }
 
 void Z3Adapter::assertSymConstraint(const SymConstraint &sc) {
+  asserted.push_back(sc);
+  Timer timer;
+  z3::expr cond = getConstraintExpr(sc);
+  translateTime += timer.getMicroseconds();
+  s.add(cond);
+}
+
+z3::expr Z3Adapter::getConstraintExpr(const SymConstraint &sc) {
   z3::expr cond = genZ3Expr(sc.cond);
   if(sc.assumption)
-    s.add(cond);
-  else s.add(!cond);
+    return cond;
+  return !cond;
 }
 
 z3::expr Z3Adapter::genZ3Expr(const SymExpr *cond) {
-  switch (cond->getKind()) {
-  default: {
-    assert(0 && "Unprocessed z3 expr.");
-    exit(1);
+  // Post-order walk with explicit stacks, so that deep chains cannot
+  // overflow the native stack. A node is expanded on its first visit and
+  // built on its second, from the translated operands on top of results.
+  work.clear();
+  results.clear();
+  work.push_back(std::make_pair(cond, false));
+  while (!work.empty()) {
+    const SymExpr *e = work.back().first;
+    const SymExpr *ops[2];
+    if (!work.back().second) {
+      std::map<const SymExpr *, z3::expr>::iterator it = exprCache.find(e);
+      if (it != exprCache.end()) {
+        ++exprCacheHits;
+        results.push_back(it->second);
+        work.pop_back();
+        continue;
+      }
+      ++exprCacheMisses;
+      work.back().second = true;
+      // Reversed, so that the first operand is translated first.
+      for (unsigned n = getSymExprOperands(e, ops); n > 0; --n)
+        work.push_back(std::make_pair(ops[n - 1], false));
+      continue;
+    }
+    work.pop_back();
+    std::vector<z3::expr>::iterator first =
+      results.end() - getSymExprOperands(e, ops);
+    z3::expr r = translateSymExpr(e, first == results.end() ? 0 : &*first);
+    results.erase(first, results.end());
+    results.push_back(r);
+    exprCache.insert(std::pair<const SymExpr *, z3::expr>(e, r));
+    exprsByScope.back().push_back(e);
   }
-  case SymExpr::S_ScalarSymbol: {
-    const Symbol *sym = static_cast<const Symbol *>(cond);
+  z3::expr r = results.back();
+  results.clear();
+  return r;
+}
+
+// Build the Z3 expression of one node from the expressions of its operands.
+class Z3Adapter::Translator
+  : public SymExprVisitor<Z3Adapter::Translator, z3::expr> {
+public:
+  Translator(Z3Adapter &a, const z3::expr *o)
+    : adapter(a), c(*a.c), ops(o) {}
+
+  z3::expr visitScalarSymbol(const ScalarSymbol *sym) {
     unsigned id = sym->getSymbolID();
-    std::map<unsigned, z3::expr>::iterator it = decls.find(id);
-    if(it != decls.end()) {
-      return (it->second);
-    } else {
-      z3::expr e(c, c.bv_const(sym->getSymName().c_str(),
-                               sym->getTypeSizeInBits(ctx)));
-      decls.insert(std::pair<unsigned, z3::expr>(id, e));
-      return e;
-    }
+    if (z3::expr *decl = adapter.decls.lookup(id))
+      return *decl;
+    return adapter.decls.insert(id, c.bv_const(adapter.names.get(sym),
+                                               sym->getBitWidth(adapter.ctx)));
   }
-  case SymExpr::S_RegionSymbol: {
-    const RegionSymbol *asym = static_cast<const RegionSymbol *>(cond);
+
+  z3::expr visitRegionSymbol(const RegionSymbol *asym) {
     unsigned id = asym->getSymbolID();
-    std::map<unsigned, z3::expr>::iterator it = decls.find(id);
-    if (it != decls.end()) {
-      return it->second;
-    } else {
-      unsigned indexSize = ctx.getArrayIndexTypeSizeInBits();
-      unsigned elemSize = asym->getElementTypeSizeInBits(ctx);
-      unsigned nDim = asym->getNumberDimension(ctx);
-      z3::sort indexSort = c.bv_sort(indexSize);
-      z3::sort valueSort = c.bv_sort(elemSize);
-      for (int i = 0; i < nDim; ++i) {
-        valueSort = c.array_sort(indexSort, valueSort);
-      }
-      z3::expr e(c, c.constant(asym->getSymName().c_str(), valueSort));
-      decls.insert(std::pair<unsigned, z3::expr>(id, e));
-      return e;
+    if (z3::expr *decl = adapter.decls.lookup(id))
+      return *decl;
+    SolverContext &ctx = adapter.ctx;
+    unsigned indexSize = ctx.getArrayIndexTypeSizeInBits();
+    unsigned elemSize = asym->getElementTypeSizeInBits(ctx);
+    unsigned nDim = asym->getNumberDimension(ctx);
+    z3::sort indexSort = c.bv_sort(indexSize);
+    z3::sort valueSort = c.bv_sort(elemSize);
+    for (int i = 0; i < nDim; ++i) {
+      valueSort = c.array_sort(indexSort, valueSort);
     }
+    return adapter.decls.insert(id, c.constant(adapter.names.get(asym),
+                                               valueSort));
   }
-  case SymExpr::S_ElemSymExpr: {
-    const ElemSymExpr *elem = static_cast<const ElemSymExpr *>(cond);
-    z3::expr base = genZ3Expr(elem->getBaseExpr());
-    z3::expr index = genZ3Expr(elem->getIndexExpr());
-    return select(base, index);
+
+  z3::expr visitElemSymExpr(const ElemSymExpr *) {
+    return select(ops[0], ops[1]);
   }
-  case SymExpr::S_ArithSymExpr: {
-    const ArithSymExpr *bin = static_cast<const ArithSymExpr *>(cond);
-    const SymExpr *lhs = bin->getLHS();
-    const SymExpr *rhs = bin->getRHS();
 
-    z3::expr e1 = genZ3Expr(lhs);
-    z3::expr e2 = genZ3Expr(rhs);
+  z3::expr visitArithSymExpr(const ArithSymExpr *bin) {
+    const z3::expr &e1 = ops[0];
+    const z3::expr &e2 = ops[1];
     switch(bin->getOpcode()) {
     default:
       assert(0 && "Unprocessed arith opcode.");
@@ -137,13 +645,10 @@ z3::expr Z3Adapter::genZ3Expr(const SymExpr *cond) {
       return z3::expr(c, Z3_mk_bvor(c, e1, e2));
     }
   }
-  case SymExpr::S_LogicalSymExpr: {
-    const LogicalSymExpr *bin = static_cast<const LogicalSymExpr *>(cond);
-    const SymExpr *lhs = bin->getLHS();
-    const SymExpr *rhs = bin->getRHS();
 
-    z3::expr e1 = genZ3Expr(lhs);
-    z3::expr e2 = genZ3Expr(rhs);
+  z3::expr visitLogicalSymExpr(const LogicalSymExpr *bin) {
+    const z3::expr &e1 = ops[0];
+    const z3::expr &e2 = ops[1];
     switch(bin->getOpcode()) {
     default:
       assert(0 && "Unprocessed logical opcode");
@@ -173,11 +678,12 @@ z3::expr Z3Adapter::genZ3Expr(const SymExpr *cond) {
       return e1 || e2;
     }
   }
-  case SymExpr::S_UnarySymExpr: {
-    const UnarySymExpr *un = static_cast<const UnarySymExpr *>(cond);
-    const SymExpr *operand = un->getOperand();
-    z3::expr e = genZ3Expr(operand);
+
+  z3::expr visitUnarySymExpr(const UnarySymExpr *un) {
+    const z3::expr &e = ops[0];
     switch(un->getUnaryOpcode()) {
+      default:
+        assert(0 && "Unprocessed unary opcode.");
       case UO_Minus:
         return z3::expr(c, Z3_mk_bvneg(c, e));
       case UO_Not:
@@ -186,18 +692,17 @@ z3::expr Z3Adapter::genZ3Expr(const SymExpr *cond) {
         return !e;
     }
   }
-  case SymExpr::S_TruncSymExpr: {
-    const TruncSymExpr *ce = static_cast<const TruncSymExpr *>(cond);
-    const SymExpr *operand = ce->getOperand();
-    z3::expr e = genZ3Expr(operand);
-    
-    return z3::expr(c, Z3_mk_extract(c, ce->getTypeSizeInBits(ctx) - 1, 0, e));
+
+  z3::expr visitTruncSymExpr(const TruncSymExpr *ce) {
+    const z3::expr &e = ops[0];
+    return z3::expr(c, Z3_mk_extract(c, ce->getBitWidth(adapter.ctx) - 1, 0,
+                                     e));
   }
-  case SymExpr::S_ExtendSymExpr: {
-    const ExtendSymExpr *ce = static_cast<const ExtendSymExpr *>(cond);
+
+  z3::expr visitExtendSymExpr(const ExtendSymExpr *ce) {
     const SymExpr *operand = ce->getOperand();
-    z3::expr e = genZ3Expr(operand);
-    int newBitSize = ce->getTypeSizeInBits(ctx);
+    const z3::expr &e = ops[0];
+    int newBitSize = ce->getBitWidth(adapter.ctx);
 
     // LogicalSymExpr is a Boolean expr that shoud be evaluated by using ite.
     if (LogicalSymExpr::classof(operand)) {
@@ -207,7 +712,8 @@ z3::expr Z3Adapter::genZ3Expr(const SymExpr *cond) {
       return z3::expr(c, Z3_mk_ite(c, e, trueBV, falseBV));
     }
 
-    int oldBitSize = operand->getTypeSizeInBits(ctx);
+    // The sort has the width, without asking the operand.
+    int oldBitSize = e.get_sort().bv_size();
     int sizeDiff = newBitSize - oldBitSize;
     assert(sizeDiff > 0 && "The targe type size should be greater than old type size.");
 
@@ -217,16 +723,25 @@ z3::expr Z3Adapter::genZ3Expr(const SymExpr *cond) {
       return z3::expr(c, Z3_mk_zero_ext(c, sizeDiff, e));
     }
   }
-  case SymExpr::S_ConstExpr: {
-    const ConstExpr *ce = static_cast<const ConstExpr *>(cond);
-    return genZ3Const(ce);
-  }
+
+  z3::expr visitConstExpr(const ConstExpr *ce) {
+    return adapter.genZ3Const(ce);
   }
+
+private:
+  Z3Adapter &adapter;
+  z3::context &c;
+  const z3::expr *ops;
+};
+
+z3::expr Z3Adapter::translateSymExpr(const SymExpr *cond,
+                                     const z3::expr *ops) {
+  return Translator(*this, ops).visit(cond);
 }
 
 z3::expr Z3Adapter::genZ3Const(const ConstExpr *ce) {
-  unsigned sz = ce->getTypeSizeInBits(ctx);
+  unsigned sz = ce->getBitWidth(ctx);
   if (ce->isSigned())
-    return c.bv_val((__int64)ce->getValue(), sz);
-  else return c.bv_val((__uint64)ce->getValue(), sz);
+    return c->bv_val((__int64)ce->getValue(), sz);
+  else return c->bv_val((__uint64)ce->getValue(), sz);
 }
@@ -1,38 +1,201 @@
 #ifndef SMTADAPTER_Z3_ADAPTER_H	// -*- C++ -*-
 #define SMTADAPTER_Z3_ADAPTER_H
+#include "CheckEpoch.h"
+#include "DeclTable.h"
 #include "smtadapter/SolverAdapter.h"
 #include "smtadapter/Symbol.h"
+#include "smtadapter/SymModel.h"
 #include "lib/z3/src/api/c++/z3++.h"
 #include <map>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
 namespace smt {
 
+// How a Z3Adapter sets up its solver.
+struct Z3Config {
+  // Timeout, in milliseconds
+  unsigned timeout;
+  unsigned seed;
+  // Use the solver for this SMT-LIB logic, e.g. "QF_ABV".
+  const char *logic;
+  // Build the solver from this tactic instead, e.g. "qfbv".
+  const char *tactic;
+  // Dump every check into this directory, see Z3Adapter::setDumpDir().
+  const char *dumpDir;
+  // Rebuild the context before a check once this many checks ran in it,
+  // or once the memory Z3 reports grew by this many megabytes since the
+  // first check in it; 0 for no limit. Z3 only reports the memory of the
+  // whole process, so the growth measures this context only when it is the
+  // single Z3Adapter of the process and nothing else allocates much; with
+  // several adapters, e.g. a portfolio, each one may recycle for the others.
+  unsigned maxChecks;
+  unsigned maxMemory;
+
+  Z3Config()
+    : timeout(5000), seed(0), logic(0), tactic(0), dumpDir(0), maxChecks(0),
+      maxMemory(0) {}
+};
 
 class Z3Adapter : public SolverAdapter {
 public:
   Z3Adapter(SolverContext &sc);
   Z3Adapter(SolverContext &sc, unsigned t);
+  Z3Adapter(SolverContext &sc, const Z3Config &cfg);
 
   //override
   virtual SolverResult checkSat();
+  virtual SolverResult
+  checkSatAssuming(const std::vector<SymConstraint> &assumptions);
+  virtual void getFailedAssumptions(std::vector<SymConstraint> &failed);
   virtual void assertSymConstraint(const SymConstraint &sc);
+  virtual unsigned getCheckEpoch() const { return epoch.get(); }
+  virtual void interruptCheck(unsigned e);
+  virtual void push();
+  virtual void pop(unsigned n = 1);
+  virtual unsigned getNumScopes() const { return numScopes; }
   
+  // Translate a SymExpr DAG into z3. Every node is translated at most once
+  // per session; the results are kept until reset().
   z3::expr genZ3Expr(const SymExpr *cond);
   void printModel();
+  void getModel(SymModel &m);
   void reset();
 
+  // Structured access to the model of the last satisfiable check, without
+  // formatting it. Only the asked for symbols are evaluated. They return
+  // false for a symbol the model leaves unconstrained, which any value
+  // satisfies.
+  //
+  // The low 64 bits of a scalar.
+  bool getValue(const Symbol *sym, uint64_t &v);
+  // A scalar of any width, least significant byte first.
+  bool getValue(const Symbol *sym, std::vector<uint8_t> &bytes);
+  // The contents of an array.
+  bool getValue(const RegionSymbol *region, ArrayValue &av);
+  // The values of the scalars syms, in their order.
+  void extractModel(const std::vector<const Symbol *> &syms, FlatModel &fm);
+
+  // Write every following check into dir as a standalone SMT-LIB2 file,
+  // query-<pid>-<n>.smt2, with the timeout, the result and the solve time
+  // in comments. The query is written before it is solved, so a check that
+  // never returns is dumped too. An empty dir turns dumping off.
+  void setDumpDir(const std::string &dir) { dumpDir = dir; }
+
+  unsigned getExprCacheHits() const { return exprCacheHits; }
+  unsigned getExprCacheMisses() const { return exprCacheMisses; }
+  unsigned getExprCacheSize() const { return exprCache.size(); }
+  unsigned getNumRecycles() const { return numRecycles; }
+
+  // Move to a fresh context, which frees everything the old one piled up,
+  // and assert the constraints and scopes again. Expressions returned by
+  // genZ3Expr() before are invalid afterwards.
+  void recycle();
+
 private:
+  void setUpSolver();
+  // Recycle the context if it crossed a limit of the configuration.
+  void checkLimits();
+  z3::expr getConstraintExpr(const SymConstraint &sc);
+  // Start the next check.
+  void beginCheck();
+  // Solve with the assumption literals, unless the check was interrupted.
+  SolverResult solve(const z3::expr_vector &lits);
+  SolverResult getSolverResult(z3::check_result result);
+  // Record the statistics of a check.
+  SolverResult finishCheck(SolverResult result, double solveTime);
+  void dumpQuery(const z3::expr_vector &lits);
+  z3::expr getAssumptionLiteral(const SymConstraint &sc);
+  uint64_t getZ3Numeral(const z3::expr &e);
+  // The model of the last check, fetched from the solver once.
+  const z3::model &getLastModel();
+  // The value of a declared scalar in the last model, false if it has
+  // none.
+  bool evalScalar(const Symbol *sym, z3::expr &val);
+  // Store the (width + 7) / 8 bytes of a bitvector numeral in out.
+  void getZ3Bytes(const z3::expr &val, unsigned width, uint8_t *out);
+  void extractArrayValue(const z3::model &m, const z3::expr &val,
+                         ArrayValue::Index &prefix, ArrayValue &av);
+  void extractElemValue(const z3::model &m, uint64_t index,
+                        const z3::expr &elem, ArrayValue::Index &prefix,
+                        ArrayValue &av);
+  // Translate one node, given its translated operands in the order of
+  // getSymExprOperands().
+  z3::expr translateSymExpr(const SymExpr *cond, const z3::expr *ops);
+  class Translator;
   z3::expr genZ3Const(const ConstExpr *ce);
     
 private:
   // Timeout, in milliseconds
   unsigned timeout;
-  z3::context c;
+  unsigned seed;
+  // Owned; replaced by recycle(), under contextLock so that interrupt()
+  // from another thread never sees a deleted context.
+  std::unique_ptr<z3::context> c;
+  std::mutex contextLock;
   z3::solver s;
-  std::map<unsigned, z3::expr> decls;
+  unsigned numScopes;
+  // The asserted constraints, and asserted.size() at each push(), to
+  // replay them in a new context.
+  std::vector<SymConstraint> asserted;
+  std::vector<unsigned> scopeMarks;
+  // Reset by every check and recycle().
+  std::unique_ptr<z3::model> lastModel;
+  // Declarations and translated nodes live in the context, so both stay
+  // valid when solver scopes are popped.
+  DeclTable<z3::expr> decls;
+  SymbolNames names;
+
+  // Translated nodes, keyed by address. exprsByScope[i] lists the nodes
+  // first translated in scope i, which pop() forgets, so the client must
+  // keep the SymExprs alive (and not reuse their storage) until the scope
+  // is popped, or until the next reset() for the outermost one.
+  std::map<const SymExpr *, z3::expr> exprCache;
+  unsigned exprCacheHits;
+  unsigned exprCacheMisses;
+  std::vector<std::vector<const SymExpr *> > exprsByScope;
+  // The stacks of genZ3Expr(), kept to reuse their storage: nodes to visit,
+  // with whether they are expanded, and the translated operands.
+  std::vector<std::pair<const SymExpr *, bool> > work;
+  std::vector<z3::expr> results;
+
+  // Each condition used as an assumption gets a fresh Boolean literal p
+  // with (p == cond) asserted in the scope where it was first used.
+  // litsByScope[i] lists the conditions whose literal lives in scope i, so
+  // that pop() can forget them.
+  std::map<const SymExpr *, z3::expr> assumptionLits;
+  std::vector<std::vector<const SymExpr *> > litsByScope;
+  unsigned numAssumptionLits;
+  std::vector<SymConstraint> lastAssumptions;
+  std::vector<z3::expr> lastAssumptionLits;
+
+  // exprCacheMisses at the last check, and the time spent translating
+  // since then, in microseconds.
+  unsigned checkedNodes;
+  double translateTime;
+
+  std::string logic;
+  std::string tactic;
+  std::string dumpDir;
+  // The file of the running check, if it is dumped.
+  std::string dumpPath;
+
+  unsigned maxChecks;
+  unsigned maxMemory;
+  // Checks in the current context, and the memory Z3 reported after the
+  // first and the last one, in megabytes. baseMemory is negative until the
+  // first check.
+  unsigned numChecks;
+  double baseMemory;
+  double lastMemory;
+  unsigned numRecycles;
 
+  CheckEpoch epoch;
+  // Whether Z3 solves the current check, under contextLock, so that an
+  // interrupt either reaches Z3 or keeps the check from starting.
+  bool solving;
 };
 
 } // end namespace laser
@@ -1,10 +1,16 @@
 #ifndef SMTADAPTER_SOLVER_ADAPTER_H    // -*- C++ -*-
 #define SMTADAPTER_SOLVER_ADAPTER_H
+#include <iosfwd>
+#include <vector>
 
 namespace smt {
 
 class SymExpr;
 class SolverContext;
+class SymModel;
+class SolverStats;
+struct QueryStats;
+class SolverFuture;
 
 enum SolverResult {
   SAT_Satisfiable = 0,
@@ -26,22 +32,150 @@ struct SymConstraint {
   }  
 };
 
+// Called after every check of an adapter with a trace hook, on the thread
+// that ran the check: the worker thread of an adapter made by
+// CreateAsyncSolverAdapter() or a SolverPool, and a racing thread of a
+// portfolio worker.
+typedef void (*QueryTraceHook)(const QueryStats &qs, void *data);
+
 class SolverAdapter {
 protected:
   SolverContext &ctx;
+  SolverStats *stats;
+  QueryTraceHook traceHook;
+  void *traceData;
+  bool collectBackendStats;
+  std::ostream *statsDump;
 
 protected:
-  SolverAdapter(SolverContext &c) : ctx(c) {}
+  SolverAdapter(SolverContext &c);
+
+  // Add a finished check to the statistics and pass it to the trace hook.
+  void recordQuery(const QueryStats &qs);
+
+public:
+  virtual ~SolverAdapter();
+
+  SolverContext &getContext() const { return ctx; }
+
+  // Statistics of the checks run by this adapter, see SolverStats.h. An
+  // adapter in front of another one reports the statistics of its backend.
+  virtual const SolverStats &getStats() const { return *stats; }
+  virtual void setTraceHook(QueryTraceHook hook, void *data) {
+    traceHook = hook;
+    traceData = data;
+  }
+  // Also collect the internal statistics of the backend after each check,
+  // which costs some time per check.
+  virtual void setCollectBackendStats(bool b) { collectBackendStats = b; }
+  // Print the statistics to os when the adapter is destroyed.
+  virtual void setStatsDump(std::ostream *os) { statsDump = os; }
 
-public:  
   // Check the current asserted fomulars.
   virtual SolverResult checkSat() = 0;
+  // Check the current asserted fomulars together with the given constraints,
+  // without asserting them. Both sides of a branch can be checked this way
+  // against the same asserted prefix.
+  virtual SolverResult
+  checkSatAssuming(const std::vector<SymConstraint> &assumptions) = 0;
+  // After checkSatAssuming() returned SAT_Unsatisfiable, get the subset of
+  // its assumptions that is already unsatisfiable with the asserted
+  // fomulars.
+  virtual void getFailedAssumptions(std::vector<SymConstraint> &failed) = 0;
+  // Start checking the current asserted fomulars, with the assumptions,
+  // and return a handle to the result, see SolverFuture.h. By default the
+  // check runs before checkSatAsync() returns; an adapter made by
+  // CreateAsyncSolverAdapter() runs it on its worker thread instead.
+  virtual SolverFuture
+  checkSatAsync(const std::vector<SymConstraint> &assumptions);
+  // Check each candidate on its own against the current asserted fomulars
+  // and prefix, e.g. the successors of a switch, and return one result per
+  // candidate. prefix is asserted once in a new scope and the candidates
+  // are checked as assumptions; the model of each satisfiable check settles
+  // the later candidates it satisfies without a check. SolverPool can
+  // spread a batch over threads.
+  virtual std::vector<SolverResult>
+  checkSatBatch(const std::vector<SymConstraint> &prefix,
+                const std::vector<SymConstraint> &candidates);
   virtual void assertSymConstraint(const SymConstraint &sc) = 0;
   virtual void printModel() = 0;
+  // Get the model of the last satisfiable check.
+  virtual void getModel(SymModel &m) = 0;
   virtual void reset() = 0;
+  // Make the running check return as soon as possible, from another
+  // thread. The interrupted check returns SAT_Undetermined or SAT_Timeout;
+  // if no check runs, nothing happens.
+  virtual void interrupt() { interruptCheck(getCheckEpoch()); }
+  // The checks of an adapter are numbered from 1 as they start, and
+  // getCheckEpoch() is the number of the running check, or of the last
+  // one. interruptCheck() interrupts the check with the given number: a
+  // running one as interrupt() does, one that has not started returns
+  // SAT_Undetermined without solving, and for a finished one nothing
+  // happens. To interrupt a check started on another thread, take
+  // getCheckEpoch() + 1 before starting it. Adapters that cannot be
+  // interrupted keep the defaults.
+  virtual unsigned getCheckEpoch() const { return 0; }
+  virtual void interruptCheck(unsigned epoch) {}
+
+  // Open a new assertion scope. Constraints asserted after push() are
+  // retracted by the matching pop(), while the constraints asserted before
+  // it (and what the solver learned from them) are kept.
+  virtual void push() = 0;
+  // Retract the innermost n scopes.
+  virtual void pop(unsigned n = 1) = 0;
+  virtual unsigned getNumScopes() const = 0;
 };
 
 SolverAdapter *CreateZ3SolverAdapter(SolverContext &c);
+SolverAdapter *CreateBoolectorSolverAdapter(SolverContext &c);
+// Bit-blast straight to the Lingeling SAT solver; arrays are not supported.
+SolverAdapter *CreateBitBlastSolverAdapter(SolverContext &c);
+
+// Race several solvers on every check and take the first definitive answer.
+// The default portfolio runs Z3 with different logics and seeds; Boolector
+// is left out since it cannot be interrupted. The returned adapter owns the
+// workers, which must all support interruptCheck().
+SolverAdapter *CreatePortfolioSolverAdapter(SolverContext &c);
+SolverAdapter *
+CreatePortfolioSolverAdapter(SolverContext &c,
+                             const std::vector<SolverAdapter *> &workers);
+
+// Put a query result cache in front of backend. The returned adapter owns
+// backend.
+SolverAdapter *CreateCachingSolverAdapter(SolverAdapter *backend);
+
+// Only send the constraints a query depends on to backend, slice by slice.
+// The returned adapter owns backend.
+SolverAdapter *CreateIndependentSolverAdapter(SolverAdapter *backend);
+
+// Constant fold and simplify constraints before they reach backend, and
+// answer the queries they decide. The returned adapter owns backend.
+SolverAdapter *CreateSimplifyingSolverAdapter(SolverAdapter *backend);
+
+// Decide queries made of comparisons between symbols and constants with
+// intervals, and send the others to backend. The returned adapter owns
+// backend.
+SolverAdapter *CreateIntervalSolverAdapter(SolverAdapter *backend);
+
+// Replace the reads of arrays by fresh scalar symbols, with consistency
+// constraints for symbolic indices, so that backend solves pure bitvector
+// queries. The returned adapter owns backend.
+SolverAdapter *CreateArrayEliminatingSolverAdapter(SolverAdapter *backend);
+
+// Answer SAT queries with the models of recent queries when they fit,
+// before asking backend. The returned adapter owns backend.
+SolverAdapter *CreateModelReuseSolverAdapter(SolverAdapter *backend);
+
+// Cache query results in the file at path, shared by the processes of the
+// machine and kept across runs. The returned adapter owns backend.
+SolverAdapter *CreatePersistentCacheSolverAdapter(SolverAdapter *backend,
+                                                  const char *path);
+
+// Run the checks of checkSatAsync() on a worker thread that owns backend,
+// with at most maxOutstanding checks queued or running; checkSatAsync()
+// blocks while the limit is reached. The returned adapter owns backend.
+SolverAdapter *CreateAsyncSolverAdapter(SolverAdapter *backend,
+                                        unsigned maxOutstanding = 4);
 
 }
 
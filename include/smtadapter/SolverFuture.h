@@ -0,0 +1,99 @@
+#ifndef SMTADAPTER_SOLVER_FUTURE_H    // -*- C++ -*-
+#define SMTADAPTER_SOLVER_FUTURE_H
+#include "smtadapter/SolverAdapter.h"
+#include "smtadapter/SymModel.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace smt {
+
+// The state of a check shared by its SolverFuture and the thread that runs
+// it.
+struct SolverFutureState {
+  std::mutex lock;
+  std::condition_variable changed;
+  bool finished;
+  bool cancelled;
+  // The adapter running the check and the number of its check, see
+  // SolverAdapter::interruptCheck(), to interrupt on cancel().
+  SolverAdapter *runner;
+  unsigned epoch;
+
+  SolverResult result;
+  SymModel model;
+  std::vector<SymConstraint> failed;
+
+  SolverFutureState()
+    : finished(false), cancelled(false), runner(0), epoch(0),
+      result(SAT_Undetermined) {}
+
+  void finish(SolverResult r) {
+    std::lock_guard<std::mutex> guard(lock);
+    result = r;
+    finished = true;
+    runner = 0;
+    changed.notify_all();
+  }
+
+  // Under lock.
+  void interruptRunner() {
+    if (runner)
+      runner->interruptCheck(std::max(epoch, runner->getCheckEpoch()));
+  }
+};
+
+// A handle to a check started by SolverAdapter::checkSatAsync(). Copies
+// refer to the same check.
+class SolverFuture {
+  std::shared_ptr<SolverFutureState> state;
+
+public:
+  SolverFuture() {}
+  explicit SolverFuture(const std::shared_ptr<SolverFutureState> &s)
+    : state(s) {}
+
+  bool valid() const { return state.get() != 0; }
+  bool ready() const {
+    std::lock_guard<std::mutex> guard(state->lock);
+    return state->finished;
+  }
+  SolverResult wait() const {
+    std::unique_lock<std::mutex> guard(state->lock);
+    while (!state->finished) {
+      if (!state->cancelled) {
+        state->changed.wait(guard);
+        continue;
+      }
+      // Z3 may drop an interrupt that arrives while it sets up a check.
+      state->interruptRunner();
+      state->changed.wait_for(guard, std::chrono::milliseconds(10));
+    }
+    return state->result;
+  }
+
+  // Stop the check as soon as possible. A check that has not started
+  // returns SAT_Undetermined; a running one is interrupted and returns
+  // SAT_Undetermined or SAT_Timeout, unless it finishes first.
+  void cancel() {
+    std::lock_guard<std::mutex> guard(state->lock);
+    if (state->finished)
+      return;
+    state->cancelled = true;
+    state->interruptRunner();
+  }
+
+  // The model of a satisfiable check, and the failed assumptions of an
+  // unsatisfiable one, after wait().
+  const SymModel &getModel() const { return state->model; }
+  const std::vector<SymConstraint> &getFailedAssumptions() const {
+    return state->failed;
+  }
+};
+
+}
+
+#endif
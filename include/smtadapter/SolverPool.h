@@ -0,0 +1,107 @@
+#ifndef SMTADAPTER_SOLVER_POOL_H    // -*- C++ -*-
+#define SMTADAPTER_SOLVER_POOL_H
+#include "smtadapter/SolverAdapter.h"
+#include "smtadapter/SolverFuture.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace smt {
+
+typedef SolverAdapter *(*SolverAdapterFactory)(SolverContext &c, void *data);
+
+// A fixed set of adapters shared by the threads of a client. Each adapter
+// has a pool thread that makes it, warms it up with an empty check and
+// then runs the checks submitted to the pool.
+//
+// A client thread either checks out an adapter for its own use, or submits
+// whole queries. Both prefer the adapter the thread used last, whose
+// translation cache most likely holds the thread's expressions. Submitted
+// queries wait in the queue of that adapter; a pool thread with nothing to
+// do steals from the other queues. As with a single adapter, the
+// expressions must outlive the pool.
+class SolverPool {
+public:
+  // Make size adapters with factory, Z3 adapters if it is 0. With a
+  // cachePath, every adapter sits behind a persistent query cache in that
+  // file, so that each answer is seen by all of them; lookups take no lock.
+  SolverPool(SolverContext &c, unsigned size, SolverAdapterFactory factory = 0,
+             void *data = 0, const char *cachePath = 0);
+  // All adapters must have been checked in.
+  ~SolverPool();
+
+  // Take an adapter for the calling thread, waiting while all are in use.
+  // It comes with a fresh scope, so that checkin() can drop everything the
+  // thread asserted but keep the translated expressions.
+  SolverAdapter *checkout();
+  void checkin(SolverAdapter *adapter);
+
+  // Queue a check of constraints with assumptions.
+  SolverFuture submit(const std::vector<SymConstraint> &constraints,
+                      const std::vector<SymConstraint> &assumptions =
+                        std::vector<SymConstraint>());
+  // SolverAdapter::checkSatBatch() on the pool, with constraints as the
+  // prefix: the candidates are submitted in waves of one per adapter, and
+  // the models of a wave settle the later candidates they satisfy.
+  std::vector<SolverResult>
+  checkSatBatch(const std::vector<SymConstraint> &constraints,
+                const std::vector<SymConstraint> &candidates);
+
+  unsigned getSize() const { return slots.size(); }
+  unsigned getNumCheckouts() const { return numCheckouts; }
+  // Checkouts and submits that got the adapter the thread used last.
+  unsigned getNumAffinityHits() const { return numAffinityHits; }
+  // Queries run by another adapter than the one they were queued for.
+  unsigned getNumSteals() const { return numSteals; }
+
+private:
+  struct Job {
+    std::shared_ptr<SolverFutureState> state;
+    std::vector<SymConstraint> constraints;
+    std::vector<SymConstraint> assumptions;
+  };
+
+  struct Slot {
+    SolverAdapter *adapter;
+    // Checked out, or running a submitted query.
+    bool busy;
+    std::deque<Job> queue;
+    std::shared_ptr<SolverFutureState> current;
+    std::thread thread;
+
+    Slot() : adapter(0), busy(false) {}
+  };
+
+  void run(unsigned i);
+  // The slot of the calling thread, assigned round robin at first use.
+  unsigned getHomeSlot();
+  bool takeJob(unsigned i, Job &job);
+
+private:
+  SolverContext &ctx;
+  SolverAdapterFactory factory;
+  void *factoryData;
+  std::string cachePath;
+
+  std::mutex lock;
+  std::condition_variable changed;
+  std::vector<Slot *> slots;
+  std::map<std::thread::id, unsigned> affinity;
+  unsigned nextSlot;
+  unsigned numReady;
+  bool stopping;
+
+  // Updated under lock, read by the getters without it.
+  std::atomic<unsigned> numCheckouts;
+  std::atomic<unsigned> numAffinityHits;
+  std::atomic<unsigned> numSteals;
+};
+
+}
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef SMTADAPTER_SOLVER_STATS_H    // -*- C++ -*-
+#define SMTADAPTER_SOLVER_STATS_H
+#include "smtadapter/SolverAdapter.h"
+#include <map>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+namespace smt {
+
+// What one check of a backend cost. Times are in microseconds.
+struct QueryStats {
+  SolverResult result;
+  // The SymExpr nodes translated for this check, i.e. the ones asserted or
+  // assumed since the previous check that were not translated before.
+  unsigned numNodes;
+  // Translation since the previous check.
+  double translateTime;
+  double solveTime;
+  // Declared symbols in the backend.
+  unsigned numDecls;
+  // Internal statistics of the backend, only collected when asked for by
+  // SolverAdapter::setCollectBackendStats().
+  std::vector<std::pair<std::string, double> > backendStats;
+
+  QueryStats()
+    : result(SAT_Undetermined), numNodes(0), translateTime(0), solveTime(0),
+      numDecls(0) {}
+};
+
+// A histogram of latencies with power of two buckets: bucket i counts the
+// samples below 2^i microseconds that are not in bucket i - 1.
+class LatencyHistogram {
+public:
+  enum { NumBuckets = 40 };
+
+  LatencyHistogram() { clear(); }
+
+  void clear();
+  void add(double us);
+
+  uint64_t getCount() const { return count; }
+  double getTotal() const { return total; }
+  double getMax() const { return max; }
+  // An upper bound of the p-th percentile, from the buckets.
+  double getPercentile(unsigned p) const;
+  void print(std::ostream &os) const;
+
+private:
+  uint64_t buckets[NumBuckets];
+  uint64_t count;
+  double total;
+  double max;
+};
+
+// Statistics aggregated over the checks of an adapter.
+class SolverStats {
+public:
+  SolverStats() { clear(); }
+
+  void clear();
+  void addQuery(const QueryStats &qs);
+
+  uint64_t getNumQueries() const { return numQueries; }
+  uint64_t getNumResults(SolverResult r) const { return numResults[r]; }
+  uint64_t getNumNodes() const { return numNodes; }
+  unsigned getMaxDecls() const { return maxDecls; }
+  const LatencyHistogram &getTranslateTimes() const { return translateTimes; }
+  const LatencyHistogram &getSolveTimes() const { return solveTimes; }
+  // Sums of the backend statistics over the checks they were collected for.
+  const std::map<std::string, double> &getBackendStats() const {
+    return backendStats;
+  }
+
+  void print(std::ostream &os) const;
+
+private:
+  uint64_t numQueries;
+  uint64_t numResults[4];
+  uint64_t numNodes;
+  unsigned maxDecls;
+  LatencyHistogram translateTimes;
+  LatencyHistogram solveTimes;
+  std::map<std::string, double> backendStats;
+};
+
+}
+
+#endif
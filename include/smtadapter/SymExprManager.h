@@ -0,0 +1,78 @@
+#ifndef SMTADAPTER_SYMEXPR_MANAGER_H    // -*- C++ -*-
+#define SMTADAPTER_SYMEXPR_MANAGER_H
+#include "Symbol.h"
+#include <map>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace smt {
+
+// Hands out uniqued, immutable SymExprs: asking twice for the same
+// structure returns the same node, so pointer equality is structural
+// equality and pointer keyed caches hit for equal expressions. Every node
+// carries its structural hash in getHashValue().
+//
+// Nodes are allocated from an arena owned by the manager. They are only
+// valid until clear() or the destruction of the manager, which free all of
+// them at once.
+class SymExprManager {
+public:
+  SymExprManager(SolverContext &c);
+  ~SymExprManager();
+
+  const ScalarSymbol *getScalarSymbol(unsigned id, unsigned width);
+  const RegionSymbol *getRegionSymbol(unsigned id, unsigned elemWidth,
+                                      unsigned nDim);
+  // v holds the bits of the constant, zero-extended to 64 bits.
+  const ConstExpr *getConst(uint64_t v, unsigned width, bool isSigned);
+  const ElemSymExpr *getElem(const SymExpr *base, const SymExpr *index);
+  const ArithSymExpr *getArith(const SymExpr *l, const SymExpr *r,
+                               ArithOpcode op);
+  const LogicalSymExpr *getLogical(const SymExpr *l, const SymExpr *r,
+                                   LogicalOpcode op);
+  const UnarySymExpr *getUnary(const SymExpr *e, UnaryOpcode op);
+  const TruncSymExpr *getTrunc(const SymExpr *e, unsigned width);
+  const ExtendSymExpr *getExtend(const SymExpr *e, unsigned width,
+                                 bool sext);
+
+  // Get the uniqued copy of a SymExpr DAG built by the client. Widths are
+  // taken from the client nodes through the SolverContext.
+  const SymExpr *import(const SymExpr *e);
+
+  // Check if e was handed out by this manager.
+  bool isUniqued(const SymExpr *e);
+
+  // Free every node.
+  void clear();
+
+  unsigned getNumNodes() const { return numNodes; }
+  size_t getMemoryUsage() const;
+
+private:
+  struct NodeKey;
+
+  NodeKey getKey(const SymExpr *e);
+  static unsigned computeHash(const NodeKey &key);
+  static bool isEqual(const NodeKey &key, const NodeKey &other);
+  const SymExpr *getOrCreate(const NodeKey &key);
+  SymExpr *createNode(const NodeKey &key);
+  void *allocate(size_t size);
+  void grow();
+
+private:
+  SolverContext &ctx;
+
+  // Open addressing table of the nodes, the size is a power of two.
+  std::vector<const SymExpr *> table;
+  unsigned numNodes;
+
+  // The arena: nodes are bumped from the last slab.
+  std::vector<char *> slabs;
+  char *cur;
+  char *end;
+};
+
+}
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef SMTADAPTER_SYMEXPR_VISITOR_H    // -*- C++ -*-
+#define SMTADAPTER_SYMEXPR_VISITOR_H
+#include "Symbol.h"
+
+namespace smt {
+
+// Dispatch on the kind of a SymExpr to the visitXXX() method of ImplClass,
+// without a virtual call. A method that ImplClass does not define falls
+// back to the one of the parent class in the SymExpr hierarchy, e.g.
+// visitArithSymExpr() to visitBinSymExpr() to visitSymExpr().
+//
+//   struct Counter : SymExprVisitor<Counter, unsigned> {
+//     unsigned visitSymbol(const Symbol *) { return 1; }
+//     unsigned visitSymExpr(const SymExpr *) { return 0; }
+//   };
+template<typename ImplClass, typename RetTy = void>
+class SymExprVisitor {
+public:
+  RetTy visit(const SymExpr *e) {
+    ImplClass *impl = static_cast<ImplClass *>(this);
+    switch (e->getKind()) {
+    default:
+      assert(0 && "Unprocessed SymExpr kind.");
+    case SymExpr::S_ScalarSymbol:
+      return impl->visitScalarSymbol(static_cast<const ScalarSymbol *>(e));
+    case SymExpr::S_RegionSymbol:
+      return impl->visitRegionSymbol(static_cast<const RegionSymbol *>(e));
+    case SymExpr::S_ConstExpr:
+      return impl->visitConstExpr(static_cast<const ConstExpr *>(e));
+    case SymExpr::S_ElemSymExpr:
+      return impl->visitElemSymExpr(static_cast<const ElemSymExpr *>(e));
+    case SymExpr::S_ArithSymExpr:
+      return impl->visitArithSymExpr(static_cast<const ArithSymExpr *>(e));
+    case SymExpr::S_LogicalSymExpr:
+      return impl->visitLogicalSymExpr(
+        static_cast<const LogicalSymExpr *>(e));
+    case SymExpr::S_UnarySymExpr:
+      return impl->visitUnarySymExpr(static_cast<const UnarySymExpr *>(e));
+    case SymExpr::S_TruncSymExpr:
+      return impl->visitTruncSymExpr(static_cast<const TruncSymExpr *>(e));
+    case SymExpr::S_ExtendSymExpr:
+      return impl->visitExtendSymExpr(static_cast<const ExtendSymExpr *>(e));
+    }
+  }
+
+  RetTy visitScalarSymbol(const ScalarSymbol *e) {
+    return static_cast<ImplClass *>(this)->visitSymbol(e);
+  }
+  RetTy visitRegionSymbol(const RegionSymbol *e) {
+    return static_cast<ImplClass *>(this)->visitSymbol(e);
+  }
+  RetTy visitSymbol(const Symbol *e) {
+    return static_cast<ImplClass *>(this)->visitSymExpr(e);
+  }
+  RetTy visitConstExpr(const ConstExpr *e) {
+    return static_cast<ImplClass *>(this)->visitSymExpr(e);
+  }
+  RetTy visitElemSymExpr(const ElemSymExpr *e) {
+    return static_cast<ImplClass *>(this)->visitSymExpr(e);
+  }
+  RetTy visitArithSymExpr(const ArithSymExpr *e) {
+    return static_cast<ImplClass *>(this)->visitBinSymExpr(e);
+  }
+  RetTy visitLogicalSymExpr(const LogicalSymExpr *e) {
+    return static_cast<ImplClass *>(this)->visitBinSymExpr(e);
+  }
+  RetTy visitBinSymExpr(const BinSymExpr *e) {
+    return static_cast<ImplClass *>(this)->visitSymExpr(e);
+  }
+  RetTy visitUnarySymExpr(const UnarySymExpr *e) {
+    return static_cast<ImplClass *>(this)->visitSymExpr(e);
+  }
+  RetTy visitTruncSymExpr(const TruncSymExpr *e) {
+    return static_cast<ImplClass *>(this)->visitCastSymExpr(e);
+  }
+  RetTy visitExtendSymExpr(const ExtendSymExpr *e) {
+    return static_cast<ImplClass *>(this)->visitCastSymExpr(e);
+  }
+  RetTy visitCastSymExpr(const CastSymExpr *e) {
+    return static_cast<ImplClass *>(this)->visitSymExpr(e);
+  }
+  // ImplClass must define it if it leaves any kind unhandled.
+  RetTy visitSymExpr(const SymExpr *e);
+};
+
+// Collect the direct operands of a node, for the passes that walk the DAG.
+class SymExprOperands : public SymExprVisitor<SymExprOperands, unsigned> {
+public:
+  const SymExpr *ops[2];
+
+  unsigned visitElemSymExpr(const ElemSymExpr *e) {
+    ops[0] = e->getBaseExpr();
+    ops[1] = e->getIndexExpr();
+    return 2;
+  }
+  unsigned visitBinSymExpr(const BinSymExpr *e) {
+    ops[0] = e->getLHS();
+    ops[1] = e->getRHS();
+    return 2;
+  }
+  unsigned visitUnarySymExpr(const UnarySymExpr *e) {
+    ops[0] = e->getOperand();
+    return 1;
+  }
+  unsigned visitCastSymExpr(const CastSymExpr *e) {
+    ops[0] = e->getOperand();
+    return 1;
+  }
+  unsigned visitSymExpr(const SymExpr *) { return 0; }
+};
+
+// Store the operands of e in ops and return how many there are.
+inline unsigned getSymExprOperands(const SymExpr *e, const SymExpr *ops[2]) {
+  SymExprOperands v;
+  unsigned n = v.visit(e);
+  for (unsigned i = 0; i < n; ++i)
+    ops[i] = v.ops[i];
+  return n;
+}
+
+}
+
+#endif
@@ -0,0 +1,153 @@
+#ifndef SMTADAPTER_SYM_MODEL_H    // -*- C++ -*-
+#define SMTADAPTER_SYM_MODEL_H
+#include <algorithm>
+#include <map>
+#include <ostream>
+#include <vector>
+#include <stdint.h>
+
+namespace smt {
+
+// The contents of a RegionSymbol in a model. Elements are keyed by their
+// index tuple, outermost dimension first. A key shorter than the number of
+// dimensions gives the value of every element under that prefix that has no
+// more specific key; the empty key is the default of the whole region.
+class ArrayValue {
+public:
+  typedef std::vector<uint64_t> Index;
+  typedef std::map<Index, uint64_t> ElemMap;
+
+private:
+  ElemMap elems;
+
+public:
+  void setValue(const Index &index, uint64_t v) { elems[index] = v; }
+  bool hasValue(const Index &index) const {
+    return elems.find(index) != elems.end();
+  }
+
+  // Check if the value of any element under the prefix is set.
+  bool hasValueUnder(const Index &prefix) const {
+    ElemMap::const_iterator it = elems.lower_bound(prefix);
+    return it != elems.end() && it->first.size() >= prefix.size() &&
+      std::equal(prefix.begin(), prefix.end(), it->first.begin());
+  }
+
+  uint64_t getValue(Index index) const {
+    while (true) {
+      ElemMap::const_iterator it = elems.find(index);
+      if (it != elems.end())
+        return it->second;
+      if (index.empty())
+        return 0;
+      index.pop_back();
+    }
+  }
+
+  const ElemMap &getElems() const { return elems; }
+  bool operator==(const ArrayValue &rhs) const { return elems == rhs.elems; }
+};
+
+// The values of a requested list of scalar symbols, packed into one
+// buffer: the value of entry i is stored in getNumBytes(i) bytes from
+// offset, least significant byte first, so symbols of any width fit.
+class FlatModel {
+public:
+  struct Entry {
+    unsigned id;
+    unsigned width;
+    unsigned offset;
+    // False if the model leaves the symbol unconstrained; its bytes are 0.
+    bool valid;
+  };
+
+  std::vector<Entry> entries;
+  std::vector<uint8_t> data;
+
+  void clear() {
+    entries.clear();
+    data.clear();
+  }
+  unsigned size() const { return entries.size(); }
+  unsigned getNumBytes(unsigned i) const {
+    return (entries[i].width + 7) / 8;
+  }
+  const uint8_t *getBytes(unsigned i) const {
+    return data.empty() ? 0 : &data[entries[i].offset];
+  }
+  // The low 64 bits of the value of entry i.
+  uint64_t getUInt64(unsigned i) const {
+    uint64_t v = 0;
+    unsigned n = std::min(getNumBytes(i), 8u);
+    for (unsigned k = 0; k < n; ++k)
+      v |= (uint64_t)data[entries[i].offset + k] << (8 * k);
+    return v;
+  }
+};
+
+// A backend independent satisfying assignment, keyed by Symbol ID. Values
+// are the bitvector contents zero-extended to 64 bits. Symbols that are
+// absent from the model may take any value; evaluating clients use 0.
+class SymModel {
+public:
+  typedef std::map<unsigned, uint64_t> ScalarMap;
+  typedef std::map<unsigned, ArrayValue> ArrayMap;
+
+private:
+  ScalarMap scalars;
+  ArrayMap arrays;
+
+public:
+  void clear() {
+    scalars.clear();
+    arrays.clear();
+  }
+  bool empty() const { return scalars.empty() && arrays.empty(); }
+
+  void setScalar(unsigned id, uint64_t v) { scalars[id] = v; }
+  bool getScalar(unsigned id, uint64_t &v) const {
+    ScalarMap::const_iterator it = scalars.find(id);
+    if (it == scalars.end())
+      return false;
+    v = it->second;
+    return true;
+  }
+
+  ArrayValue &getOrCreateArray(unsigned id) { return arrays[id]; }
+  const ArrayValue *getArray(unsigned id) const {
+    ArrayMap::const_iterator it = arrays.find(id);
+    return it == arrays.end() ? 0 : &it->second;
+  }
+
+  const ScalarMap &getScalars() const { return scalars; }
+  const ArrayMap &getArrays() const { return arrays; }
+
+  // Add the assignments of another model over a disjoint set of symbols.
+  void merge(const SymModel &m) {
+    scalars.insert(m.scalars.begin(), m.scalars.end());
+    arrays.insert(m.arrays.begin(), m.arrays.end());
+  }
+
+  void print(std::ostream &os) const {
+    for (ScalarMap::const_iterator it = scalars.begin(), ie = scalars.end();
+         it != ie; ++it)
+      os << "$" << it->first << " = " << it->second << "\n";
+    for (ArrayMap::const_iterator it = arrays.begin(), ie = arrays.end();
+         it != ie; ++it) {
+      const ArrayValue::ElemMap &elems = it->second.getElems();
+      for (ArrayValue::ElemMap::const_iterator ei = elems.begin(),
+             ee = elems.end(); ei != ee; ++ei) {
+        os << "$" << it->first;
+        for (unsigned i = 0; i < ei->first.size(); ++i)
+          os << "[" << ei->first[i] << "]";
+        if (ei->first.empty())
+          os << "[*]";
+        os << " = " << ei->second << "\n";
+      }
+    }
+  }
+};
+
+}
+
+#endif
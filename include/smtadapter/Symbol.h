@@ -1,6 +1,7 @@
 #ifndef SMTADAPTER_SYMBOL_H    // -*- C++ -*-
 #define SMTADAPTER_SYMBOL_H
 #include "SolverContext.h"
+#include <atomic>
 #include <string>
 #include <sstream>
 #include <vector>
@@ -66,10 +67,42 @@ public:
 
 protected:
   Kind kind;
+  // Structural hash of the nodes uniqued by a SymExprManager, 0 for the
+  // others. It fits in the padding after kind.
+  unsigned hashValue;
+  // The result of getTypeSizeInBits(), 0 until getBitWidth() asked for it.
+  // Threads that share a node may fill it in concurrently; they store the
+  // same value, so relaxed accesses suffice.
+  mutable std::atomic<unsigned> bitWidth;
+
+  friend class SymExprManager;
   
 public:
-  SymExpr(Kind k) : kind(k) {}
+  SymExpr(Kind k) : kind(k), hashValue(0), bitWidth(0) {}
+  SymExpr(const SymExpr &e)
+    : kind(e.kind), hashValue(e.hashValue),
+      bitWidth(e.bitWidth.load(std::memory_order_relaxed)) {}
+  SymExpr &operator=(const SymExpr &e) {
+    kind = e.kind;
+    hashValue = e.hashValue;
+    bitWidth.store(e.bitWidth.load(std::memory_order_relaxed),
+                   std::memory_order_relaxed);
+    return *this;
+  }
   Kind getKind() const { return kind; }
+  unsigned getHashValue() const { return hashValue; }
+
+  // getTypeSizeInBits() without the virtual call and the type lookup after
+  // the first time. The width is cached in the node, so a node must be
+  // used with one SolverContext. Not for RegionSymbols.
+  unsigned getBitWidth(SolverContext &ctx) const {
+    unsigned w = bitWidth.load(std::memory_order_relaxed);
+    if (w)
+      return w;
+    w = getTypeSizeInBits(ctx);
+    bitWidth.store(w, std::memory_order_relaxed);
+    return w;
+  }
   virtual std::string toString() const {
     // FIXME: Implemented toString function
     assert(0 && "The base toString() function is not impleneted.");
@@ -98,10 +131,16 @@ public:
   Symbol(Kind k, unsigned id) : SymExpr(k), ID(id) {}
   virtual unsigned getSymbolID() const {return ID;}
   std::string getSymName() const {
-    std::string os;
-    std::stringstream ss(os);
-    ss << "$" << ID;
-    return ss.str();
+    // Digits backwards from the end of the buffer.
+    char buf[16];
+    char *p = buf + sizeof(buf);
+    unsigned id = ID;
+    do {
+      *--p = '0' + id % 10;
+      id /= 10;
+    } while (id);
+    *--p = '$';
+    return std::string(p, buf + sizeof(buf));
   }
 
   static bool classof(const SymExpr *se) {
@@ -193,7 +232,7 @@ public:
   ArithOpcode getOpcode() const { return opcode; }
 
   virtual unsigned getTypeSizeInBits(SolverContext &ctx) const {
-    return lhs->getTypeSizeInBits(ctx);
+    return lhs->getBitWidth(ctx);
   }
 
   static bool classof(const SymExpr *se) {
@@ -231,7 +270,7 @@ public:
   UnaryOpcode getUnaryOpcode() const { return uo; }
 
   virtual unsigned getTypeSizeInBits(SolverContext &ctx) const {
-    return operand->getTypeSizeInBits(ctx);
+    return operand->getBitWidth(ctx);
   }
   
   static bool classof(const SymExpr *se) {
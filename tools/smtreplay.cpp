@@ -0,0 +1,242 @@
+#include "z3.h"
+#include "../Timer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace smt;
+
+// Replay the queries dumped by Z3Adapter::setDumpDir() under different
+// solver configurations, and compare with the recorded solve times.
+//
+//   smtreplay [-c CONFIG]... DIR|FILE...
+//
+// A CONFIG is a comma separated list of timeout=MS, seed=N, tactic=NAME
+// and logic=NAME, e.g. -c timeout=1000,tactic=qfbv. Without -c the queries
+// run once with their recorded timeout.
+//
+// Every replayed query prints a tab separated line on stdout:
+//   file config recorded-result recorded-us result us speedup
+// and a summary per configuration goes to stderr.
+
+namespace {
+
+struct ReplayConfig {
+  std::string name;
+  // 0 to use the recorded timeout.
+  unsigned timeout;
+  unsigned seed;
+  std::string tactic;
+  std::string logic;
+
+  ReplayConfig() : name("recorded"), timeout(0), seed(0) {}
+};
+
+struct Query {
+  std::string path;
+  std::string text;
+  unsigned timeout;
+  std::string result;
+  double time;
+};
+
+struct Summary {
+  unsigned numQueries;
+  unsigned numMismatches;
+  double recordedTime;
+  double time;
+  double logSpeedup;
+  unsigned numSpeedups;
+
+  Summary()
+    : numQueries(0), numMismatches(0), recordedTime(0), time(0),
+      logSpeedup(0), numSpeedups(0) {}
+};
+
+bool parseConfig(const char *arg, ReplayConfig &cfg) {
+  cfg.name = arg;
+  std::stringstream ss(arg);
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    std::string::size_type eq = item.find('=');
+    if (eq == std::string::npos)
+      return false;
+    std::string key = item.substr(0, eq), value = item.substr(eq + 1);
+    if (key == "timeout")
+      cfg.timeout = strtoul(value.c_str(), 0, 10);
+    else if (key == "seed")
+      cfg.seed = strtoul(value.c_str(), 0, 10);
+    else if (key == "tactic")
+      cfg.tactic = value;
+    else if (key == "logic")
+      cfg.logic = value;
+    else
+      return false;
+  }
+  return true;
+}
+
+// Read a query and the metadata comments Z3Adapter put around it.
+bool readQuery(const std::string &path, Query &q) {
+  std::ifstream in(path.c_str());
+  if (!in)
+    return false;
+  q.path = path;
+  q.timeout = 0;
+  q.result = "-";
+  q.time = -1;
+  std::stringstream text;
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.compare(0, 14, "; timeout-ms: ") == 0)
+      q.timeout = strtoul(line.c_str() + 14, 0, 10);
+    else if (line.compare(0, 10, "; result: ") == 0)
+      q.result = line.substr(10);
+    else if (line.compare(0, 17, "; solve-time-us: ") == 0)
+      q.time = strtod(line.c_str() + 17, 0);
+    else
+      text << line << "\n";
+  }
+  q.text = text.str();
+  return true;
+}
+
+void collectQueries(const std::string &path, std::vector<std::string> &files) {
+  DIR *dir = opendir(path.c_str());
+  if (!dir) {
+    files.push_back(path);
+    return;
+  }
+  std::vector<std::string> names;
+  while (struct dirent *ent = readdir(dir)) {
+    std::string name = ent->d_name;
+    if (name.size() > 5 && name.compare(name.size() - 5, 5, ".smt2") == 0)
+      names.push_back(path + "/" + name);
+  }
+  closedir(dir);
+  std::sort(names.begin(), names.end());
+  files.insert(files.end(), names.begin(), names.end());
+}
+
+// Adapt the query text to the configuration.
+std::string applyConfig(const Query &q, const ReplayConfig &cfg) {
+  std::string text = q.text;
+  if (!cfg.logic.empty()) {
+    std::string::size_type pos = text.find("(set-logic ");
+    if (pos != std::string::npos)
+      text.erase(pos, text.find(')', pos) - pos + 1);
+    text = "(set-logic " + cfg.logic + ")\n" + text;
+  }
+  if (!cfg.tactic.empty()) {
+    std::string::size_type pos = text.rfind("(check-sat)");
+    if (pos != std::string::npos)
+      text.replace(pos, 11, "(check-sat-using " + cfg.tactic + ")");
+  }
+  return text;
+}
+
+std::string replay(const Query &q, const ReplayConfig &cfg, double &time) {
+  unsigned timeout = cfg.timeout ? cfg.timeout : q.timeout;
+  std::stringstream ss;
+  ss << timeout;
+  if (timeout)
+    Z3_global_param_set("timeout", ss.str().c_str());
+  else
+    Z3_global_param_reset_all();
+  ss.str("");
+  ss << cfg.seed;
+  Z3_global_param_set("smt.random_seed", ss.str().c_str());
+
+  Z3_config zcfg = Z3_mk_config();
+  Z3_context c = Z3_mk_context(zcfg);
+  Z3_del_config(zcfg);
+  std::string text = applyConfig(q, cfg);
+  Timer timer;
+  std::string out = Z3_eval_smtlib2_string(c, text.c_str());
+  time = timer.getMicroseconds();
+  Z3_del_context(c);
+
+  out.erase(out.find_last_not_of(" \n") + 1);
+  if (out == "unknown" && timeout && time >= timeout * 1000.0)
+    return "timeout";
+  if (out != "sat" && out != "unsat")
+    return "unknown";
+  return out;
+}
+
+}
+
+int main(int argc, char **argv) {
+  std::vector<ReplayConfig> configs;
+  std::vector<std::string> files;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+      ReplayConfig cfg;
+      if (!parseConfig(argv[++i], cfg)) {
+        fprintf(stderr, "bad configuration %s\n", argv[i]);
+        return 1;
+      }
+      configs.push_back(cfg);
+    } else {
+      collectQueries(argv[i], files);
+    }
+  }
+  if (files.empty()) {
+    fprintf(stderr, "usage: smtreplay [-c CONFIG]... DIR|FILE...\n");
+    return 1;
+  }
+  if (configs.empty())
+    configs.push_back(ReplayConfig());
+
+  std::vector<Summary> summaries(configs.size());
+  for (unsigned i = 0; i < files.size(); ++i) {
+    Query q;
+    if (!readQuery(files[i], q)) {
+      fprintf(stderr, "cannot read %s\n", files[i].c_str());
+      continue;
+    }
+    for (unsigned j = 0; j < configs.size(); ++j) {
+      double time = 0;
+      std::string result = replay(q, configs[j], time);
+      Summary &sum = summaries[j];
+      ++sum.numQueries;
+      sum.time += time;
+      // A decided query that is now decided differently is a bug, not a
+      // slowdown.
+      if ((q.result == "sat" || q.result == "unsat") &&
+          (result == "sat" || result == "unsat") && result != q.result)
+        ++sum.numMismatches;
+      double speedup = 0;
+      if (q.time >= 0) {
+        sum.recordedTime += q.time;
+        speedup = q.time / std::max(time, 1.0);
+        sum.logSpeedup += log(speedup);
+        ++sum.numSpeedups;
+      }
+      printf("%s\t%s\t%s\t%.0f\t%s\t%.0f\t%.3f\n", q.path.c_str(),
+             configs[j].name.c_str(), q.result.c_str(), q.time,
+             result.c_str(), time, speedup);
+    }
+  }
+
+  for (unsigned j = 0; j < configs.size(); ++j) {
+    const Summary &sum = summaries[j];
+    fprintf(stderr, "%s: %u queries, %u mismatches, recorded %.0fus, "
+            "replayed %.0fus, geomean speedup %.3f\n",
+            configs[j].name.c_str(), sum.numQueries, sum.numMismatches,
+            sum.recordedTime, sum.time,
+            sum.numSpeedups ? exp(sum.logSpeedup / sum.numSpeedups) : 0.0);
+  }
+  bool mismatch = false;
+  for (unsigned j = 0; j < summaries.size(); ++j)
+    mismatch |= summaries[j].numMismatches != 0;
+  return mismatch ? 2 : 0;
+}
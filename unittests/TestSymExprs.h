@@ -0,0 +1,113 @@
+#ifndef SMTADAPTER_UNITTESTS_TEST_SYMEXPRS_H	// -*- C++ -*-
+#define SMTADAPTER_UNITTESTS_TEST_SYMEXPRS_H
+#include "smtadapter/Symbol.h"
+#include "smtadapter/SolverContext.h"
+#include "llvm/ADT/APSInt.h"
+
+// Minimal client SymExprs, shared by the tests and the benchmarks.
+using namespace llvm;
+using namespace smt;
+
+class Z3Symbol : public ScalarSymbol {
+public:
+  Z3Symbol(unsigned id, unsigned size, bool b) :
+    ScalarSymbol(id), bitsize(size), sign(b) {}
+
+  virtual bool isSigned() const {
+    return sign;
+  }
+
+  virtual unsigned getTypeSizeInBits(SolverContext &ctx) const { return bitsize; }
+private:
+  unsigned bitsize;
+  bool sign;
+};
+
+class Z3RegionSymbol : public RegionSymbol {
+public:
+  Z3RegionSymbol(unsigned id, unsigned elembitsize, unsigned nDim)
+    : RegionSymbol(id), elemBitSize(elembitsize), nDimension(nDim) {}
+
+  virtual unsigned getNumberDimension(SolverContext &ctx) const {
+    return nDimension;
+  }
+  
+  virtual unsigned getElementTypeSizeInBits(SolverContext &) const {
+    return elemBitSize;
+  }
+
+private:
+  unsigned elemBitSize;
+  unsigned nDimension;
+};
+
+class Z3ElemSymExpr : public ElemSymExpr {
+public:
+  Z3ElemSymExpr(SymExpr *sup, SymExpr *index, bool b) : ElemSymExpr(sup, index), sign(b) {
+  }
+
+  virtual bool isSigned() const {
+    return sign;
+  }
+
+private:
+  bool sign;
+};
+
+class Z3ArithSymExpr : public ArithSymExpr {
+public:
+  Z3ArithSymExpr(const SymExpr *l, const SymExpr *r, ArithOpcode o)
+    : ArithSymExpr(l, r, o) {}
+};
+
+class Z3LogicalSymExpr : public LogicalSymExpr {
+public:
+  Z3LogicalSymExpr(const SymExpr *l, const SymExpr *r, LogicalOpcode o)
+    : LogicalSymExpr(l, r, o){}
+};
+
+class Z3UnarySymExpr : public UnarySymExpr {
+public:
+  Z3UnarySymExpr(const SymExpr *se, UnaryOpcode o) 
+    : UnarySymExpr(se, o) {}
+
+};
+
+class Z3TruncSymExpr : public TruncSymExpr {
+  unsigned bitsize;
+
+public:
+  Z3TruncSymExpr(int bs, const SymExpr *op) : TruncSymExpr(op), bitsize(bs) {}
+
+  virtual unsigned getTypeSizeInBits(SolverContext &ctx) const { return bitsize; }
+};
+
+class Z3ExtendSymExpr : public ExtendSymExpr {
+public:
+  Z3ExtendSymExpr(int nbz, bool sext, const SymExpr *op)
+    : ExtendSymExpr(op, sext), newBitSize(nbz) {}
+
+  virtual unsigned getTypeSizeInBits(SolverContext &ctx) const {return newBitSize;}
+  int getOldBitSize(SolverContext &ctx) const {return getOperand()->getTypeSizeInBits(ctx);}
+
+private:
+  unsigned newBitSize;
+	
+};
+
+class Z3ConstExpr : public ConstExpr {
+  const APSInt *val;
+public:
+  Z3ConstExpr(const APSInt *v) : 
+	ConstExpr(), val(v) {}
+
+  virtual bool isSigned() const {
+    return !val->isUnsigned();
+  }
+
+  virtual long long getValue() const { return val->getZExtValue(); }
+
+  virtual unsigned getTypeSizeInBits(SolverContext &ctx) const { return val->getBitWidth(); }
+};
+
+#endif
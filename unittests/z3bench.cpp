@@ -0,0 +1,341 @@
+#include "../Z3Adapter.h"
+#include "smtadapter/SolverContext.h"
+#include "TestSymExprs.h"
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "llvm/Support/raw_ostream.h"
+using namespace llvm;
+using namespace smt;
+
+// Benchmark Z3Adapter on generated workloads. Every workload prints one
+// JSON object per line on stdout; progress goes to stderr.
+//
+//   z3bench [--depth N] [--symbols N] [--width N] [--dims N] [--chain N]
+//           [--constraints N] [--queries N] [--timeout MS] [--seed N]
+//
+// Without a shape option, a sweep varies each of depth, symbols, width,
+// dims and chain around the defaults.
+
+SolverContext ctx;
+
+struct WorkloadConfig {
+  // Depth of the arithmetic term on each side of a comparison.
+  unsigned depth;
+  unsigned numSymbols;
+  unsigned width;
+  // Dimensions of the array read at the leaves, 0 for no array.
+  unsigned numDims;
+  // If not 0, the left side of a comparison is instead a left-leaning chain
+  // of this many arithmetic nodes, as loops produce.
+  unsigned chainLength;
+  unsigned numConstraints;
+  unsigned numQueries;
+  unsigned timeout;
+  unsigned seed;
+
+  WorkloadConfig()
+    : depth(3), numSymbols(8), width(32), numDims(1), chainLength(0),
+      numConstraints(4), numQueries(100), timeout(5000), seed(1) {}
+};
+
+// Build random constraints over a fixed set of symbols. Nodes live until
+// clear(), the symbols as long as the builder.
+class WorkloadBuilder {
+public:
+  WorkloadBuilder(const WorkloadConfig &c) : cfg(c), rand(c.seed) {
+    for (unsigned i = 0; i < cfg.numSymbols; ++i)
+      symbols.push_back(Z3Symbol(i + 1, cfg.width, false));
+    region = 0;
+    if (cfg.numDims) {
+      regions.push_back(Z3RegionSymbol(cfg.numSymbols + 1, cfg.width,
+                                       cfg.numDims));
+      region = &regions.back();
+    }
+  }
+
+  const SymExpr *buildConstraint() {
+    static const LogicalOpcode cmps[] = {
+      BO_SLT, BO_ULT, BO_SGT, BO_UGT, BO_SLE, BO_ULE, BO_SGE, BO_UGE,
+      BO_EQ, BO_NE
+    };
+    const SymExpr *l = cfg.chainLength ? buildChain(cfg.chainLength)
+      : buildTerm(cfg.depth);
+    const SymExpr *r = buildConst(cfg.width);
+    logicals.push_back(Z3LogicalSymExpr(l, r, cmps[next() % 10]));
+    return &logicals.back();
+  }
+
+  void clear() {
+    values.clear();
+    consts.clear();
+    elems.clear();
+    ariths.clear();
+    logicals.clear();
+    truncs.clear();
+    extends.clear();
+  }
+
+private:
+  unsigned next() {
+    // xorshift32
+    rand ^= rand << 13;
+    rand ^= rand >> 17;
+    rand ^= rand << 5;
+    return rand;
+  }
+
+  const SymExpr *buildConst(unsigned width) {
+    uint64_t v = ((uint64_t)next() << 32 | next()) % 1024;
+    values.push_back(APSInt(APInt(width, v), true));
+    consts.push_back(Z3ConstExpr(&values.back()));
+    return &consts.back();
+  }
+
+  const SymExpr *buildSymbol() {
+    return &symbols[next() % symbols.size()];
+  }
+
+  // Fit a cfg.width bit term to width bits.
+  const SymExpr *resize(const SymExpr *e, unsigned width) {
+    if (width < cfg.width) {
+      truncs.push_back(Z3TruncSymExpr(width, e));
+      return &truncs.back();
+    }
+    if (width > cfg.width) {
+      extends.push_back(Z3ExtendSymExpr(width, next() % 2, e));
+      return &extends.back();
+    }
+    return e;
+  }
+
+  const SymExpr *buildElem() {
+    SymExpr *base = region;
+    for (unsigned i = 0; i < cfg.numDims; ++i) {
+      unsigned indexWidth = ctx.getArrayIndexTypeSizeInBits();
+      const SymExpr *index = next() % 2 ? buildConst(indexWidth)
+        : resize(buildSymbol(), indexWidth);
+      elems.push_back(Z3ElemSymExpr(base, const_cast<SymExpr *>(index),
+                                    false));
+      base = &elems.back();
+    }
+    return base;
+  }
+
+  const SymExpr *buildTerm(unsigned depth) {
+    static const ArithOpcode ops[] = {
+      BO_Mul, BO_SDiv, BO_UDiv, BO_SRem, BO_URem, BO_Add, BO_Sub, BO_Shl,
+      BO_Shr, BO_And, BO_Xor, BO_Or
+    };
+    if (depth == 0) {
+      unsigned leaf = next() % 4;
+      if (leaf == 0)
+        return buildConst(cfg.width);
+      if (leaf == 1 && region)
+        return buildElem();
+      return buildSymbol();
+    }
+    // Mostly linear and bitwise operators, so that deep terms stay
+    // solvable; multiplication and division are expensive to bit-blast.
+    ArithOpcode op = next() % 16 ? ops[5 + next() % 7] : ops[next() % 5];
+    const SymExpr *l = buildTerm(depth - 1);
+    const SymExpr *r = buildTerm(depth - 1);
+    ariths.push_back(Z3ArithSymExpr(l, r, op));
+    return &ariths.back();
+  }
+
+  // Only linear and bitwise operators, with a symbol or constant on the
+  // right of every node.
+  const SymExpr *buildChain(unsigned length) {
+    static const ArithOpcode ops[] = { BO_Add, BO_Sub, BO_Xor, BO_And, BO_Or };
+    const SymExpr *e = buildSymbol();
+    for (unsigned i = 0; i < length; ++i) {
+      const SymExpr *r = next() % 2 ? buildConst(cfg.width) : buildSymbol();
+      ariths.push_back(Z3ArithSymExpr(e, r, ops[next() % 5]));
+      e = &ariths.back();
+    }
+    return e;
+  }
+
+private:
+  const WorkloadConfig &cfg;
+  unsigned rand;
+  // deque keeps the addresses of the elements stable.
+  std::deque<Z3Symbol> symbols;
+  std::deque<Z3RegionSymbol> regions;
+  Z3RegionSymbol *region;
+  std::deque<APSInt> values;
+  std::deque<Z3ConstExpr> consts;
+  std::deque<Z3ElemSymExpr> elems;
+  std::deque<Z3ArithSymExpr> ariths;
+  std::deque<Z3LogicalSymExpr> logicals;
+  std::deque<Z3TruncSymExpr> truncs;
+  std::deque<Z3ExtendSymExpr> extends;
+};
+
+// Resident set size in KiB, 0 where /proc is not available.
+static unsigned long getRSS() {
+  FILE *f = fopen("/proc/self/statm", "r");
+  if (!f)
+    return 0;
+  unsigned long size = 0, resident = 0;
+  if (fscanf(f, "%lu %lu", &size, &resident) != 2)
+    resident = 0;
+  fclose(f);
+  return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static double getMicroseconds(std::chrono::steady_clock::time_point start,
+                              std::chrono::steady_clock::time_point end) {
+  return std::chrono::duration<double, std::micro>(end - start).count();
+}
+
+static double getPercentile(const std::vector<double> &sorted, unsigned p) {
+  if (sorted.empty())
+    return 0;
+  return sorted[(sorted.size() - 1) * p / 100];
+}
+
+void runWorkload(const WorkloadConfig &cfg) {
+  typedef std::chrono::steady_clock Clock;
+  llvm::errs() << "depth " << cfg.depth << ", symbols " << cfg.numSymbols
+               << ", width " << cfg.width << ", dims " << cfg.numDims
+               << ", chain " << cfg.chainLength << ". . .\n";
+
+  WorkloadBuilder builder(cfg);
+  Z3Adapter adapter(ctx, cfg.timeout);
+  std::vector<double> translateTimes, checkTimes;
+  unsigned numResults[4] = { 0, 0, 0, 0 };
+  unsigned long rssStart = getRSS(), rssPeak = rssStart;
+  Clock::time_point start = Clock::now();
+
+  for (unsigned q = 0; q < cfg.numQueries; ++q) {
+    adapter.reset();
+    builder.clear();
+    std::vector<const SymExpr *> conds;
+    for (unsigned i = 0; i < cfg.numConstraints; ++i)
+      conds.push_back(builder.buildConstraint());
+
+    Clock::time_point t0 = Clock::now();
+    for (unsigned i = 0; i < conds.size(); ++i)
+      adapter.genZ3Expr(conds[i]);
+    Clock::time_point t1 = Clock::now();
+    // Translated already, asserting only hits the cache.
+    for (unsigned i = 0; i < conds.size(); ++i)
+      adapter.assertSymConstraint(SymConstraint(conds[i], true));
+    Clock::time_point t2 = Clock::now();
+    SolverResult result = adapter.checkSat();
+    Clock::time_point t3 = Clock::now();
+
+    translateTimes.push_back(getMicroseconds(t0, t1));
+    checkTimes.push_back(getMicroseconds(t2, t3));
+    ++numResults[result];
+    rssPeak = std::max(rssPeak, getRSS());
+  }
+
+  double elapsed = getMicroseconds(start, Clock::now());
+  unsigned long rssEnd = getRSS();
+  double translateTotal = 0;
+  for (unsigned i = 0; i < translateTimes.size(); ++i)
+    translateTotal += translateTimes[i];
+  std::sort(checkTimes.begin(), checkTimes.end());
+  unsigned n = cfg.numQueries ? cfg.numQueries : 1;
+
+  printf("{\"depth\": %u, \"symbols\": %u, \"width\": %u, \"dims\": %u, "
+         "\"chain\": %u, \"constraints\": %u, \"queries\": %u, \"sat\": %u, \"unsat\": %u, "
+         "\"timeout\": %u, \"unknown\": %u, \"translate_us_mean\": %.2f, "
+         "\"check_us_p50\": %.2f, \"check_us_p90\": %.2f, "
+         "\"check_us_p99\": %.2f, \"check_us_max\": %.2f, \"qps\": %.2f, "
+         "\"rss_kb_per_query\": %.2f, \"rss_kb_peak\": %lu}\n",
+         cfg.depth, cfg.numSymbols, cfg.width, cfg.numDims, cfg.chainLength,
+         cfg.numConstraints, cfg.numQueries, numResults[SAT_Satisfiable],
+         numResults[SAT_Unsatisfiable], numResults[SAT_Timeout],
+         numResults[SAT_Undetermined], translateTotal / n,
+         getPercentile(checkTimes, 50), getPercentile(checkTimes, 90),
+         getPercentile(checkTimes, 99), getPercentile(checkTimes, 100),
+         elapsed > 0 ? cfg.numQueries * 1e6 / elapsed : 0,
+         rssEnd > rssStart ? (double)(rssEnd - rssStart) / n : 0.0, rssPeak);
+  fflush(stdout);
+}
+
+static bool parseOption(int argc, char **argv, int &i, const char *name,
+                        unsigned &value) {
+  if (strcmp(argv[i], name) != 0)
+    return false;
+  if (i + 1 >= argc) {
+    fprintf(stderr, "missing value for %s\n", name);
+    exit(1);
+  }
+  value = strtoul(argv[++i], 0, 10);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  WorkloadConfig cfg;
+  bool sweep = true;
+  for (int i = 1; i < argc; ++i) {
+    if (parseOption(argc, argv, i, "--depth", cfg.depth) ||
+        parseOption(argc, argv, i, "--symbols", cfg.numSymbols) ||
+        parseOption(argc, argv, i, "--width", cfg.width) ||
+        parseOption(argc, argv, i, "--dims", cfg.numDims) ||
+        parseOption(argc, argv, i, "--chain", cfg.chainLength)) {
+      sweep = false;
+      continue;
+    }
+    if (parseOption(argc, argv, i, "--constraints", cfg.numConstraints) ||
+        parseOption(argc, argv, i, "--queries", cfg.numQueries) ||
+        parseOption(argc, argv, i, "--timeout", cfg.timeout) ||
+        parseOption(argc, argv, i, "--seed", cfg.seed))
+      continue;
+    fprintf(stderr, "unknown option %s\n", argv[i]);
+    return 1;
+  }
+  if (cfg.numSymbols == 0 || cfg.width == 0 || cfg.width > 64) {
+    fprintf(stderr, "need at least one symbol and a width of 1 to 64\n");
+    return 1;
+  }
+
+  if (!sweep) {
+    runWorkload(cfg);
+    return 0;
+  }
+
+  static const unsigned depths[] = { 1, 2, 3, 4, 6 };
+  static const unsigned symbols[] = { 1, 4, 16, 64 };
+  static const unsigned widths[] = { 8, 16, 32, 64 };
+  static const unsigned dims[] = { 0, 1, 2, 3 };
+  static const unsigned chains[] = { 1000, 10000, 100000 };
+  WorkloadConfig w = cfg;
+  for (unsigned i = 0; i < sizeof(depths) / sizeof(depths[0]); ++i) {
+    w.depth = depths[i];
+    runWorkload(w);
+  }
+  w = cfg;
+  for (unsigned i = 0; i < sizeof(symbols) / sizeof(symbols[0]); ++i) {
+    w.numSymbols = symbols[i];
+    runWorkload(w);
+  }
+  w = cfg;
+  for (unsigned i = 0; i < sizeof(widths) / sizeof(widths[0]); ++i) {
+    w.width = widths[i];
+    runWorkload(w);
+  }
+  w = cfg;
+  for (unsigned i = 0; i < sizeof(dims) / sizeof(dims[0]); ++i) {
+    w.numDims = dims[i];
+    runWorkload(w);
+  }
+  // Deep chains take long to build and solve; fewer queries suffice.
+  w = cfg;
+  w.numQueries = std::min(cfg.numQueries, 10u);
+  for (unsigned i = 0; i < sizeof(chains) / sizeof(chains[0]); ++i) {
+    w.chainLength = chains[i];
+    runWorkload(w);
+  }
+  return 0;
+}
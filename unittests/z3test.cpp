@@ -1,145 +1,170 @@
 #include "../Z3Adapter.h"
+#include "../ArrayEliminatingSolverAdapter.h"
+#include "../AsyncSolverAdapter.h"
+#include "../BitBlastAdapter.h"
+#include "../BoolectorAdapter.h"
+#include "../CachingSolverAdapter.h"
+#include "../DeclTable.h"
+#include "../IndependentSolverAdapter.h"
+#include "../IntervalSolverAdapter.h"
+#include "../ModelReuseSolverAdapter.h"
+#include "../PersistentCacheSolverAdapter.h"
+#include "../PortfolioSolverAdapter.h"
+#include "../SimplifyingSolverAdapter.h"
+#include "../SymExprEvaluator.h"
 #include "smtadapter/SolverContext.h"
+#include "smtadapter/SolverFuture.h"
+#include "smtadapter/SolverPool.h"
+#include "smtadapter/SolverStats.h"
+#include "smtadapter/SymExprManager.h"
+#include "smtadapter/SymExprVisitor.h"
+#include "TestSymExprs.h"
+#include "../Timer.h"
 
+#include <algorithm>
+#include <deque>
+#include <fstream>
 #include <sstream>
+#include <thread>
+#include <dirent.h>
+#include <unistd.h>
 #include "llvm/ADT/APSInt.h"
 #include "llvm/Support/raw_ostream.h"
 using namespace llvm;
 using namespace smt;
 
-class Z3Symbol : public ScalarSymbol {
-public:
-  Z3Symbol(unsigned id, unsigned size, bool b) :
-    ScalarSymbol(id), bitsize(size), sign(b) {}
+void testZ3Symbol();
+void testZ3ElemSymExpr();
+void testZ3ArithSymExpr();
+void testZ3UnarySymExpr();
+void testZ3IntCastSymExpr();
+void testZ3Adapter();
+void testZ3ExprCache();
+void testZ3Scopes();
+void testZ3Assumptions();
+void testQueryCache();
+void testIndependentSlicing();
+void testPortfolio();
+void testSymExprManager();
+void testSimplifier();
+void testModelReuse();
+void testSolverStats();
+void testZ3Dump();
+void testPersistentCache();
+void testAsyncCheckSat();
+void testSolverPool();
+void testZ3Recycle();
+void testZ3RecycleStress();
+void testZ3DeepChain();
+void testZ3ModelAccess();
+void testDeclTable();
+void testSymExprVisitor();
+void testCheckSatBatch();
+void testIntervalSolver();
+void testArrayElimination();
+void testBoolectorAdapter();
+void testBitBlastAdapter();
+void testMemLeak();
 
-  virtual bool isSigned() const {
-    return sign;
-  }
+SolverContext ctx;
 
-  virtual unsigned getTypeSizeInBits(SolverContext &ctx) const { return bitsize; }
-private:
-  unsigned bitsize;
-  bool sign;
-};
+int main(int argc, char **argv) {
+  // Test Z3Symbol
+  testZ3Symbol();
 
-class Z3RegionSymbol : public RegionSymbol {
-public:
-  Z3RegionSymbol(unsigned id, unsigned elembitsize, unsigned nDim)
-    : RegionSymbol(id), elemBitSize(elembitsize), nDimension(nDim) {}
+  // Test Z3ElemSymExpr
+  testZ3ElemSymExpr();
 
-  virtual unsigned getNumberDimension(SolverContext &ctx) const {
-    return nDimension;
-  }
-  
-  virtual unsigned getElementTypeSizeInBits(SolverContext &) const {
-    return elemBitSize;
-  }
+  // Test Z3ArithSymExpr
+  testZ3ArithSymExpr();
 
-private:
-  unsigned elemBitSize;
-  unsigned nDimension;
-};
+  //Test Z3UnarySymExpr
+  testZ3UnarySymExpr();
 
-class Z3ElemSymExpr : public ElemSymExpr {
-public:
-  Z3ElemSymExpr(SymExpr *sup, SymExpr *index, bool b) : ElemSymExpr(sup, index), sign(b) {
-  }
+  //Test Z3IntCastSymExpr
+  testZ3IntCastSymExpr();
 
-  virtual bool isSigned() const {
-    return sign;
-  }
+  // Test Z3Adapter
+  testZ3Adapter();
 
-private:
-  bool sign;
-};
+  // Test translation cache
+  testZ3ExprCache();
 
-class Z3ArithSymExpr : public ArithSymExpr {
-public:
-  Z3ArithSymExpr(const SymExpr *l, const SymExpr *r, ArithOpcode o)
-    : ArithSymExpr(l, r, o) {}
-};
+  // Test push/pop scopes
+  testZ3Scopes();
 
-class Z3LogicalSymExpr : public LogicalSymExpr {
-public:
-  Z3LogicalSymExpr(const SymExpr *l, const SymExpr *r, LogicalOpcode o)
-    : LogicalSymExpr(l, r, o){}
-};
+  // Test checking with assumptions
+  testZ3Assumptions();
 
-class Z3UnarySymExpr : public UnarySymExpr {
-public:
-  Z3UnarySymExpr(const SymExpr *se, UnaryOpcode o) 
-    : UnarySymExpr(se, o) {}
+  // Test query result cache
+  testQueryCache();
 
-};
+  // Test constraint independence slicing
+  testIndependentSlicing();
 
-class Z3TruncSymExpr : public TruncSymExpr {
-  unsigned bitsize;
+  // Test portfolio of Z3 configurations
+  testPortfolio();
 
-public:
-  Z3TruncSymExpr(int bs, const SymExpr *op) : TruncSymExpr(op), bitsize(bs) {}
+  // Test hash-consing of SymExprs
+  testSymExprManager();
 
-  virtual unsigned getTypeSizeInBits(SolverContext &ctx) const { return bitsize; }
-};
+  // Test constant folding and simplification
+  testSimplifier();
 
-class Z3ExtendSymExpr : public ExtendSymExpr {
-public:
-  Z3ExtendSymExpr(int nbz, bool sext, const SymExpr *op)
-    : ExtendSymExpr(op, sext), newBitSize(nbz) {}
+  // Test evaluation and reuse of models
+  testModelReuse();
 
-  virtual unsigned getTypeSizeInBits(SolverContext &ctx) const {return newBitSize;}
-  int getOldBitSize(SolverContext &ctx) const {return getOperand()->getTypeSizeInBits(ctx);}
+  // Test query statistics
+  testSolverStats();
 
-private:
-  unsigned newBitSize;
-	
-};
+  // Test dumping queries as SMT-LIB2
+  testZ3Dump();
 
-class Z3ConstExpr : public ConstExpr {
-  const APSInt *val;
-public:
-  Z3ConstExpr(const APSInt *v) : 
-	ConstExpr(), val(v) {}
+  // Test the on-disk query cache
+  testPersistentCache();
 
-  virtual bool isSigned() const {
-    return !val->isUnsigned();
-  }
+  // Test checks on a worker thread
+  testAsyncCheckSat();
 
-  virtual long long getValue() const { return val->getZExtValue(); }
+  // Test sharing adapters between threads
+  testSolverPool();
 
-  virtual unsigned getTypeSizeInBits(SolverContext &ctx) const { return val->getBitWidth(); }
-};
+  // Test rebuilding the Z3 context
+  testZ3Recycle();
 
-void testZ3Symbol();
-void testZ3ElemSymExpr();
-void testZ3ArithSymExpr();
-void testZ3UnarySymExpr();
-void testZ3IntCastSymExpr();
-void testZ3Adapter();
-void testMemLeak();
+  // Test translating chains deeper than the native stack allows
+  testZ3DeepChain();
 
-SolverContext ctx;
+  // Test reading single values out of the model
+  testZ3ModelAccess();
 
-int main() {
-  // Test Z3Symbol
-  testZ3Symbol();
+  // Test the table of declarations
+  testDeclTable();
 
-  // Test Z3ElemSymExpr
-  testZ3ElemSymExpr();
+  // Test the SymExpr visitor and the cached bit widths
+  testSymExprVisitor();
 
-  // Test Z3ArithSymExpr
-  testZ3ArithSymExpr();
+  // Test checking many candidates under one prefix
+  testCheckSatBatch();
 
-  //Test Z3UnarySymExpr
-  testZ3UnarySymExpr();
+  // Test deciding comparisons with constants by intervals
+  testIntervalSolver();
 
-  //Test Z3IntCastSymExpr
-  testZ3IntCastSymExpr();
+  // Test replacing array reads by scalars
+  testArrayElimination();
 
-  // Test Z3Adapter
-  testZ3Adapter();
+  // Test Boolector backend
+  testBoolectorAdapter();
+
+  // Test bit-blasting to SAT
+  testBitBlastAdapter();
 
   // Test Memory Leak
   // testMemLeak();
+
+  // Long running: memory of a million queries with context recycling
+  if (argc > 1 && std::string(argv[1]) == "--stress")
+    testZ3RecycleStress();
 }
 
 void testZ3Symbol() {
@@ -357,3 +382,1681 @@ void testMemLeak() {
   for(int i = 0; i < 10000; i ++)
     testZ3Adapter();
 }
+
+void testZ3ExprCache() {
+  llvm::errs() << "Test Z3 translation cache. . .\n";
+  unsigned timeout = 1000; // 1 second
+  Z3Adapter adapter(ctx, timeout);
+
+  // t = x1 + x2; (t * t) == (t - x1) is a DAG where t is shared.
+  Z3Symbol x1(1, 32, false);
+  Z3Symbol x2(2, 32, false);
+  Z3ArithSymExpr t(&x1, &x2, BO_Add);
+  Z3ArithSymExpr mul(&t, &t, BO_Mul);
+  Z3ArithSymExpr sub(&t, &x1, BO_Sub);
+  Z3LogicalSymExpr eq(&mul, &sub, BO_EQ);
+
+  adapter.genZ3Expr(&eq);
+  // x1, x2, t, mul, sub, eq are translated once each; t is reused twice
+  // and x1 once.
+  assert(adapter.getExprCacheMisses() == 6);
+  assert(adapter.getExprCacheHits() == 3);
+
+  adapter.genZ3Expr(&eq);
+  assert(adapter.getExprCacheMisses() == 6);
+  assert(adapter.getExprCacheHits() == 4);
+
+  adapter.reset();
+  assert(adapter.getExprCacheSize() == 0);
+  adapter.genZ3Expr(&sub);
+  assert(adapter.getExprCacheMisses() == 10);
+
+  // The nodes first translated in a scope are forgotten when it is popped,
+  // the ones of the outer scope are kept.
+  adapter.push();
+  adapter.genZ3Expr(&eq);
+  assert(adapter.getExprCacheMisses() == 12);
+  assert(adapter.getExprCacheSize() == 6);
+  adapter.pop();
+  assert(adapter.getExprCacheSize() == 4);
+
+  llvm::errs() << "hits: " << adapter.getExprCacheHits()
+               << ", misses: " << adapter.getExprCacheMisses() << "\n\n";
+}
+
+void testZ3Scopes() {
+  llvm::errs() << "Test Z3 scopes. . .\n";
+  SolverAdapter *adapter = CreateZ3SolverAdapter(ctx);
+
+  // Prefix: x1 < 10. Branches: x1 > 20 (infeasible), x1 > 5 (feasible).
+  Z3Symbol x1(1, 32, false);
+  llvm::APInt v1(32, 10), v2(32, 20), v3(32, 5);
+  llvm::APSInt v4(v1, false), v5(v2, false), v6(v3, false);
+  Z3ConstExpr ce1(&v4), ce2(&v5), ce3(&v6);
+  Z3LogicalSymExpr prefix(&x1, &ce1, BO_ULT);
+  Z3LogicalSymExpr br1(&x1, &ce2, BO_UGT);
+  Z3LogicalSymExpr br2(&x1, &ce3, BO_UGT);
+
+  adapter->assertSymConstraint(SymConstraint(&prefix, true));
+  adapter->push();
+  adapter->assertSymConstraint(SymConstraint(&br1, true));
+  assert(adapter->getNumScopes() == 1);
+  SolverResult r = adapter->checkSat();
+  assert(r == SAT_Unsatisfiable);
+  adapter->pop();
+
+  adapter->push();
+  adapter->assertSymConstraint(SymConstraint(&br2, true));
+  r = adapter->checkSat();
+  assert(r == SAT_Satisfiable);
+  adapter->push();
+  adapter->assertSymConstraint(SymConstraint(&br1, true));
+  r = adapter->checkSat();
+  assert(r == SAT_Unsatisfiable);
+  adapter->pop(2);
+  assert(adapter->getNumScopes() == 0);
+
+  // Only the prefix is left.
+  adapter->assertSymConstraint(SymConstraint(&br1, false));
+  if (adapter->checkSat() == SAT_Satisfiable)
+    adapter->printModel();
+  adapter->reset();
+}
+
+void testZ3Assumptions() {
+  llvm::errs() << "Test Z3 assumptions. . .\n";
+  SolverAdapter *adapter = CreateZ3SolverAdapter(ctx);
+
+  // Prefix: x1 < 10 and x2 == x1. Branch on x1 > 20 and on x2 > 5.
+  Z3Symbol x1(1, 32, false);
+  Z3Symbol x2(2, 32, false);
+  llvm::APInt v1(32, 10), v2(32, 20), v3(32, 5);
+  llvm::APSInt v4(v1, false), v5(v2, false), v6(v3, false);
+  Z3ConstExpr ce1(&v4), ce2(&v5), ce3(&v6);
+  Z3LogicalSymExpr prefix1(&x1, &ce1, BO_ULT);
+  Z3LogicalSymExpr prefix2(&x2, &x1, BO_EQ);
+  Z3LogicalSymExpr br1(&x1, &ce2, BO_UGT);
+  Z3LogicalSymExpr br2(&x2, &ce3, BO_UGT);
+  adapter->assertSymConstraint(SymConstraint(&prefix1, true));
+  adapter->assertSymConstraint(SymConstraint(&prefix2, true));
+
+  std::vector<SymConstraint> assumptions;
+  assumptions.push_back(SymConstraint(&br2, true));
+  assumptions.push_back(SymConstraint(&br1, true));
+  SolverResult r = adapter->checkSatAssuming(assumptions);
+  assert(r == SAT_Unsatisfiable);
+  std::vector<SymConstraint> failed;
+  adapter->getFailedAssumptions(failed);
+  assert(failed.size() == 1 && failed[0] == assumptions[1]);
+
+  // The false side of x1 > 20 against the same prefix.
+  assumptions[1] = SymConstraint(&br1, false);
+  r = adapter->checkSatAssuming(assumptions);
+  assert(r == SAT_Satisfiable);
+  adapter->printModel();
+
+  // Literals defined inside a popped scope are recreated.
+  adapter->push();
+  assumptions.assign(1, SymConstraint(&br2, false));
+  r = adapter->checkSatAssuming(assumptions);
+  assert(r == SAT_Satisfiable);
+  adapter->pop();
+  r = adapter->checkSatAssuming(assumptions);
+  assert(r == SAT_Satisfiable);
+  r = adapter->checkSat();
+  assert(r == SAT_Satisfiable);
+  adapter->reset();
+}
+
+void testQueryCache() {
+  llvm::errs() << "Test query cache. . .\n";
+  CachingSolverAdapter adapter(new Z3Adapter(ctx, 1000));
+
+  // x1 < 10, x1 > 20, x2 == x1, id[x1] == x2
+  Z3Symbol x1(1, 64, false);
+  Z3Symbol x2(2, 32, false);
+  Z3RegionSymbol id(3, 32, 1);
+  llvm::APInt v1(64, 10), v2(64, 20);
+  llvm::APSInt v3(v1, false), v4(v2, false);
+  Z3ConstExpr ce1(&v3), ce2(&v4);
+  Z3LogicalSymExpr lt(&x1, &ce1, BO_ULT);
+  Z3LogicalSymExpr gt(&x1, &ce2, BO_UGT);
+  Z3TruncSymExpr tr(32, &x1);
+  Z3LogicalSymExpr eq(&x2, &tr, BO_EQ);
+  Z3ElemSymExpr elem(&id, &x1, false);
+  Z3LogicalSymExpr eq2(&elem, &x2, BO_EQ);
+
+  adapter.push();
+  adapter.assertSymConstraint(SymConstraint(&lt, true));
+  adapter.assertSymConstraint(SymConstraint(&gt, true));
+  SolverResult r = adapter.checkSat();
+  assert(r == SAT_Unsatisfiable);
+  adapter.pop();
+  assert(adapter.getNumMisses() == 1);
+
+  // Superset of an UNSAT set.
+  adapter.assertSymConstraint(SymConstraint(&gt, true));
+  adapter.assertSymConstraint(SymConstraint(&eq, true));
+  adapter.assertSymConstraint(SymConstraint(&lt, true));
+  r = adapter.checkSat();
+  assert(r == SAT_Unsatisfiable);
+  assert(adapter.getNumUnsatSubsetHits() == 1);
+  adapter.reset();
+
+  adapter.push();
+  adapter.assertSymConstraint(SymConstraint(&lt, true));
+  adapter.assertSymConstraint(SymConstraint(&eq, true));
+  adapter.assertSymConstraint(SymConstraint(&eq2, true));
+  r = adapter.checkSat();
+  assert(r == SAT_Satisfiable);
+  SymModel model;
+  adapter.getModel(model);
+  uint64_t x1v = 0, x2v = 0;
+  assert(model.getScalar(1, x1v) && model.getScalar(2, x2v));
+  assert(x1v < 10 && x1v == x2v);
+  assert(model.getArray(3)->getValue(ArrayValue::Index(1, x1v)) == x2v);
+  r = adapter.checkSat();
+  assert(r == SAT_Satisfiable);
+  assert(adapter.getNumExactHits() == 1);
+  adapter.pop();
+
+  // Subset of a SAT set, answered with the same model.
+  adapter.assertSymConstraint(SymConstraint(&eq2, true));
+  adapter.assertSymConstraint(SymConstraint(&lt, true));
+  r = adapter.checkSat();
+  assert(r == SAT_Satisfiable);
+  assert(adapter.getNumSatSupersetHits() == 1);
+
+  // The core of an UNSAT check with assumptions is cached.
+  std::vector<SymConstraint> assumptions;
+  assumptions.push_back(SymConstraint(&gt, true));
+  r = adapter.checkSatAssuming(assumptions);
+  assert(r == SAT_Unsatisfiable);
+  std::vector<SymConstraint> failed;
+  adapter.getFailedAssumptions(failed);
+  assert(failed.size() == 1);
+  adapter.push();
+  adapter.assertSymConstraint(SymConstraint(&gt, true));
+  r = adapter.checkSat();
+  assert(r == SAT_Unsatisfiable);
+  adapter.pop();
+  assert(adapter.getNumExactHits() == 2);
+
+  // Constraints are matched by structure, not by address.
+  Z3LogicalSymExpr gt2(&x1, &ce2, BO_UGT);
+  assumptions[0] = SymConstraint(&gt2, true);
+  r = adapter.checkSatAssuming(assumptions);
+  assert(r == SAT_Unsatisfiable);
+  assert(adapter.getNumExactHits() == 3);
+  adapter.getFailedAssumptions(failed);
+  assert(failed.size() == 1 && failed[0].cond == &gt2);
+
+  llvm::errs() << "exact: " << adapter.getNumExactHits()
+               << ", unsat subset: " << adapter.getNumUnsatSubsetHits()
+               << ", sat superset: " << adapter.getNumSatSupersetHits()
+               << ", misses: " << adapter.getNumMisses() << "\n";
+  adapter.printModel();
+  llvm::errs() << "\n";
+}
+
+void testIndependentSlicing() {
+  llvm::errs() << "Test independent slicing. . .\n";
+  CachingSolverAdapter *cache = new CachingSolverAdapter(new Z3Adapter(ctx));
+  IndependentSolverAdapter adapter(cache);
+
+  // Slices: {x1 < 10}, {x2 == x3, x3 > 5}.
+  Z3Symbol x1(1, 32, false);
+  Z3Symbol x2(2, 32, false);
+  Z3Symbol x3(3, 32, false);
+  llvm::APInt v1(32, 10), v2(32, 5);
+  llvm::APSInt v3(v1, false), v4(v2, false);
+  Z3ConstExpr ce1(&v3), ce2(&v4);
+  Z3LogicalSymExpr c1(&x1, &ce1, BO_ULT);
+  Z3LogicalSymExpr c2(&x2, &x3, BO_EQ);
+  Z3LogicalSymExpr c3(&x3, &ce2, BO_UGT);
+  Z3LogicalSymExpr br(&x1, &ce2, BO_UGT);
+  adapter.assertSymConstraint(SymConstraint(&c1, true));
+  adapter.assertSymConstraint(SymConstraint(&c2, true));
+  adapter.assertSymConstraint(SymConstraint(&c3, true));
+
+  SolverResult r = adapter.checkSat();
+  assert(r == SAT_Satisfiable);
+  assert(adapter.getNumSlices() == 2);
+
+  // Only x1 < 10 is needed to decide x1 > 5.
+  std::vector<SymConstraint> assumptions(1, SymConstraint(&br, true));
+  r = adapter.checkSatAssuming(assumptions);
+  assert(r == SAT_Satisfiable);
+  assert(adapter.getNumSentConstraints() == 4);
+  SymModel model;
+  adapter.getModel(model);
+  uint64_t x1v = 0, x2v = 0, x3v = 0;
+  assert(model.getScalar(1, x1v) && x1v > 5 && x1v < 10);
+  assert(model.getScalar(2, x2v) && model.getScalar(3, x3v));
+  assert(x2v == x3v && x3v > 5);
+  // The slice {x2 == x3, x3 > 5} comes from the cache.
+  assert(cache->getNumExactHits() == 1);
+
+  assumptions[0] = SymConstraint(&c1, false);
+  r = adapter.checkSatAssuming(assumptions);
+  assert(r == SAT_Unsatisfiable);
+  std::vector<SymConstraint> failed;
+  adapter.getFailedAssumptions(failed);
+  assert(failed.size() == 1);
+  adapter.getModel(model);
+  assert(adapter.getDeferredResult() == SAT_Satisfiable);
+
+  // An UNSAT slice that the assumptions do not depend on is only found by
+  // getModel(), which leaves its symbols out.
+  Z3LogicalSymExpr ne(&x2, &x3, BO_NE);
+  adapter.push();
+  adapter.assertSymConstraint(SymConstraint(&ne, true));
+  assumptions[0] = SymConstraint(&br, true);
+  r = adapter.checkSatAssuming(assumptions);
+  assert(r == SAT_Satisfiable);
+  model.clear();
+  adapter.getModel(model);
+  assert(adapter.getDeferredResult() == SAT_Unsatisfiable);
+  assert(model.getScalar(1, x1v) && !model.getScalar(2, x2v));
+  adapter.pop();
+
+  llvm::errs() << "queries: " << adapter.getNumQueries()
+               << ", constraints: " << adapter.getNumConstraints()
+               << ", sent: " << adapter.getNumSentConstraints() << "\n\n";
+}
+
+void testBoolectorAdapter() {
+  llvm::errs() << "Test BoolectorAdapter. . .\n";
+  SolverAdapter *adapter = CreateBoolectorSolverAdapter(ctx);
+
+  // x1 * 5 < x2 + 6, (x1 << x3) == 8, x3 < 3
+  Z3Symbol x1(1, 32, false);
+  Z3Symbol x2(2, 32, false);
+  Z3Symbol x3(3, 32, false);
+  llvm::APInt v1(32, 5), v2(32, 6), v3(32, 8), v4(32, 3);
+  llvm::APSInt v5(v1, false), v6(v2, false), v7(v3, false), v8(v4, false);
+  Z3ConstExpr ce1(&v5), ce2(&v6), ce3(&v7), ce4(&v8);
+  Z3ArithSymExpr bin1(&x1, &ce1, BO_Mul), bin2(&x2, &ce2, BO_Add);
+  Z3LogicalSymExpr bin3(&bin1, &bin2, BO_ULT);
+  Z3ArithSymExpr shl(&x1, &x3, BO_Shl);
+  Z3LogicalSymExpr bin4(&shl, &ce3, BO_EQ);
+  Z3LogicalSymExpr bin5(&x3, &ce4, BO_ULT);
+  adapter->assertSymConstraint(SymConstraint(&bin3, true));
+  adapter->push();
+  adapter->assertSymConstraint(SymConstraint(&bin4, true));
+  adapter->assertSymConstraint(SymConstraint(&bin5, true));
+  SolverResult r = adapter->checkSat();
+  assert(r == SAT_Satisfiable);
+  SymModel model;
+  adapter->getModel(model);
+  uint64_t x1v = 0, x3v = 0;
+  assert(model.getScalar(1, x1v) && model.getScalar(3, x3v));
+  assert(x3v < 3 && (x1v << x3v) % ((uint64_t)1 << 32) == 8);
+  adapter->printModel();
+
+  // The other side of x3 < 3, only x3 == 3 is left.
+  std::vector<SymConstraint> assumptions(1, SymConstraint(&bin5, false));
+  adapter->pop();
+  adapter->assertSymConstraint(SymConstraint(&bin4, true));
+  r = adapter->checkSatAssuming(assumptions);
+  assert(r == SAT_Satisfiable);
+  adapter->getModel(model);
+  assert(model.getScalar(3, x3v) && x3v == 3);
+
+  // !(id[index1][index2] >= x3), with id[index1][index2] == x3
+  Z3RegionSymbol id(7, 32, 2);
+  Z3Symbol index1(8, ctx.getArrayIndexTypeSizeInBits(), true);
+  Z3Symbol index2(9, ctx.getArrayIndexTypeSizeInBits(), true);
+  Z3ElemSymExpr ese1(&id, &index1, true);
+  Z3ElemSymExpr ese2(&ese1, &index2, true);
+  Z3LogicalSymExpr bin8(&ese2, &x3, BO_UGE);
+  Z3LogicalSymExpr bin9(&ese2, &x3, BO_EQ);
+  adapter->assertSymConstraint(SymConstraint(&bin8, false));
+  assumptions.assign(1, SymConstraint(&bin9, true));
+  r = adapter->checkSatAssuming(assumptions);
+  assert(r == SAT_Unsatisfiable);
+  std::vector<SymConstraint> failed;
+  adapter->getFailedAssumptions(failed);
+  assert(failed.size() == 1);
+  r = adapter->checkSat();
+  assert(r == SAT_Satisfiable);
+  adapter->printModel();
+  adapter->reset();
+  delete adapter;
+  llvm::errs() << "\n";
+}
+
+void testPortfolio() {
+  llvm::errs() << "Test portfolio. . .\n";
+  std::vector<SolverAdapter *> workers;
+  Z3Config cfg;
+  cfg.timeout = 1000;
+  workers.push_back(new Z3Adapter(ctx, cfg));
+  cfg.seed = 1;
+  cfg.logic = "QF_ABV";
+  workers.push_back(new Z3Adapter(ctx, cfg));
+  cfg.seed = 2;
+  cfg.logic = 0;
+  cfg.tactic = "qfbv";
+  workers.push_back(new Z3Adapter(ctx, cfg));
+  PortfolioSolverAdapter adapter(ctx, workers);
+
+  // x1 * x2 == 1001 with x1, x2 > 1; x1 < x2 in a scope.
+  Z3Symbol x1(1, 32, false);
+  Z3Symbol x2(2, 32, false);
+  llvm::APInt v1(32, 1001), v2(32, 1);
+  llvm::APSInt v3(v1, false), v4(v2, false);
+  Z3ConstExpr ce1(&v3), ce2(&v4);
+  Z3ArithSymExpr mul(&x1, &x2, BO_Mul);
+  Z3LogicalSymExpr c1(&mul, &ce1, BO_EQ);
+  Z3LogicalSymExpr c2(&x1, &ce2, BO_UGT);
+  Z3LogicalSymExpr c3(&x2, &ce2, BO_UGT);
+  Z3LogicalSymExpr c4(&x1, &x2, BO_ULT);
+  adapter.assertSymConstraint(SymConstraint(&c1, true));
+  adapter.assertSymConstraint(SymConstraint(&c2, true));
+  adapter.assertSymConstraint(SymConstraint(&c3, true));
+  adapter.push();
+  adapter.assertSymConstraint(SymConstraint(&c4, true));
+  SolverResult r = adapter.checkSat();
+  assert(r == SAT_Satisfiable);
+  SymModel model;
+  adapter.getModel(model);
+  uint64_t x1v = 0, x2v = 0;
+  assert(model.getScalar(1, x1v) && model.getScalar(2, x2v));
+  assert((uint32_t)(x1v * x2v) == 1001 && x1v > 1 && x1v < x2v);
+  adapter.pop();
+
+  std::vector<SymConstraint> assumptions(1, SymConstraint(&c2, false));
+  r = adapter.checkSatAssuming(assumptions);
+  assert(r == SAT_Unsatisfiable);
+
+  // An interrupt only stops the check it names, even if that has not
+  // started yet, and one for a finished check is dropped.
+  adapter.interruptCheck(adapter.getCheckEpoch() + 1);
+  r = adapter.checkSatAssuming(assumptions);
+  assert(r == SAT_Undetermined);
+  adapter.interruptCheck(adapter.getCheckEpoch());
+  adapter.interrupt();
+  r = adapter.checkSatAssuming(assumptions);
+  assert(r == SAT_Unsatisfiable);
+  Z3Adapter z3(ctx, 1000);
+  z3.assertSymConstraint(SymConstraint(&c1, true));
+  z3.interruptCheck(z3.getCheckEpoch() + 1);
+  r = z3.checkSat();
+  assert(r == SAT_Undetermined);
+  z3.interrupt();
+  r = z3.checkSat();
+  assert(r == SAT_Satisfiable);
+  for (unsigned i = 0; i < adapter.getNumWorkers(); ++i)
+    llvm::errs() << "worker " << i << " won " << adapter.getNumWins(i)
+                 << "\n";
+  llvm::errs() << "\n";
+}
+
+void testSymExprManager() {
+  llvm::errs() << "Test SymExprManager. . .\n";
+  SymExprManager mgr(ctx);
+
+  // (x1 + 5) * (x1 + 5) > id[x2], built twice.
+  const SymExpr *e[2];
+  for (unsigned i = 0; i < 2; ++i) {
+    const SymExpr *x1 = mgr.getScalarSymbol(1, 32);
+    const SymExpr *x2 = mgr.getScalarSymbol(2, ctx.getArrayIndexTypeSizeInBits());
+    const SymExpr *id = mgr.getRegionSymbol(3, 32, 1);
+    const SymExpr *add = mgr.getArith(x1, mgr.getConst(5, 32, false), BO_Add);
+    const SymExpr *mul = mgr.getArith(add, add, BO_Mul);
+    e[i] = mgr.getLogical(mul, mgr.getElem(id, x2), BO_UGT);
+  }
+  assert(e[0] == e[1] && e[0]->getHashValue() != 0);
+  assert(mgr.getNumNodes() == 8);
+  assert(mgr.getConst(5, 32, true) != mgr.getConst(5, 32, false));
+  assert(mgr.getConst(0x105, 8, false) == mgr.getConst(5, 8, false));
+
+  // Import a client DAG with the same structure.
+  Z3Symbol x1(1, 32, false);
+  Z3Symbol x2(2, ctx.getArrayIndexTypeSizeInBits(), false);
+  Z3RegionSymbol id(3, 32, 1);
+  llvm::APInt v1(32, 5);
+  llvm::APSInt v2(v1, true); // unsigned
+  Z3ConstExpr ce(&v2);
+  Z3ArithSymExpr add(&x1, &ce, BO_Add);
+  Z3ArithSymExpr add2(&x1, &ce, BO_Add);
+  Z3ArithSymExpr mul(&add, &add2, BO_Mul);
+  Z3ElemSymExpr elem(&id, &x2, false);
+  Z3LogicalSymExpr cmp(&mul, &elem, BO_UGT);
+  const SymExpr *imported = mgr.import(&cmp);
+  assert(imported == e[0]);
+  assert(mgr.isUniqued(e[0]) && !mgr.isUniqued(&cmp));
+  assert(mgr.getNumNodes() == 10);
+
+  // Uniqued nodes translate like any other SymExpr, and the shared
+  // subexpressions hit the translation cache.
+  Z3Adapter adapter(ctx, 1000);
+  adapter.assertSymConstraint(SymConstraint(e[0], true));
+  SolverResult r = adapter.checkSat();
+  assert(r == SAT_Satisfiable);
+  assert(adapter.getExprCacheHits() == 1);
+
+  llvm::errs() << "nodes: " << mgr.getNumNodes() << ", memory: "
+               << mgr.getMemoryUsage() << "\n";
+  mgr.clear();
+  assert(mgr.getNumNodes() == 0);
+  llvm::errs() << "\n";
+}
+
+void testSimplifier() {
+  llvm::errs() << "Test SymExprSimplifier. . .\n";
+  SymExprManager mgr(ctx);
+  SymExprSimplifier simp(ctx, mgr);
+
+  const SymExpr *x = mgr.getScalarSymbol(1, 32);
+  const SymExpr *y = mgr.getScalarSymbol(2, 8);
+  const SymExpr *zero = mgr.getConst(0, 32, false);
+  const SymExpr *one = mgr.getConst(1, 32, false);
+
+  // (x + 0) * 1 is x.
+  const SymExpr *e = mgr.getArith(mgr.getArith(x, zero, BO_Add), one, BO_Mul);
+  assert(simp.simplify(e) == x);
+  // trunc(zext(y)) is y.
+  e = mgr.getTrunc(mgr.getExtend(y, 32, false), 8);
+  assert(simp.simplify(e) == y);
+  // x == x and (x & 0) != 0.
+  assert(simp.isTrue(simp.simplify(mgr.getLogical(x, x, BO_EQ))));
+  e = mgr.getLogical(mgr.getArith(x, zero, BO_And), zero, BO_NE);
+  assert(simp.isFalse(simp.simplify(e)));
+  // Folding wraps at the width: (3 - 5) is 254 in 8 bits, -2 / 2 is -1.
+  const SymExpr *c3 = mgr.getConst(3, 8, false);
+  const SymExpr *c5 = mgr.getConst(5, 8, false);
+  e = mgr.getArith(c3, c5, BO_Sub);
+  assert(simp.simplify(e) == mgr.getConst(254, 8, false));
+  e = mgr.getArith(e, mgr.getConst(2, 8, false), BO_SDiv);
+  assert(simp.simplify(e) == mgr.getConst(255, 8, false));
+  e = mgr.getLogical(mgr.getExtend(c5, 32, true), x, BO_SLT);
+  assert(simp.simplify(e) == mgr.getLogical(mgr.getConst(5, 32, false), x,
+                                            BO_SLT));
+  // !(x < 5) is x >= 5.
+  const SymExpr *c5w = mgr.getConst(5, 32, false);
+  e = mgr.getUnary(mgr.getLogical(x, c5w, BO_ULT), UO_LNot);
+  assert(simp.simplify(e) == mgr.getLogical(x, c5w, BO_UGE));
+  // A chain far deeper than a recursive rewrite could go: ((x + 0) ^ 1)...
+  e = x;
+  for (unsigned i = 0; i < 100000; ++i)
+    e = mgr.getArith(mgr.getArith(e, zero, BO_Add), one, BO_Xor);
+  assert(simp.isTrue(simp.simplify(mgr.getLogical(e, e, BO_EQ))));
+
+  // Client DAGs are simplified into the manager.
+  Z3Symbol x1(1, 32, false);
+  llvm::APInt v1(32, 0);
+  llvm::APSInt v2(v1, true);
+  Z3ConstExpr ce(&v2);
+  Z3ArithSymExpr add(&x1, &ce, BO_Add);
+  Z3LogicalSymExpr cmp(&add, &x1, BO_ULE);
+  assert(simp.isTrue(simp.simplify(&cmp)));
+  assert(simp.getNumRewrites() > 0);
+
+  // The layer decides trivial queries without the backend.
+  SimplifyingSolverAdapter *adapter =
+    new SimplifyingSolverAdapter(new Z3Adapter(ctx, 1000));
+  adapter->assertSymConstraint(SymConstraint(&cmp, true));
+  SolverResult r = adapter->checkSat();
+  assert(r == SAT_Satisfiable);
+  assert(adapter->getNumDecided() == 1);
+  Z3LogicalSymExpr gt(&add, &ce, BO_UGT);
+  adapter->assertSymConstraint(SymConstraint(&gt, true));
+  adapter->push();
+  Z3ArithSymExpr sub(&x1, &x1, BO_Sub);
+  Z3LogicalSymExpr ne(&sub, &ce, BO_NE);
+  adapter->assertSymConstraint(SymConstraint(&ne, true));
+  r = adapter->checkSat();
+  assert(r == SAT_Unsatisfiable);
+  assert(adapter->getNumDecided() == 2);
+  std::vector<SymConstraint> assumptions, failed;
+  assumptions.push_back(SymConstraint(&ne, true));
+  adapter->pop();
+  r = adapter->checkSatAssuming(assumptions);
+  assert(r == SAT_Unsatisfiable);
+  adapter->getFailedAssumptions(failed);
+  assert(failed.size() == 1 && failed[0] == assumptions[0]);
+  assert(adapter->getNumDecided() == 3);
+  r = adapter->checkSat();
+  assert(r == SAT_Satisfiable);
+  assert(adapter->getNumDecided() == 3);
+  SymModel m;
+  uint64_t v = 0;
+  adapter->getModel(m);
+  assert(m.getScalar(1, v) && v > 0);
+  llvm::errs() << "queries: " << adapter->getNumQueries() << ", decided: "
+               << adapter->getNumDecided() << "\n";
+  delete adapter;
+  llvm::errs() << "\n";
+}
+
+void testModelReuse() {
+  llvm::errs() << "Test model reuse. . .\n";
+  SymExprManager mgr(ctx);
+  unsigned indexWidth = ctx.getArrayIndexTypeSizeInBits();
+  const SymExpr *x = mgr.getScalarSymbol(1, 8);
+  const SymExpr *i = mgr.getScalarSymbol(2, indexWidth);
+  const SymExpr *id = mgr.getRegionSymbol(3, 32, 2);
+  const SymExpr *zero = mgr.getConst(0, 8, false);
+
+  SymModel m;
+  m.setScalar(1, 200);
+  m.setScalar(2, 3);
+  ArrayValue::Index index;
+  index.push_back(3);
+  index.push_back(1);
+  m.getOrCreateArray(3).setValue(index, 7);
+  SymExprEvaluator evaluator(ctx, m);
+  uint64_t v = 0;
+  assert(evaluator.evaluate(mgr.getExtend(x, 32, true), v) && v == 0xffffffc8);
+  assert(evaluator.evaluate(mgr.getExtend(x, 32, false), v) && v == 200);
+  assert(evaluator.evaluate(mgr.getArith(x, zero, BO_SDiv), v) && v == 1);
+  assert(evaluator.evaluate(mgr.getArith(x, zero, BO_UDiv), v) && v == 255);
+  assert(evaluator.evaluate(mgr.getArith(x, mgr.getConst(9, 8, false),
+                                         BO_Shl), v) && v == 0);
+  assert(evaluator.evaluate(mgr.getUnary(x, UO_Minus), v) && v == 56);
+  assert(evaluator.evaluate(mgr.getLogical(x, zero, BO_SLT), v) && v == 1);
+  const SymExpr *elem = mgr.getElem(mgr.getElem(id, i),
+                                    mgr.getConst(1, indexWidth, false));
+  assert(evaluator.evaluate(elem, v) && v == 7);
+  assert(evaluator.evaluate(mgr.getTrunc(elem, 2), v) && v == 3);
+  assert(!evaluator.evaluate(mgr.getElem(id, i), v));
+  // A chain far deeper than a recursive evaluation could go.
+  const SymExpr *chain = x;
+  for (unsigned k = 0; k < 100000; ++k)
+    chain = mgr.getArith(chain, mgr.getConst(1, 8, false), BO_Add);
+  assert(evaluator.evaluate(chain, v) && v == (200 + 100000) % 256);
+
+  // Later queries on the same path are answered by earlier models.
+  ModelReuseSolverAdapter *adapter =
+    new ModelReuseSolverAdapter(new Z3Adapter(ctx, 1000));
+  const SymExpr *c5 = mgr.getConst(5, 8, false);
+  adapter->assertSymConstraint(SymConstraint(mgr.getLogical(x, c5, BO_UGT),
+                                             true));
+  SolverResult r = adapter->checkSat();
+  assert(r == SAT_Satisfiable);
+  SymModel first;
+  adapter->getModel(first);
+  assert(first.getScalar(1, v) && v > 5);
+  const SymExpr *eq = mgr.getLogical(x, mgr.getConst(v, 8, false), BO_EQ);
+  std::vector<SymConstraint> assumptions;
+  assumptions.push_back(SymConstraint(eq, true));
+  r = adapter->checkSatAssuming(assumptions);
+  assert(r == SAT_Satisfiable);
+  assert(adapter->getNumHits() == 1);
+  adapter->push();
+  adapter->assertSymConstraint(SymConstraint(eq, false));
+  r = adapter->checkSat();
+  assert(r == SAT_Satisfiable);
+  assert(adapter->getNumMisses() == 2);
+  SymModel second;
+  uint64_t v2 = 0;
+  adapter->getModel(second);
+  assert(second.getScalar(1, v2) && v2 > 5 && v2 != v);
+  adapter->pop();
+  r = adapter->checkSat();
+  assert(r == SAT_Satisfiable);
+  assert(adapter->getNumHits() == 2);
+  // A symbol the stored models do not mention evaluates to 0, and the model
+  // of the hit assigns it.
+  const SymExpr *y = mgr.getScalarSymbol(4, 8);
+  assumptions.assign(1, SymConstraint(mgr.getLogical(y, c5, BO_ULT), true));
+  r = adapter->checkSatAssuming(assumptions);
+  assert(r == SAT_Satisfiable);
+  assert(adapter->getNumHits() == 3);
+  SymModel third;
+  adapter->getModel(third);
+  assert(third.getScalar(4, v2) && v2 == 0);
+  llvm::errs() << "hits: " << adapter->getNumHits() << ", misses: "
+               << adapter->getNumMisses() << "\n";
+  delete adapter;
+  llvm::errs() << "\n";
+}
+
+static void traceQuery(const QueryStats &qs, void *data) {
+  static_cast<std::vector<QueryStats> *>(data)->push_back(qs);
+}
+
+void testSolverStats() {
+  llvm::errs() << "Test solver statistics. . .\n";
+  std::vector<QueryStats> trace;
+  SolverAdapter *adapter = CreateCachingSolverAdapter(new Z3Adapter(ctx, 1000));
+  adapter->setTraceHook(traceQuery, &trace);
+  adapter->setCollectBackendStats(true);
+
+  // x1 + 3 > x2
+  Z3Symbol x1(1, 32, false);
+  Z3Symbol x2(2, 32, false);
+  llvm::APInt v1(32, 3);
+  llvm::APSInt v2(v1, true);
+  Z3ConstExpr ce(&v2);
+  Z3ArithSymExpr add(&x1, &ce, BO_Add);
+  Z3LogicalSymExpr gt(&add, &x2, BO_UGT);
+  adapter->assertSymConstraint(SymConstraint(&gt, true));
+  SolverResult r = adapter->checkSat();
+  assert(r == SAT_Satisfiable);
+  assert(trace.size() == 1 && trace[0].result == SAT_Satisfiable);
+  assert(trace[0].numNodes == 5 && trace[0].numDecls == 2);
+  assert(!trace[0].backendStats.empty());
+
+  // Nothing new to translate.
+  std::vector<SymConstraint> assumptions;
+  assumptions.push_back(SymConstraint(&gt, false));
+  r = adapter->checkSatAssuming(assumptions);
+  assert(r == SAT_Unsatisfiable);
+  assert(trace.size() == 2 && trace[1].numNodes == 0);
+
+  // The layer reports the statistics of its backend.
+  const SolverStats &stats = adapter->getStats();
+  assert(stats.getNumQueries() == 2);
+  assert(stats.getNumResults(SAT_Satisfiable) == 1);
+  assert(stats.getNumResults(SAT_Unsatisfiable) == 1);
+  assert(stats.getNumNodes() == 5 && stats.getMaxDecls() == 2);
+  assert(stats.getSolveTimes().getCount() == 2);
+  assert(stats.getSolveTimes().getPercentile(100) >= stats.getSolveTimes().getMax());
+
+  LatencyHistogram h;
+  h.add(0.5);
+  h.add(3);
+  h.add(100);
+  h.add(1000);
+  assert(h.getPercentile(50) == 4 && h.getPercentile(75) == 128);
+  assert(h.getPercentile(100) == 1000);
+
+  std::stringstream ss;
+  stats.print(ss);
+  llvm::errs() << ss.str();
+  delete adapter;
+  llvm::errs() << "\n";
+}
+
+void testZ3Dump() {
+  llvm::errs() << "Test Z3 query dump. . .\n";
+  char dir[] = "/tmp/z3testXXXXXX";
+  const char *made = mkdtemp(dir);
+  assert(made);
+  Z3Adapter adapter(ctx, 1000);
+  adapter.setDumpDir(dir);
+
+  // x1 > 5, then x1 < 3 as an assumption.
+  Z3Symbol x1(1, 32, false);
+  llvm::APInt v1(32, 5), v2(32, 3);
+  llvm::APSInt v3(v1, true), v4(v2, true);
+  Z3ConstExpr c5(&v3), c3(&v4);
+  Z3LogicalSymExpr gt(&x1, &c5, BO_UGT);
+  Z3LogicalSymExpr lt(&x1, &c3, BO_ULT);
+  adapter.assertSymConstraint(SymConstraint(&gt, true));
+  SolverResult r = adapter.checkSat();
+  assert(r == SAT_Satisfiable);
+  std::vector<SymConstraint> assumptions;
+  assumptions.push_back(SymConstraint(&lt, true));
+  r = adapter.checkSatAssuming(assumptions);
+  assert(r == SAT_Unsatisfiable);
+
+  // Every check is a standalone query with its result appended.
+  std::vector<std::string> files;
+  DIR *d = opendir(dir);
+  while (struct dirent *ent = readdir(d))
+    if (ent->d_name[0] != '.')
+      files.push_back(std::string(dir) + "/" + ent->d_name);
+  closedir(d);
+  std::sort(files.begin(), files.end());
+  assert(files.size() == 2);
+  const char *results[] = { "sat", "unsat" };
+  for (unsigned i = 0; i < files.size(); ++i) {
+    std::ifstream in(files[i].c_str());
+    std::stringstream text;
+    text << in.rdbuf();
+    assert(text.str().find("(check-sat)") != std::string::npos);
+    assert(text.str().find(std::string("; result: ") + results[i] + "\n") !=
+           std::string::npos);
+    z3::context c;
+    std::string out = Z3_eval_smtlib2_string(c, text.str().c_str());
+    assert(out == std::string(results[i]) + "\n");
+    remove(files[i].c_str());
+  }
+  rmdir(dir);
+  llvm::errs() << "\n";
+}
+
+void testPersistentCache() {
+  llvm::errs() << "Test persistent query cache. . .\n";
+  char dir[] = "/tmp/z3testXXXXXX";
+  const char *made = mkdtemp(dir);
+  assert(made);
+  std::string path = std::string(dir) + "/queries";
+
+  // x1 + 3 > 5 in one run, y7 + 3 > 5 in the next one.
+  llvm::APInt v1(32, 3), v2(32, 5);
+  llvm::APSInt v3(v1, true), v4(v2, true);
+  Z3ConstExpr c3(&v3), c5(&v4);
+  Z3Symbol x1(1, 32, false), y7(7, 32, false);
+  Z3ArithSymExpr addX(&x1, &c3, BO_Add), addY(&y7, &c3, BO_Add);
+  Z3LogicalSymExpr gtX(&addX, &c5, BO_UGT), gtY(&addY, &c5, BO_UGT);
+  Z3LogicalSymExpr eqX(&x1, &c3, BO_EQ), eqY(&y7, &c3, BO_EQ);
+  std::vector<SymConstraint> assumeX, assumeY;
+  assumeX.push_back(SymConstraint(&eqX, false));
+  assumeY.push_back(SymConstraint(&eqY, false));
+
+  PersistentCacheSolverAdapter *first =
+    new PersistentCacheSolverAdapter(new Z3Adapter(ctx, 1000), path);
+  assert(first->isOpen());
+  first->assertSymConstraint(SymConstraint(&gtX, true));
+  SolverResult r = first->checkSat();
+  assert(r == SAT_Satisfiable);
+  r = first->checkSatAssuming(assumeX);
+  assert(r == SAT_Satisfiable);
+  QueryKey keyX = first->getQueryKey(assumeX);
+  first->assertSymConstraint(SymConstraint(&gtX, false));
+  r = first->checkSat();
+  assert(r == SAT_Unsatisfiable);
+  assert(first->getNumMisses() == 3 && first->getNumHits() == 0);
+  delete first;
+
+  PersistentCacheSolverAdapter *second =
+    new PersistentCacheSolverAdapter(new Z3Adapter(ctx, 1000), path);
+  second->assertSymConstraint(SymConstraint(&gtY, true));
+  assert(second->getQueryKey(assumeY) == keyX);
+  r = second->checkSat();
+  assert(r == SAT_Satisfiable);
+  SymModel m;
+  uint64_t v = 0;
+  second->getModel(m);
+  assert(m.getScalar(7, v) && ((v + 3) & 0xffffffff) > 5);
+  r = second->checkSatAssuming(assumeY);
+  assert(r == SAT_Satisfiable);
+  second->assertSymConstraint(SymConstraint(&gtY, false));
+  r = second->checkSat();
+  assert(r == SAT_Unsatisfiable);
+  assert(second->getNumHits() == 3 && second->getNumMisses() == 0);
+  delete second;
+
+  // A second process sees the records appended by the first, and a full
+  // store evicts its oldest records.
+  PersistentQueryStore writer(path + "2", 4096), reader(path + "2", 4096);
+  SymModel model, out;
+  for (uint64_t i = 0; i < 200; ++i) {
+    QueryKey key = {{ i, ~i }};
+    model.setScalar(0, i);
+    writer.insert(key, SAT_Satisfiable, model);
+    assert(reader.lookup(key, r, out) && r == SAT_Satisfiable);
+    assert(out.getScalar(0, v) && v == i);
+  }
+  QueryKey oldest = {{ 0, ~(uint64_t)0 }};
+  assert(writer.getNumCompactions() > 0);
+  assert(!reader.lookup(oldest, r, out));
+  llvm::errs() << "records: " << reader.getNumRecords() << ", compactions: "
+               << writer.getNumCompactions() << "\n";
+
+  std::string files[] = { "", ".lock", "2", "2.lock" };
+  for (unsigned i = 0; i < 4; ++i)
+    remove((path + files[i]).c_str());
+  rmdir(dir);
+  llvm::errs() << "\n";
+}
+
+void testAsyncCheckSat() {
+  llvm::errs() << "Test asynchronous checks. . .\n";
+  Z3Config cfg;
+  cfg.timeout = 60000;
+  AsyncSolverAdapter adapter(new Z3Adapter(ctx, cfg), 2);
+
+  // x1 > 5, then x1 < 3 in a scope while the first check may still run.
+  llvm::APInt v1(32, 5), v2(32, 3);
+  llvm::APSInt v3(v1, true), v4(v2, true);
+  Z3ConstExpr c5(&v3), c3(&v4);
+  Z3Symbol x1(1, 32, false);
+  Z3LogicalSymExpr gt(&x1, &c5, BO_UGT), lt(&x1, &c3, BO_ULT);
+  adapter.assertSymConstraint(SymConstraint(&gt, true));
+  SolverFuture f1 = adapter.checkSatAsync(std::vector<SymConstraint>());
+  adapter.push();
+  adapter.assertSymConstraint(SymConstraint(&lt, true));
+  SolverFuture f2 = adapter.checkSatAsync(std::vector<SymConstraint>());
+  adapter.pop();
+  assert(adapter.getNumOutstanding() <= adapter.getMaxOutstanding());
+  SolverResult r = f1.wait();
+  assert(r == SAT_Satisfiable);
+  r = f2.wait();
+  assert(r == SAT_Unsatisfiable);
+  uint64_t v = 0;
+  assert(f1.getModel().getScalar(1, v) && v > 5);
+  std::vector<SymConstraint> assumptions(1, SymConstraint(&lt, true));
+  SolverFuture f3 = adapter.checkSatAsync(assumptions);
+  r = f3.wait();
+  assert(r == SAT_Unsatisfiable);
+  assert(f3.getFailedAssumptions().size() == 1);
+
+  // Factor a 63 bit prime, which takes far beyond the timeout. The queued check is
+  // cancelled before it starts, the running one is interrupted.
+  llvm::APInt p1(64, 9223372036854775783ULL), p2(64, 1ULL << 32),
+    p3(64, 1);
+  llvm::APSInt v5(p1, true), v6(p2, true), v7(p3, true);
+  Z3ConstExpr n(&v5), bound(&v6), one(&v7);
+  Z3Symbol y1(11, 64, false), y2(12, 64, false);
+  Z3ArithSymExpr mul(&y1, &y2, BO_Mul);
+  Z3LogicalSymExpr eq(&mul, &n, BO_EQ);
+  Z3LogicalSymExpr y1Lo(&y1, &one, BO_UGT), y2Lo(&y2, &one, BO_UGT);
+  Z3LogicalSymExpr y1Hi(&y1, &bound, BO_ULT), y2Hi(&y2, &bound, BO_ULT);
+  adapter.push();
+  adapter.assertSymConstraint(SymConstraint(&eq, true));
+  adapter.assertSymConstraint(SymConstraint(&y1Lo, true));
+  adapter.assertSymConstraint(SymConstraint(&y2Lo, true));
+  adapter.assertSymConstraint(SymConstraint(&y1Hi, true));
+  adapter.assertSymConstraint(SymConstraint(&y2Hi, true));
+  Timer timer;
+  SolverFuture hard = adapter.checkSatAsync(std::vector<SymConstraint>());
+  SolverFuture queued = adapter.checkSatAsync(std::vector<SymConstraint>());
+  assert(adapter.getNumOutstanding() == 2);
+  queued.cancel();
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  assert(!hard.ready());
+  hard.cancel();
+  r = hard.wait();
+  assert(r == SAT_Undetermined || r == SAT_Timeout);
+  r = queued.wait();
+  assert(r == SAT_Undetermined);
+  assert(timer.getMicroseconds() < 10e6);
+  adapter.pop();
+
+  // The backend is usable after the interrupt.
+  r = adapter.checkSat();
+  assert(r == SAT_Satisfiable);
+  SymModel m;
+  adapter.getModel(m);
+  assert(m.getScalar(1, v) && v > 5);
+  llvm::errs() << "cancelled after " << timer.getMicroseconds() / 1000
+               << "ms\n";
+
+  // A cancel that comes as a check finishes does not reach the next one.
+  for (unsigned i = 0; i < 100; ++i) {
+    SolverFuture f = adapter.checkSatAsync(std::vector<SymConstraint>());
+    while (!f.ready())
+      f.cancel();
+    SolverFuture next = adapter.checkSatAsync(assumptions);
+    r = next.wait();
+    assert(r == SAT_Unsatisfiable);
+  }
+  // The jobs after the cancelled ones all reached the backend, whose
+  // statistics are read from a snapshot taken after each check.
+  uint64_t numQueries = adapter.getStats().getNumQueries();
+  assert(numQueries >= 100);
+
+  // Adapters without a worker answer before checkSatAsync() returns.
+  Z3Adapter z3(ctx, 1000);
+  z3.assertSymConstraint(SymConstraint(&gt, true));
+  SolverFuture f4 = z3.checkSatAsync(assumptions);
+  assert(f4.ready());
+  r = f4.wait();
+  assert(r == SAT_Unsatisfiable);
+  llvm::errs() << "\n";
+}
+
+namespace {
+
+// x == i for the i-th query of thread t, with x > t, which is unsat for
+// i <= t. The expressions live as long as the pool, whose adapters cache
+// their translations.
+struct PoolClient {
+  SolverPool *pool;
+  unsigned t;
+  unsigned numErrors;
+  Z3Symbol *x;
+  std::vector<llvm::APSInt *> values;
+  std::vector<Z3ConstExpr *> consts;
+  std::vector<Z3LogicalSymExpr *> exprs;
+
+  PoolClient() : pool(0), t(0), numErrors(0), x(0) {}
+  ~PoolClient() {
+    for (unsigned i = 0; i < exprs.size(); ++i)
+      delete exprs[i];
+    for (unsigned i = 0; i < consts.size(); ++i) {
+      delete consts[i];
+      delete values[i];
+    }
+    delete x;
+  }
+
+  void operator()() {
+    x = new Z3Symbol(100 + t, 32, false);
+    for (unsigned i = 0; i < 8; ++i) {
+      values.push_back(new llvm::APSInt(llvm::APInt(32, i), true));
+      consts.push_back(new Z3ConstExpr(values.back()));
+    }
+    exprs.push_back(new Z3LogicalSymExpr(x, consts[t], BO_UGT));
+    std::vector<SymConstraint> prefix(1, SymConstraint(exprs[0], true));
+    std::vector<SolverFuture> futures;
+    for (unsigned i = 0; i < 8; ++i) {
+      exprs.push_back(new Z3LogicalSymExpr(x, consts[i], BO_EQ));
+      std::vector<SymConstraint> assumptions(1,
+                                             SymConstraint(exprs.back(), true));
+      futures.push_back(pool->submit(prefix, assumptions));
+    }
+    for (unsigned i = 0; i < 8; ++i) {
+      SolverResult want = i > t ? SAT_Satisfiable : SAT_Unsatisfiable;
+      numErrors += futures[i].wait() != want;
+    }
+
+    // The same through a checked out adapter.
+    SolverAdapter *adapter = pool->checkout();
+    adapter->assertSymConstraint(prefix[0]);
+    for (unsigned i = 0; i < 8; ++i) {
+      SolverResult want = i > t ? SAT_Satisfiable : SAT_Unsatisfiable;
+      std::vector<SymConstraint> assumptions(1,
+                                             SymConstraint(exprs[i + 1], true));
+      numErrors += adapter->checkSatAssuming(assumptions) != want;
+    }
+    pool->checkin(adapter);
+  }
+};
+
+}
+
+void testSolverPool() {
+  llvm::errs() << "Test solver pool. . .\n";
+  SolverPool pool(ctx, 3);
+
+  // Checked in adapters drop their constraints, and a thread gets the
+  // adapter it had before.
+  llvm::APInt v1(32, 5), v2(32, 3);
+  llvm::APSInt v3(v1, true), v4(v2, true);
+  Z3ConstExpr c5(&v3), c3(&v4);
+  Z3Symbol x1(1, 32, false);
+  Z3LogicalSymExpr gt(&x1, &c5, BO_UGT), lt(&x1, &c3, BO_ULT);
+  SolverAdapter *a = pool.checkout();
+  a->assertSymConstraint(SymConstraint(&gt, true));
+  a->assertSymConstraint(SymConstraint(&lt, true));
+  SolverResult r = a->checkSat();
+  assert(r == SAT_Unsatisfiable);
+  pool.checkin(a);
+  SolverAdapter *b = pool.checkout();
+  assert(b == a);
+  r = b->checkSat();
+  assert(r == SAT_Satisfiable);
+  assert(pool.getNumAffinityHits() == 2);
+
+  // While this thread holds its adapter, the other ones steal the queries
+  // it submits.
+  std::vector<SymConstraint> prefix(1, SymConstraint(&gt, true));
+  std::vector<SymConstraint> assumptions(1, SymConstraint(&lt, true));
+  SolverFuture f1 = pool.submit(prefix);
+  SolverFuture f2 = pool.submit(prefix, assumptions);
+  r = f1.wait();
+  assert(r == SAT_Satisfiable);
+  r = f2.wait();
+  assert(r == SAT_Unsatisfiable);
+  assert(pool.getNumSteals() == 2);
+  pool.checkin(b);
+
+  // Several threads at once.
+  PoolClient clients[6];
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < 6; ++t) {
+    clients[t].pool = &pool;
+    clients[t].t = t;
+    threads.push_back(std::thread(std::ref(clients[t])));
+  }
+  for (unsigned t = 0; t < 6; ++t) {
+    threads[t].join();
+    assert(clients[t].numErrors == 0);
+  }
+  llvm::errs() << "checkouts: " << pool.getNumCheckouts()
+               << ", affinity hits: " << pool.getNumAffinityHits()
+               << ", steals: " << pool.getNumSteals() << "\n";
+
+  // Adapters sharing a query cache see each other's answers.
+  char dir[] = "/tmp/z3testXXXXXX";
+  const char *made = mkdtemp(dir);
+  assert(made);
+  std::string path = std::string(dir) + "/queries";
+  {
+    SolverPool cached(ctx, 2, 0, 0, path.c_str());
+    r = cached.submit(prefix).wait();
+    assert(r == SAT_Satisfiable);
+    SolverAdapter *c = cached.checkout();
+    c->assertSymConstraint(prefix[0]);
+    r = c->checkSat();
+    assert(r == SAT_Satisfiable);
+    assert(static_cast<PersistentCacheSolverAdapter *>(c)->getNumHits() == 1);
+    cached.checkin(c);
+  }
+  remove(path.c_str());
+  remove((path + ".lock").c_str());
+  rmdir(dir);
+  llvm::errs() << "\n";
+}
+
+void testZ3Recycle() {
+  llvm::errs() << "Test Z3 context recycling. . .\n";
+  Z3Config cfg;
+  cfg.timeout = 1000;
+  cfg.maxChecks = 2;
+  Z3Adapter adapter(ctx, cfg);
+
+  // x1 > 5, then x1 < 100 in a scope, and an empty scope on top.
+  llvm::APInt v1(32, 5), v2(32, 100), v3(32, 3), v4(32, 50), v5(32, 200);
+  llvm::APSInt a1(v1, true), a2(v2, true), a3(v3, true), a4(v4, true),
+    a5(v5, true);
+  Z3ConstExpr c5(&a1), c100(&a2), c3(&a3), c50(&a4), c200(&a5);
+  Z3Symbol x1(1, 32, false);
+  Z3LogicalSymExpr gt(&x1, &c5, BO_UGT), lt(&x1, &c100, BO_ULT);
+  Z3LogicalSymExpr eq3(&x1, &c3, BO_EQ), eq50(&x1, &c50, BO_EQ),
+    eq200(&x1, &c200, BO_EQ);
+  adapter.assertSymConstraint(SymConstraint(&gt, true));
+  adapter.push();
+  adapter.assertSymConstraint(SymConstraint(&lt, true));
+  adapter.push();
+  SolverResult r = adapter.checkSat();
+  assert(r == SAT_Satisfiable);
+  std::vector<SymConstraint> assumptions(1, SymConstraint(&eq3, true));
+  r = adapter.checkSatAssuming(assumptions);
+  assert(r == SAT_Unsatisfiable);
+  assert(adapter.getNumRecycles() == 0);
+
+  // The third check runs in a new context with the same constraints.
+  assumptions[0] = SymConstraint(&eq50, true);
+  r = adapter.checkSatAssuming(assumptions);
+  assert(r == SAT_Satisfiable);
+  assert(adapter.getNumRecycles() == 1 && adapter.getNumScopes() == 2);
+  SymModel m;
+  uint64_t v = 0;
+  adapter.getModel(m);
+  assert(m.getScalar(1, v) && v == 50);
+  assumptions[0] = SymConstraint(&eq200, true);
+  r = adapter.checkSatAssuming(assumptions);
+  assert(r == SAT_Unsatisfiable);
+  std::vector<SymConstraint> failed;
+  adapter.getFailedAssumptions(failed);
+  assert(failed.size() == 1 && failed[0].cond == &eq200);
+
+  // Popping in the new context drops x1 < 100.
+  adapter.pop(2);
+  r = adapter.checkSatAssuming(assumptions);
+  assert(r == SAT_Satisfiable);
+  assert(adapter.getNumRecycles() == 2);
+
+  // The memory limit is on the growth since the first check in a context.
+  // Z3 reports the memory of the whole process, which the other tests
+  // change too, so only check that many constraints grow it past the limit.
+  cfg.maxChecks = 0;
+  cfg.maxMemory = 1;
+  Z3Adapter small(ctx, cfg);
+  small.assertSymConstraint(SymConstraint(&gt, true));
+  r = small.checkSat();
+  assert(r == SAT_Satisfiable);
+  std::deque<llvm::APSInt> values;
+  std::deque<Z3ConstExpr> consts;
+  std::deque<Z3LogicalSymExpr> nes;
+  small.push();
+  for (unsigned i = 0; i < 5000; ++i) {
+    values.push_back(llvm::APSInt(llvm::APInt(32, 1000 + i), true));
+    consts.push_back(Z3ConstExpr(&values.back()));
+    nes.push_back(Z3LogicalSymExpr(&x1, &consts.back(), BO_NE));
+    small.assertSymConstraint(SymConstraint(&nes.back(), true));
+  }
+  for (unsigned i = 0; i < 3; ++i) {
+    r = small.checkSat();
+    assert(r == SAT_Satisfiable);
+  }
+  assert(small.getNumRecycles() > 0);
+  llvm::errs() << "\n";
+}
+
+namespace {
+
+// Resident set size in megabytes.
+double getRSS() {
+  std::ifstream in("/proc/self/statm");
+  unsigned long size = 0, resident = 0;
+  in >> size >> resident;
+  return resident * (double)sysconf(_SC_PAGESIZE) / (1 << 20);
+}
+
+}
+
+void testZ3RecycleStress() {
+  llvm::errs() << "Test Z3 context recycling under stress. . .\n";
+  Z3Config cfg;
+  cfg.timeout = 1000;
+  cfg.maxChecks = 10000;
+  Z3Adapter adapter(ctx, cfg);
+  llvm::APInt v1(32, 5);
+  llvm::APSInt a1(v1, true);
+  Z3ConstExpr c5(&a1);
+
+  // Every query has a new symbol, whose name stays in the context.
+  const unsigned numQueries = 1000000;
+  double first = 0;
+  for (unsigned i = 0; i < numQueries; ++i) {
+    Z3Symbol x(i, 32, false);
+    Z3ArithSymExpr add(&x, &c5, BO_Add);
+    Z3LogicalSymExpr gt(&add, &c5, BO_UGT);
+    adapter.assertSymConstraint(SymConstraint(&gt, true));
+    SolverResult r = adapter.checkSat();
+    assert(r == SAT_Satisfiable);
+    adapter.reset();
+    if ((i + 1) % 100000 == 0) {
+      double rss = getRSS();
+      if (!first)
+        first = rss;
+      llvm::errs() << i + 1 << " queries, " << adapter.getNumRecycles()
+                   << " recycles, RSS " << (unsigned)rss << "MB\n";
+    }
+  }
+  assert(getRSS() < first * 1.5);
+  llvm::errs() << "\n";
+}
+
+void testZ3DeepChain() {
+  llvm::errs() << "Test Z3 translation of deep chains. . .\n";
+  Z3Adapter adapter(ctx, 10000);
+
+  // ((x1 + 1) ^ 1) + 1 ... far deeper than a recursive translation could
+  // go, truncated, extended and compared, as a long loop leaves it.
+  const unsigned depth = 200000;
+  llvm::APInt v1(32, 1), v2(32, 0);
+  llvm::APSInt a1(v1, true), a2(v2, true);
+  Z3ConstExpr one(&a1), zero(&a2);
+  Z3Symbol x1(1, 32, false);
+  std::deque<Z3ArithSymExpr> chain;
+  const SymExpr *e = &x1;
+  for (unsigned i = 0; i < depth; ++i) {
+    chain.push_back(Z3ArithSymExpr(e, &one, i % 2 ? BO_Xor : BO_Add));
+    e = &chain.back();
+  }
+  Z3TruncSymExpr trunc(8, e);
+  Z3ExtendSymExpr ext(32, false, &trunc);
+  Z3LogicalSymExpr eq(&ext, &zero, BO_EQ);
+
+  z3::expr z = adapter.genZ3Expr(&eq);
+  z3::expr zext = adapter.genZ3Expr(&ext);
+  assert(z.is_bool() && zext.get_sort().bv_size() == 32);
+  // Every node is translated once; the later uses of the constant and the
+  // second lookup of ext hit the cache.
+  assert(adapter.getExprCacheMisses() == depth + 6);
+  assert(adapter.getExprCacheHits() == depth);
+  llvm::errs() << "\n";
+}
+
+void testDeclTable() {
+  llvm::errs() << "Test declaration table. . .\n";
+  DeclTable<unsigned> table;
+
+  // Dense IDs go to the vector, far ones to the hash table.
+  for (unsigned id = 0; id < 1000; ++id)
+    table.insert(id, id * 2);
+  for (unsigned i = 1; i <= 100; ++i)
+    table.insert(i * 1000003u, i);
+  assert(table.size() == 1100);
+  for (unsigned id = 0; id < 1000; ++id)
+    assert(table.lookup(id) && *table.lookup(id) == id * 2);
+  for (unsigned i = 1; i <= 100; ++i)
+    assert(table.lookup(i * 1000003u) && *table.lookup(i * 1000003u) == i);
+  assert(!table.lookup(1000) && !table.lookup(7 * 1000003u + 1));
+
+  // Iteration follows insertion.
+  unsigned n = 0;
+  for (DeclTable<unsigned>::const_iterator it = table.begin(),
+         ie = table.end(); it != ie; ++it, ++n)
+    assert(it->first == (n < 1000 ? n : (n - 999) * 1000003u));
+
+  table.clear();
+  assert(table.size() == 0 && !table.lookup(5) && !table.lookup(1000003u));
+  table.insert(1000003u, 7);
+  assert(*table.lookup(1000003u) == 7);
+
+  // A declared symbol is named as before.
+  Z3Symbol x(4294967295u, 32, false);
+  SymbolNames names;
+  assert(std::string(names.get(&x)) == "$4294967295");
+  assert(std::string(names.get(&x)) == x.getSymName());
+  llvm::errs() << "\n";
+}
+
+void testCheckSatBatch() {
+  llvm::errs() << "Test batch checks. . .\n";
+  Z3Adapter adapter(ctx, 1000);
+
+  // x1 < 10 asserted, prefix x1 > 2. Candidates: x1 > 20 (infeasible),
+  // x1 < 100 (holds in any model of the prefix), x1 == 4, x1 != 4.
+  llvm::APInt v1(32, 10), v2(32, 2), v3(32, 20), v4(32, 100), v5(32, 4);
+  llvm::APSInt a1(v1, true), a2(v2, true), a3(v3, true), a4(v4, true),
+    a5(v5, true);
+  Z3ConstExpr c10(&a1), c2(&a2), c20(&a3), c100(&a4), c4(&a5);
+  Z3Symbol x1(1, 32, false);
+  Z3LogicalSymExpr lt10(&x1, &c10, BO_ULT), gt2(&x1, &c2, BO_UGT),
+    gt20(&x1, &c20, BO_UGT), lt100(&x1, &c100, BO_ULT),
+    eq4(&x1, &c4, BO_EQ);
+  adapter.assertSymConstraint(SymConstraint(&lt10, true));
+  std::vector<SymConstraint> prefix(1, SymConstraint(&gt2, true));
+  std::vector<SymConstraint> candidates;
+  candidates.push_back(SymConstraint(&eq4, true));
+  candidates.push_back(SymConstraint(&gt20, true));
+  candidates.push_back(SymConstraint(&lt100, true));
+  candidates.push_back(SymConstraint(&eq4, false));
+
+  // The model of x1 == 4 settles x1 < 100; x1 != 4 needs its own check.
+  uint64_t before = adapter.getStats().getNumQueries();
+  std::vector<SolverResult> results = adapter.checkSatBatch(prefix,
+                                                            candidates);
+  assert(results.size() == 4);
+  assert(results[0] == SAT_Satisfiable && results[1] == SAT_Unsatisfiable &&
+         results[2] == SAT_Satisfiable && results[3] == SAT_Satisfiable);
+  assert(adapter.getStats().getNumQueries() - before == 3);
+  // The prefix is gone again.
+  assert(adapter.getNumScopes() == 0);
+  std::vector<SymConstraint> assumptions(1, SymConstraint(&gt2, false));
+  SolverResult r = adapter.checkSatAssuming(assumptions);
+  assert(r == SAT_Satisfiable);
+
+  // Spread over a pool, where the prefix is the whole query.
+  SolverPool pool(ctx, 2);
+  prefix.push_back(SymConstraint(&lt10, true));
+  results = pool.checkSatBatch(prefix, candidates);
+  assert(results[0] == SAT_Satisfiable && results[1] == SAT_Unsatisfiable &&
+         results[2] == SAT_Satisfiable && results[3] == SAT_Satisfiable);
+  llvm::errs() << "\n";
+}
+
+void testIntervalSolver() {
+  llvm::errs() << "Test interval pre-solver. . .\n";
+  IntervalSolverAdapter adapter(new Z3Adapter(ctx, 1000));
+  SymExprManager mgr(ctx);
+  const SymExpr *x = mgr.getScalarSymbol(1, 32);
+  const SymExpr *y = mgr.getScalarSymbol(2, 8);
+
+  // 5 <u x <u 10, x != 6, x != 7: the witness is 8.
+  adapter.assertSymConstraint(SymConstraint(
+    mgr.getLogical(mgr.getConst(5, 32, false), x, BO_ULT), true));
+  adapter.assertSymConstraint(SymConstraint(
+    mgr.getLogical(x, mgr.getConst(10, 32, false), BO_UGE), false));
+  adapter.assertSymConstraint(SymConstraint(
+    mgr.getLogical(x, mgr.getConst(6, 32, false), BO_NE), true));
+  adapter.assertSymConstraint(SymConstraint(
+    mgr.getLogical(x, mgr.getConst(7, 32, false), BO_EQ), false));
+  SolverResult r = adapter.checkSat();
+  assert(r == SAT_Satisfiable);
+  SymModel m;
+  uint64_t v = 0;
+  adapter.getModel(m);
+  assert(m.getScalar(1, v) && v == 8);
+
+  // Also x <s 0, which is x >=u 2^31: UNSAT, caused by the assumption.
+  std::vector<SymConstraint> assumptions;
+  assumptions.push_back(SymConstraint(
+    mgr.getLogical(y, mgr.getConst(3, 8, false), BO_EQ), true));
+  const SymExpr *neg = mgr.getLogical(x, mgr.getConst(0, 32, true), BO_SLT);
+  assumptions.push_back(SymConstraint(neg, true));
+  r = adapter.checkSatAssuming(assumptions);
+  assert(r == SAT_Unsatisfiable);
+  std::vector<SymConstraint> failed;
+  adapter.getFailedAssumptions(failed);
+  assert(failed.size() == 1 && failed[0].cond == neg);
+  assert(adapter.getNumDecided() == 2);
+
+  // In a scope: -3 <s y <s 2 and y >u 1 leave 0xfe and 0xff.
+  adapter.push();
+  const SymExpr *range = mgr.getLogical(
+    mgr.getLogical(y, mgr.getConst(0xfd, 8, true), BO_SGT),
+    mgr.getLogical(y, mgr.getConst(2, 8, true), BO_SLT), BO_LAnd);
+  adapter.assertSymConstraint(SymConstraint(range, true));
+  adapter.assertSymConstraint(SymConstraint(
+    mgr.getUnary(mgr.getLogical(y, mgr.getConst(1, 8, false), BO_ULE),
+                 UO_LNot), true));
+  r = adapter.checkSat();
+  assert(r == SAT_Satisfiable);
+  adapter.getModel(m);
+  assert(m.getScalar(2, v) && v == 0xfe);
+  assert(adapter.getNumDecided() == 3);
+
+  // x + y is outside the fragment and goes to Z3, unless the comparisons
+  // are UNSAT on their own.
+  const SymExpr *sum = mgr.getLogical(
+    mgr.getArith(x, mgr.getExtend(y, 32, false), BO_Add),
+    mgr.getConst(200, 32, false), BO_UGT);
+  adapter.assertSymConstraint(SymConstraint(sum, true));
+  r = adapter.checkSat();
+  assert(r == SAT_Satisfiable);
+  assert(adapter.getNumDecided() == 3);
+  assumptions.assign(1, SymConstraint(
+    mgr.getLogical(y, mgr.getConst(0xff, 8, false), BO_NE), true));
+  assumptions.push_back(SymConstraint(
+    mgr.getLogical(y, mgr.getConst(0xfe, 8, false), BO_NE), true));
+  r = adapter.checkSatAssuming(assumptions);
+  assert(r == SAT_Unsatisfiable);
+  assert(adapter.getNumDecided() == 4);
+  adapter.pop();
+  r = adapter.checkSat();
+  assert(r == SAT_Satisfiable);
+
+  llvm::errs() << "decided " << adapter.getNumDecided() << " of "
+               << adapter.getNumQueries() << " queries\n\n";
+}
+
+void testArrayElimination() {
+  llvm::errs() << "Test array elimination. . .\n";
+  ArrayEliminatingSolverAdapter adapter(new Z3Adapter(ctx, 1000));
+  SymExprManager mgr(ctx);
+  unsigned iw = ctx.getArrayIndexTypeSizeInBits();
+  const SymExpr *a = mgr.getRegionSymbol(10, 32, 1);
+  const SymExpr *x = mgr.getScalarSymbol(1, iw);
+  const SymExpr *y = mgr.getScalarSymbol(2, iw);
+  const SymExpr *a0 = mgr.getElem(a, mgr.getConst(0, iw, false));
+  const SymExpr *a1 = mgr.getElem(a, mgr.getConst(1, iw, false));
+  const SymExpr *ax = mgr.getElem(a, x);
+  const SymExpr *ay = mgr.getElem(a, y);
+
+  // a[0] == 5, a[1] == 7, a[x] == 9: x is neither 0 nor 1.
+  adapter.assertSymConstraint(SymConstraint(
+    mgr.getLogical(a0, mgr.getConst(5, 32, false), BO_EQ), true));
+  adapter.assertSymConstraint(SymConstraint(
+    mgr.getLogical(a1, mgr.getConst(7, 32, false), BO_EQ), true));
+  adapter.assertSymConstraint(SymConstraint(
+    mgr.getLogical(ax, mgr.getConst(9, 32, false), BO_EQ), true));
+  SolverResult r = adapter.checkSat();
+  assert(r == SAT_Satisfiable);
+  assert(adapter.getNumEliminated() == 3 && adapter.getNumAckermann() == 2);
+  SymModel m;
+  uint64_t v = 0;
+  adapter.getModel(m);
+  assert(m.getScalar(1, v) && v != 0 && v != 1);
+  const ArrayValue *av = m.getArray(10);
+  assert(av && av->getValue(ArrayValue::Index(1, 0)) == 5 &&
+         av->getValue(ArrayValue::Index(1, 1)) == 7 &&
+         av->getValue(ArrayValue::Index(1, v)) == 9);
+  // No fresh symbol shows up in the model.
+  assert(m.getScalars().size() == 1);
+
+  std::vector<SymConstraint> assumptions(1, SymConstraint(
+    mgr.getLogical(x, mgr.getConst(1, iw, false), BO_EQ), true));
+  r = adapter.checkSatAssuming(assumptions);
+  assert(r == SAT_Unsatisfiable);
+  std::vector<SymConstraint> failed;
+  adapter.getFailedAssumptions(failed);
+  assert(failed.size() == 1 && failed[0] == assumptions[0]);
+
+  // a[y] == 5 with y == x contradicts a[x] == 9.
+  adapter.push();
+  adapter.assertSymConstraint(SymConstraint(
+    mgr.getLogical(ay, mgr.getConst(5, 32, false), BO_EQ), true));
+  r = adapter.checkSat();
+  assert(r == SAT_Satisfiable);
+  adapter.assertSymConstraint(SymConstraint(
+    mgr.getLogical(x, y, BO_EQ), true));
+  r = adapter.checkSat();
+  assert(r == SAT_Unsatisfiable);
+  assert(adapter.getNumReads() == 4);
+  adapter.pop();
+  assert(adapter.getNumReads() == 3);
+  r = adapter.checkSat();
+  assert(r == SAT_Satisfiable);
+
+  // Past one symbolic read, the region is linked to the array.
+  ArrayEliminatingSolverAdapter linked(new Z3Adapter(ctx, 1000), 1);
+  linked.assertSymConstraint(SymConstraint(
+    mgr.getLogical(ax, mgr.getConst(3, 32, false), BO_EQ), true));
+  linked.assertSymConstraint(SymConstraint(
+    mgr.getLogical(ay, mgr.getConst(4, 32, false), BO_EQ), true));
+  r = linked.checkSat();
+  assert(r == SAT_Satisfiable);
+  assert(linked.getNumEliminated() == 1);
+  linked.getModel(m);
+  uint64_t vy = 0;
+  assert(m.getScalar(1, v) && m.getScalar(2, vy) && v != vy);
+  av = m.getArray(10);
+  assert(av && av->getValue(ArrayValue::Index(1, v)) == 3 &&
+         av->getValue(ArrayValue::Index(1, vy)) == 4);
+  assumptions.assign(1, SymConstraint(mgr.getLogical(x, y, BO_EQ), true));
+  r = linked.checkSatAssuming(assumptions);
+  assert(r == SAT_Unsatisfiable);
+  llvm::errs() << "\n";
+}
+
+namespace {
+
+// Count the symbol occurrences of a tree; the other kinds fall back to
+// visitSymExpr().
+class SymbolCounter : public SymExprVisitor<SymbolCounter, unsigned> {
+public:
+  unsigned visitSymbol(const Symbol *) { return 1; }
+  unsigned visitConstExpr(const ConstExpr *) { return 0; }
+  unsigned visitSymExpr(const SymExpr *e) {
+    const SymExpr *ops[2];
+    unsigned n = 0;
+    for (unsigned i = getSymExprOperands(e, ops); i > 0; --i)
+      n += visit(ops[i - 1]);
+    return n;
+  }
+};
+
+// A symbol that counts the calls to getTypeSizeInBits().
+class CountingSymbol : public ScalarSymbol {
+public:
+  CountingSymbol(unsigned id, unsigned size)
+    : ScalarSymbol(id), bitsize(size), numCalls(0) {}
+
+  virtual unsigned getTypeSizeInBits(SolverContext &) const {
+    ++numCalls;
+    return bitsize;
+  }
+
+  unsigned bitsize;
+  mutable unsigned numCalls;
+};
+
+}
+
+void testSymExprVisitor() {
+  llvm::errs() << "Test SymExpr visitor. . .\n";
+  SymExprManager mgr(ctx);
+  unsigned iw = ctx.getArrayIndexTypeSizeInBits();
+  const SymExpr *x = mgr.getScalarSymbol(1, 32);
+  const SymExpr *a = mgr.getRegionSymbol(2, 32, 1);
+  const SymExpr *e = mgr.getLogical(
+    mgr.getArith(x, mgr.getElem(a, mgr.getScalarSymbol(3, iw)), BO_Add),
+    mgr.getExtend(mgr.getTrunc(x, 8), 32, true), BO_ULT);
+  SymbolCounter counter;
+  assert(counter.visit(e) == 4);
+  assert(counter.visit(mgr.getConst(1, 32, false)) == 0);
+
+  const SymExpr *ops[2] = { 0, 0 };
+  assert(getSymExprOperands(e, ops) == 2 && LogicalSymExpr::classof(e));
+  assert(ArithSymExpr::classof(ops[0]) && ExtendSymExpr::classof(ops[1]));
+  assert(getSymExprOperands(x, ops) == 0);
+
+  // The width is asked for once, then cached in the node.
+  CountingSymbol sym(4, 16);
+  assert(sym.getBitWidth(ctx) == 16 && sym.getBitWidth(ctx) == 16);
+  assert(sym.numCalls == 1);
+  assert(sizeof(SymExpr) <= 2 * sizeof(void *));
+
+  // Translation goes through the cached width too.
+  Z3Adapter adapter(ctx);
+  LogicalSymExpr cmp(&sym, mgr.getConst(7, 16, false), BO_EQ);
+  adapter.assertSymConstraint(SymConstraint(&cmp, true));
+  SolverResult r = adapter.checkSat();
+  assert(r == SAT_Satisfiable);
+  assert(sym.numCalls == 1);
+  llvm::errs() << "\n";
+}
+
+void testBitBlastAdapter() {
+  llvm::errs() << "Test BitBlastAdapter. . .\n";
+  BitBlastAdapter adapter(ctx);
+  SymExprManager mgr(ctx);
+  const SymExpr *x = mgr.getScalarSymbol(1, 16);
+  const SymExpr *y = mgr.getScalarSymbol(2, 16);
+
+  // x * y == 1001 with x, y > 1; x < y in a scope.
+  const SymExpr *one = mgr.getConst(1, 16, false);
+  adapter.assertSymConstraint(SymConstraint(mgr.getLogical(
+    mgr.getArith(x, y, BO_Mul), mgr.getConst(1001, 16, false), BO_EQ), true));
+  adapter.assertSymConstraint(SymConstraint(
+    mgr.getLogical(x, one, BO_UGT), true));
+  adapter.assertSymConstraint(SymConstraint(
+    mgr.getLogical(y, one, BO_UGT), true));
+  adapter.push();
+  adapter.assertSymConstraint(SymConstraint(
+    mgr.getLogical(x, y, BO_ULT), true));
+  SolverResult r = adapter.checkSat();
+  assert(r == SAT_Satisfiable);
+  SymModel model;
+  uint64_t xv = 0, yv = 0;
+  adapter.getModel(model);
+  assert(model.getScalar(1, xv) && model.getScalar(2, yv));
+  assert((uint16_t)(xv * yv) == 1001 && xv > 1 && xv < yv);
+
+  // The failed assumption, and the scope constraint gone after pop().
+  std::vector<SymConstraint> assumptions(1, SymConstraint(
+    mgr.getLogical(x, y, BO_UGT), true));
+  r = adapter.checkSatAssuming(assumptions);
+  assert(r == SAT_Unsatisfiable);
+  std::vector<SymConstraint> failed;
+  adapter.getFailedAssumptions(failed);
+  assert(failed.size() == 1 && failed[0] == assumptions[0]);
+  adapter.pop();
+  r = adapter.checkSatAssuming(assumptions);
+  assert(r == SAT_Satisfiable);
+  adapter.getModel(model);
+  assert(model.getScalar(1, xv) && model.getScalar(2, yv) && xv > yv);
+
+  // Every operator against the evaluator, on 8 bit constants.
+  const ArithOpcode ops[] = { BO_Mul, BO_SDiv, BO_UDiv, BO_SRem, BO_URem,
+                              BO_Add, BO_Sub, BO_Shl, BO_Shr, BO_And,
+                              BO_Xor, BO_Or };
+  const LogicalOpcode cmps[] = { BO_SLT, BO_ULT, BO_SGT, BO_UGT, BO_SLE,
+                                 BO_ULE, BO_SGE, BO_UGE, BO_EQ, BO_NE };
+  const SymExpr *a = mgr.getScalarSymbol(3, 8);
+  const SymExpr *b = mgr.getScalarSymbol(4, 8);
+  const uint64_t values[] = { 0, 1, 3, 7, 127, 128, 200, 255 };
+  for (unsigned i = 0; i < 8; ++i) {
+    for (unsigned j = 0; j < 8; ++j) {
+      SymModel m;
+      m.setScalar(3, values[i]);
+      m.setScalar(4, values[j]);
+      SymExprEvaluator ev(ctx, m);
+      adapter.push();
+      adapter.assertSymConstraint(SymConstraint(mgr.getLogical(
+        a, mgr.getConst(values[i], 8, false), BO_EQ), true));
+      adapter.assertSymConstraint(SymConstraint(mgr.getLogical(
+        b, mgr.getConst(values[j], 8, false), BO_EQ), true));
+      for (unsigned k = 0; k < sizeof(ops) / sizeof(ops[0]); ++k) {
+        const SymExpr *e = mgr.getArith(a, b, ops[k]);
+        uint64_t v = 0;
+        bool known = ev.evaluate(e, v);
+        assert(known);
+        assumptions.assign(1, SymConstraint(
+          mgr.getLogical(e, mgr.getConst(v, 8, false), BO_NE), true));
+        r = adapter.checkSatAssuming(assumptions);
+        assert(r == SAT_Unsatisfiable);
+      }
+      for (unsigned k = 0; k < sizeof(cmps) / sizeof(cmps[0]); ++k) {
+        const SymExpr *e = mgr.getLogical(a, b, cmps[k]);
+        uint64_t v = 0;
+        bool known = ev.evaluate(e, v);
+        assert(known);
+        assumptions.assign(1, SymConstraint(e, v == 0));
+        r = adapter.checkSatAssuming(assumptions);
+        assert(r == SAT_Unsatisfiable);
+      }
+      const SymExpr *cast = mgr.getExtend(
+        mgr.getTrunc(mgr.getUnary(a, UO_Minus), 3), 16, true);
+      uint64_t v = 0;
+      bool known = ev.evaluate(cast, v);
+      assert(known);
+      assumptions.assign(1, SymConstraint(
+        mgr.getLogical(cast, mgr.getConst(v, 16, false), BO_EQ), false));
+      r = adapter.checkSatAssuming(assumptions);
+      assert(r == SAT_Unsatisfiable);
+      adapter.pop();
+    }
+  }
+  // The operators of the later pairs reuse the gates of the earlier ones.
+  assert(adapter.getNumGateHits() > 0);
+
+  // Array reads give up on the queries that use them, until their scope is
+  // popped. An interrupt of a check that has not started stops only that
+  // check, and one that comes after its check finished is dropped.
+  unsigned indexWidth = ctx.getArrayIndexTypeSizeInBits();
+  const SymExpr *read = mgr.getElem(mgr.getRegionSymbol(3, 16, 1),
+                                    mgr.getConst(1, indexWidth, false));
+  const SymExpr *cmp = mgr.getLogical(mgr.getArith(read, x, BO_Add), one,
+                                      BO_EQ);
+  adapter.push();
+  adapter.assertSymConstraint(SymConstraint(cmp, true));
+  r = adapter.checkSat();
+  assert(r == SAT_Undetermined);
+  adapter.pop();
+  r = adapter.checkSat();
+  assert(r == SAT_Satisfiable);
+  assumptions.assign(1, SymConstraint(cmp, false));
+  r = adapter.checkSatAssuming(assumptions);
+  assert(r == SAT_Undetermined);
+  adapter.interruptCheck(adapter.getCheckEpoch() + 1);
+  r = adapter.checkSat();
+  assert(r == SAT_Undetermined);
+  adapter.interrupt();
+  r = adapter.checkSat();
+  assert(r == SAT_Satisfiable);
+  llvm::errs() << "\n";
+}
+
+void testZ3ModelAccess() {
+  llvm::errs() << "Test Z3 model access. . .\n";
+  Z3Adapter adapter(ctx);
+  SymExprManager mgr(ctx);
+  unsigned iw = ctx.getArrayIndexTypeSizeInBits();
+  const ScalarSymbol *x = mgr.getScalarSymbol(1, 8);
+  const ScalarSymbol *w = mgr.getScalarSymbol(2, 100);
+  const ScalarSymbol *unused = mgr.getScalarSymbol(3, 16);
+  const RegionSymbol *a = mgr.getRegionSymbol(4, 32, 1);
+
+  // x == 0xab, w == zext(x) << 70, a[1] == 5
+  adapter.assertSymConstraint(SymConstraint(
+    mgr.getLogical(x, mgr.getConst(0xab, 8, false), BO_EQ), true));
+  adapter.assertSymConstraint(SymConstraint(mgr.getLogical(
+    w, mgr.getArith(mgr.getExtend(x, 100, false),
+                    mgr.getConst(70, 100, false), BO_Shl), BO_EQ), true));
+  adapter.assertSymConstraint(SymConstraint(mgr.getLogical(
+    mgr.getElem(a, mgr.getConst(1, iw, false)),
+    mgr.getConst(5, 32, false), BO_EQ), true));
+  SolverResult r = adapter.checkSat();
+  assert(r == SAT_Satisfiable);
+
+  uint64_t v = 0;
+  assert(adapter.getValue(x, v) && v == 0xab);
+  // Only the low 64 bits, which are 0.
+  assert(adapter.getValue(w, v) && v == 0);
+  std::vector<uint8_t> bytes;
+  assert(adapter.getValue(w, bytes) && bytes.size() == 13);
+  // 0xab << 70 is 0x2ac0 << 64.
+  for (unsigned i = 0; i < bytes.size(); ++i)
+    assert(bytes[i] == (i == 8 ? 0xc0 : i == 9 ? 0x2a : 0));
+  assert(!adapter.getValue(unused, v));
+  ArrayValue av;
+  assert(adapter.getValue(a, av) &&
+         av.getValue(ArrayValue::Index(1, 1)) == 5);
+
+  std::vector<const Symbol *> syms;
+  syms.push_back(w);
+  syms.push_back(unused);
+  syms.push_back(x);
+  FlatModel fm;
+  adapter.extractModel(syms, fm);
+  assert(fm.size() == 3 && fm.data.size() == 13 + 2 + 1);
+  assert(fm.entries[0].valid && fm.getNumBytes(0) == 13 &&
+         fm.getBytes(0)[9] == 0x2a && fm.getUInt64(0) == 0);
+  assert(!fm.entries[1].valid && fm.getUInt64(1) == 0);
+  assert(fm.entries[2].valid && fm.entries[2].offset == 15 &&
+         fm.getUInt64(2) == 0xab);
+
+  // The model is fetched again after the next check.
+  adapter.push();
+  adapter.assertSymConstraint(SymConstraint(
+    mgr.getLogical(unused, mgr.getConst(9, 16, false), BO_EQ), true));
+  r = adapter.checkSat();
+  assert(r == SAT_Satisfiable);
+  assert(adapter.getValue(unused, v) && v == 9);
+  adapter.pop();
+  llvm::errs() << "\n";
+}